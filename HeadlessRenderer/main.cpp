@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "CPURenderer.h"
+#include "DAGFile.h"
+#include "MappedFile.h"
+#include "NodePool.h"
+
+namespace {
+	void printUsage()
+	{
+		printf("HeadlessRenderer <world.dag> <output.ppm> [options]\n");
+		printf("  --size <width> <height>   image size, 1280 720 by default\n");
+		printf("  --position <x> <y> <z>    camera position in world units, 0.5 1 0.5 by default\n");
+		printf("  --yaw <degrees>           rotation about the vertical axis\n");
+		printf("  --pitch <degrees>         look up, -89 to 89\n");
+		printf("  --steps                   color by traversal steps instead of material\n");
+		printf("  --tile <pixels>           tile edge length, 16 by default\n");
+		printf("  --repeat <count>          render this many times and report the fastest\n");
+		printf("  --compare <reference.ppm> fail if the image differs from the reference by more than the tolerance\n");
+		printf("  --tolerance <value>       largest channel difference allowed in 8-bit steps, 0 by default\n");
+	}
+
+	bool loadWorld(const std::string& path, NodePool& nodes, uint32_t& depth)
+	{
+		MappedFile file;
+		if (!file.open(path)) {
+			printf("Failed to open %s\n", path.c_str());
+			return false;
+		}
+
+		DAGFileHeader header;
+		std::vector<SVDAGGPUNode> loadedNodes;
+		if (!readDAGFileNodes(file.data(), file.size(), header, loadedNodes)) {
+			printf("Failed to read %s\n", path.c_str());
+			return false;
+		}
+		nodes.assign(loadedNodes.data(), loadedNodes.size());
+		depth = header.depth;
+		return true;
+	}
+}
+
+// HeadlessRenderer renders a camera view of a world on the CPU, for machines without a GPU
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		printUsage();
+		return 1;
+	}
+
+	std::string worldPath = argv[1];
+	std::string outputPath = argv[2];
+	uint32_t width = 1280, height = 720;
+	glm::vec3 position(0.5f, 1.0f, 0.5f);
+	float yaw = 0.0f, pitch = 0.0f;
+	bool visualizeSteps = false;
+	uint32_t tileSize = 16;
+	uint32_t repeat = 1;
+	std::string referencePath;
+	uint32_t tolerance = 0;
+
+	for (int i = 3; i < argc; i++) {
+		std::string option = argv[i];
+		int values = option == "--size" ? 2 : option == "--position" ? 3 : option == "--steps" ? 0 : 1;
+		if (i + values >= argc) {
+			printUsage();
+			return 1;
+		}
+
+		if (option == "--size") {
+			width = std::strtoul(argv[i + 1], nullptr, 10);
+			height = std::strtoul(argv[i + 2], nullptr, 10);
+		}
+		else if (option == "--position") {
+			position = glm::vec3(std::strtof(argv[i + 1], nullptr), std::strtof(argv[i + 2], nullptr), std::strtof(argv[i + 3], nullptr));
+		}
+		else if (option == "--yaw") {
+			yaw = std::strtof(argv[i + 1], nullptr);
+		}
+		else if (option == "--pitch") {
+			pitch = glm::clamp(std::strtof(argv[i + 1], nullptr), -89.0f, 89.0f);
+		}
+		else if (option == "--steps") {
+			visualizeSteps = true;
+		}
+		else if (option == "--tile") {
+			tileSize = std::strtoul(argv[i + 1], nullptr, 10);
+		}
+		else if (option == "--repeat") {
+			repeat = std::max(std::strtoul(argv[i + 1], nullptr, 10), 1ul);
+		}
+		else if (option == "--compare") {
+			referencePath = argv[i + 1];
+		}
+		else if (option == "--tolerance") {
+			tolerance = std::strtoul(argv[i + 1], nullptr, 10);
+		}
+		else {
+			printf("Unknown option %s\n", option.c_str());
+			printUsage();
+			return 1;
+		}
+		i += values;
+	}
+	if (width == 0 || height == 0) {
+		printf("The image must not be empty\n");
+		return 1;
+	}
+
+	NodePool nodes;
+	uint32_t depth = 0;
+	if (!loadWorld(worldPath, nodes, depth)) {
+		return 1;
+	}
+	printf("Loaded %zu nodes, size %u^3\n", nodes.size(), 1u << depth);
+
+	Camera camera;
+	camera.setAspectRatio(static_cast<float>(width) / height);
+	camera.setPosition(position);
+	camera.setOrientation(glm::radians(yaw), glm::radians(pitch));
+
+	CPURenderer renderer(nodes, depth);
+	renderer.setVisualizeSteps(visualizeSteps);
+	renderer.setTileSize(tileSize);
+
+	CPUImage image;
+	image.width = width;
+	image.height = height;
+	RenderView view = { camera.RayDirMatrix(), camera.Position() };
+	RenderStatistics best = {};
+	for (uint32_t i = 0; i < repeat; i++) {
+		RenderStatistics statistics = renderer.render(view, image);
+		if (i == 0 || statistics.seconds < best.seconds) {
+			best = statistics;
+		}
+	}
+	printf("Rendered %ux%u in %.3f ms: %.2f Mrays/s, %.1f steps per ray\n", width, height, best.seconds * 1e3,
+		best.raysPerSecond() / 1e6, static_cast<double>(best.steps) / best.rays);
+
+	if (!image.writePPM(outputPath)) {
+		return 1;
+	}
+
+	if (!referencePath.empty()) {
+		CPUImage reference;
+		if (!reference.readPPM(referencePath)) {
+			return 1;
+		}
+
+		uint32_t maxDifference;
+		double meanDifference;
+		if (!image.compare(reference, maxDifference, meanDifference)) {
+			printf("%s is %ux%u, not %ux%u\n", referencePath.c_str(), reference.width, reference.height, width, height);
+			return 1;
+		}
+		printf("Difference from %s: %u max, %.4f mean\n", referencePath.c_str(), maxDifference, meanDifference);
+		if (maxDifference > tolerance) {
+			return 1;
+		}
+	}
+	return 0;
+}
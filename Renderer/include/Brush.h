@@ -6,7 +6,7 @@
 #include "Camera.h"
 #include "Common.h"
 #include "GPUProgram.h"
-#include "SVDAGEditor.h"
+#include "EditWorker.h"
 #include "SVDAGLoader.h"
 
 struct BrushData {
@@ -29,7 +29,7 @@ enum BrushMode {
 class Brush
 {
 public:
-	Brush(std::shared_ptr<Camera> camera, std::shared_ptr<SVDAGLoader> svdagLoader, std::shared_ptr<SVDAGEditor> svdagEditor);
+	Brush(std::shared_ptr<Camera> camera, std::shared_ptr<SVDAGLoader> svdagLoader, std::shared_ptr<EditWorker> editWorker);
 	~Brush();
 
 	BrushData getBrushData();
@@ -37,12 +37,18 @@ public:
 	void sphere(glm::vec3 center, float radius, bool isAdding, uint16_t material);
 	void paint(glm::vec3 center, float radius, uint16_t material);
 	void box(glm::vec3 p1, glm::vec3 p2, bool isAdding, uint16_t material);
+	void copy(glm::vec3 p1, glm::vec3 p2);
+	// The clip's lowest corner lands on the voxel under position
+	void paste(glm::vec3 position);
+	// Uploads the edits the worker finished since the last frame
 	void uploadChangesToGPU();
+	// The voxels between two world positions, clamped to the world
+	Box voxelBox(glm::vec3 p1, glm::vec3 p2) const;
 
 private:
 	std::shared_ptr<Camera> camera;
 	std::shared_ptr<SVDAGLoader> svdagLoader;
-	std::shared_ptr<SVDAGEditor> svdagEditor;
+	std::shared_ptr<EditWorker> editWorker;
 
 	GLuint brushBuffer;
 	std::unique_ptr<Shader> brushShader;
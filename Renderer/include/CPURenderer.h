@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "NodePool.h"
+
+// The camera uniforms render.comp reads
+struct RenderView {
+	glm::mat4 rayDirMatrix;
+	glm::vec3 position;
+};
+
+struct RayHit {
+	bool found;
+	uint16_t material;
+	uint32_t steps;
+	glm::vec3 position;
+};
+
+struct RenderStatistics {
+	uint64_t rays;
+	uint64_t steps;
+	double seconds;
+
+	double raysPerSecond() const { return seconds > 0.0 ? rays / seconds : 0.0; }
+};
+
+// Colors as render.comp stores them, rows from the top. Files are binary PPMs with 8 bits per channel
+struct CPUImage {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<glm::vec3> pixels;
+
+	bool writePPM(const std::string& path) const;
+	bool readPPM(const std::string& path);
+	// Largest and mean absolute channel difference in 8-bit steps; false if the sizes differ
+	bool compare(const CPUImage& other, uint32_t& maxDifference, double& meanDifference) const;
+};
+
+// Casts the same rays as render.comp with the same traversal, step sizes and shading, one float operation for
+// another, so its images can stand in for the GPU's where there is none. The overlays for the brush and the
+// box selection are left out. The image is split into square tiles that the threads take in turn
+class CPURenderer
+{
+public:
+	CPURenderer(const NodePool& nodes, uint32_t depth);
+
+	void setVisualizeSteps(bool enabled) { visualizeSteps = enabled; }
+	void setTileSize(uint32_t pixels) { tileSize = std::max(pixels, 1u); }
+
+	// Renders image.width x image.height pixels
+	RenderStatistics render(const RenderView& view, CPUImage& image) const;
+	RayHit castRay(const glm::vec3& origin, const glm::vec3& direction) const;
+	glm::vec3 shade(const RayHit& hit) const;
+
+	static glm::vec3 getColorFromMaterial(uint32_t material);
+	static glm::vec3 plasmaQuintic(float x);
+private:
+	const NodePool& nodes;
+	uint32_t treeDepth;
+	bool visualizeSteps = false;
+	uint32_t tileSize = 16;
+
+	float traverseOctree(const glm::vec3& p, const glm::vec3& rayDir, uint32_t& material) const;
+};
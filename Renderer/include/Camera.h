@@ -9,6 +9,11 @@ public:
 	Camera();
 	void setAspectRatio(float aspectRatio);
 	void move(std::set<int> keysPressed, float dt);
+	// Where the keys would move the camera this frame, for callers that move it themselves
+	glm::vec3 movement(std::set<int> keysPressed, float dt);
+	void setPosition(const glm::vec3& newPosition);
+	// Angles in radians, as mouseMove accumulates them
+	void setOrientation(float newYaw, float newPitch);
 	void mouseMove(double x, double y);
 	const glm::mat4 ViewProjMatrix() { return viewProjMatrix; }
 	const glm::mat4 RayDirMatrix() { return rayDirMatrix; }
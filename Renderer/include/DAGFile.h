@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "SVDAGNode.h"
+
+constexpr uint32_t DAG_FILE_MAGIC = 0x47414453; // "SDAG"
+constexpr uint32_t DAG_FILE_VERSION = 2;
+constexpr uint64_t DAG_FILE_DATA_ALIGNMENT = 4096;
+constexpr size_t DAG_CHECKSUM_BLOCK_SIZE = 1 << 20;
+// Resolutions are computed as 1u << depth, so deeper trees cannot be addressed
+constexpr uint32_t DAG_MAX_DEPTH = 31;
+
+enum DAGLayoutFlags : uint32_t {
+	DAG_LAYOUT_STD430 = 1 << 0,
+	DAG_LAYOUT_LITTLE_ENDIAN = 1 << 1,
+};
+
+enum DAGEncoding : uint32_t {
+	DAG_ENCODING_RAW = 0,
+	DAG_ENCODING_BLOCK_VARINT = 1,
+};
+
+struct DAGFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t nodeSize;
+	uint32_t depth;
+	uint32_t maxRefs;
+	uint32_t layoutFlags;
+	uint32_t encoding;
+	uint64_t nodeCount;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+	uint64_t dataChecksum;
+	uint64_t blockTableOffset;
+	uint32_t blockNodeCount;
+	uint32_t blockCount;
+	// Last edit journal record folded into this file, 0 if none
+	uint64_t journalSequence;
+	uint64_t headerChecksum;
+};
+static_assert(sizeof(DAGFileHeader) == 96);
+
+constexpr uint32_t DAG_WORLD_MAGIC = 0x444C5753; // "SWLD"
+constexpr uint32_t DAG_WORLD_VERSION = 1;
+
+enum DAGTileFlags : uint32_t {
+	DAG_TILE_EMPTY = 1 << 0,
+};
+
+struct DAGWorldHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t tileDepth;
+	uint32_t tileCount;
+	uint32_t gridSize[3];
+	uint32_t reserved;
+	uint64_t tableChecksum;
+	uint64_t headerChecksum;
+};
+static_assert(sizeof(DAGWorldHeader) == 48);
+
+struct DAGWorldTile {
+	uint32_t x, y, z;
+	uint32_t flags;
+	uint64_t nodeCount;
+	char fileName[104];
+};
+static_assert(sizeof(DAGWorldTile) == 128);
+
+// The raw node array is read in place as SVDAGGPUNode, which already matches the std430 VoxelNode
+static_assert(sizeof(SVDAGGPUNode) == 44);
+static_assert(offsetof(SVDAGGPUNode, refs) == 4);
+static_assert(offsetof(SVDAGGPUNode, material) == 8);
+static_assert(offsetof(SVDAGGPUNode, children) == 12);
+
+uint64_t dagBlockChecksum(const uint8_t* data, size_t size);
+uint64_t dagChecksum(const std::vector<uint64_t>& blockChecksums);
+uint64_t dagHeaderChecksum(const DAGFileHeader& header);
+
+bool isDAGFile(const uint8_t* data, size_t size);
+bool readDAGFileHeader(const uint8_t* data, size_t size, DAGFileHeader& outHeader);
+bool verifyDAGFileData(const uint8_t* data, const DAGFileHeader& header);
+bool readDAGFileNodes(const uint8_t* data, size_t size, DAGFileHeader& outHeader, std::vector<SVDAGGPUNode>& outNodes);
+// File helpers shared by the world and journal writers. syncFile returns once the data is on disk, and
+// replaceFile renames source over target and returns once the rename is on disk too
+FILE* openFile(const std::string& path, const char* mode);
+bool syncFile(FILE* file);
+bool replaceFile(const std::string& source, const std::string& target);
+
+// Returns only once the file is durable, so whatever it supersedes can be dropped afterwards
+bool writeDAGFile(const std::string& path, uint32_t depth, uint32_t maxRefs, const std::vector<SVDAGGPUNode>& nodes, uint64_t journalSequence = 0);
+bool readDAGWorldIndex(const std::string& path, DAGWorldHeader& outHeader, std::vector<DAGWorldTile>& outTiles);
+bool decodeDAGBlock(const uint8_t* data, const DAGFileHeader& header, uint32_t block, SVDAGGPUNode* outNodes);
+bool decodeDAGBlocks(const uint8_t* data, const DAGFileHeader& header, SVDAGGPUNode* outNodes);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "SVDAGEditor.h"
+
+constexpr uint32_t JOURNAL_FILE_MAGIC = 0x4C4E524A; // "JRNL"
+constexpr uint32_t JOURNAL_FILE_VERSION = 1;
+
+enum JournalRecordType : uint8_t {
+	JOURNAL_VOXELS,
+	JOURNAL_SHAPE,
+	JOURNAL_REGION,
+	JOURNAL_UNDO,
+	JOURNAL_REDO,
+	JOURNAL_BEGIN_STROKE,
+	JOURNAL_END_STROKE,
+	JOURNAL_COPY,
+	JOURNAL_PASTE,
+};
+
+struct JournalFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t depth;
+	uint32_t reserved;
+};
+static_assert(sizeof(JournalFileHeader) == 16);
+
+// The checksum covers the record header with the checksum field zeroed and the payload
+struct JournalRecordHeader {
+	uint64_t sequence;
+	uint64_t checksum;
+	uint32_t payloadSize;
+	uint8_t type;
+	uint8_t op;
+	uint16_t material;
+};
+static_assert(sizeof(JournalRecordHeader) == 24);
+
+struct JournalVoxel {
+	uint32_t x, y, z;
+	uint16_t material;
+	uint8_t op;
+	uint8_t padding;
+};
+static_assert(sizeof(JournalVoxel) == 16);
+
+// Append-only log of the edits committed on top of a .dag. Records are numbered, and a checkpoint stores the
+// last number it folded in, so replay skips those and stops at the first torn or corrupt record
+class EditJournal
+{
+public:
+	~EditJournal();
+
+	// Opens or creates the journal and cuts off a torn tail. New records are numbered after baseSequence
+	bool open(const std::string& path, uint32_t depth, uint64_t baseSequence);
+	void close();
+	bool isOpen() const { return file != nullptr; }
+
+	void appendVoxels(const VoxelEdit* edits, size_t count);
+	void appendShape(const SDFShapeParameters& shape, VoxelEditOp op, uint16_t material);
+	void appendRegion(const Box& box, bool addVoxels, uint16_t material);
+	void appendCopy(const Box& box);
+	void appendPaste(const glm::uvec3& destination);
+	void appendMarker(JournalRecordType type);
+	// For an edit that cannot be recorded; nothing more is appended until a checkpoint covers it
+	void invalidate();
+
+	// Applies the records after baseSequence and returns how many were applied. A record that cannot be applied
+	// ends the replay and pauses the journal until the next checkpoint. Attach the journal to the editor only
+	// afterwards, or the replayed edits are recorded again
+	size_t replay(SVDAGEditor& editor, uint64_t baseSequence);
+
+	bool needsCheckpoint() const { return !valid || bytesSinceCheckpoint > checkpointBytes; }
+	// Returns the sequence the checkpoint has to store; edits from here on are recorded again
+	uint64_t beginCheckpoint();
+	// Drops the records the checkpoint folded in once it is on disk
+	void finishCheckpoint(uint64_t sequence, bool succeeded);
+
+	void setSyncInterval(float seconds) { syncInterval = seconds; }
+	void setCheckpointBytes(size_t bytes) { checkpointBytes = bytes; }
+	void syncIfDue();
+	void sync();
+private:
+	std::string path;
+	FILE* file = nullptr;
+	uint32_t depth = 0;
+	uint64_t sequence = 0;
+	bool valid = true;
+	bool validBeforeCheckpoint = true;
+	size_t bytesSinceCheckpoint = 0;
+	size_t checkpointBytes = size_t(64) << 20;
+	float syncInterval = 1.0f;
+	bool unsynced = false;
+	std::chrono::steady_clock::time_point lastSync;
+
+	void append(JournalRecordType type, uint8_t op, uint16_t material, const void* payload, uint32_t payloadSize);
+	// Calls visit(header, payload) for every intact record and returns the offset after the last one
+	template <typename Visitor>
+	uint64_t readRecords(Visitor&& visit) const;
+	bool rewrite(uint64_t afterSequence);
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common.h"
+#include "NodePool.h"
+#include "SDFShape.h"
+#include "SVDAGEditor.h"
+
+class SVDAGLoader;
+
+enum EditCommandType : uint8_t {
+	EDIT_SHAPE,
+	EDIT_REGION,
+	EDIT_UNDO,
+	EDIT_REDO,
+	EDIT_BEGIN_STROKE,
+	EDIT_END_STROKE,
+	EDIT_COPY,
+	EDIT_PASTE,
+	EDIT_SNAPSHOT,
+};
+
+struct EditCommand {
+	EditCommandType type = EDIT_SHAPE;
+	SDFShape shape = {};
+	Box box = {};
+	VoxelEditOp op = VOXEL_SET;
+	uint16_t material = 0;
+};
+
+// Applies edits on a thread of its own. Everything queued since the last batch is applied as one batch, and
+// the nodes it dirtied are staged for the render loop, which uploads them as one consistent tree. The pool
+// and the editor belong to the worker until isIdle() returns true
+class EditWorker
+{
+public:
+	EditWorker(std::shared_ptr<SVDAGEditor> editor, NodePool& nodes);
+	~EditWorker();
+
+	void modifyShape(const SDFShape& shape, VoxelEditOp op, uint16_t material);
+	void modifyRegion(const Box& targetBox, bool addVoxels, uint16_t material);
+	void copyRegion(const Box& box);
+	void paste(const glm::uvec3& destination);
+	void undo();
+	void redo();
+	void beginStroke();
+	void endStroke();
+	// The pool is copied on the worker thread once everything queued before the call is applied
+	std::future<NodeSnapshot> snapshotNodes();
+	bool isInStroke() const { return strokeOpen; }
+	// As of the last finished batch
+	bool canUndo() const { return undoAvailable; }
+	bool canRedo() const { return redoAvailable; }
+	bool hasClipboard() const { return clipboardAvailable; }
+
+	// Uploads the nodes of every batch finished since the last call; returns false if there were none
+	bool uploadPublished(SVDAGLoader& loader);
+	// Nothing queued, nothing being applied and nothing waiting to be uploaded
+	bool isIdle();
+	// Blocks until the queue is applied. Whatever was published is left for uploadPublished
+	void waitIdle();
+	// Runs read between batches, with the pool as the last finished batch left it and no new batch starting
+	// until read returns. Returns false without running it while a batch is being applied
+	bool readPoolBetweenBatches(const std::function<void(const NodePool&)>& read);
+private:
+	std::shared_ptr<SVDAGEditor> editor;
+	NodePool& nodes;
+	std::thread worker;
+
+	std::mutex mutex;
+	std::condition_variable queued;
+	std::condition_variable finished;
+	std::vector<EditCommand> queue;
+	// One per EDIT_SNAPSHOT in the queue, in the same order
+	std::deque<std::promise<NodeSnapshot>> snapshotRequests;
+	bool busy = false;
+	bool stopping = false;
+
+	// The worker stages into one buffer while the render loop uploads from the other
+	StagedNodes published;
+	StagedNodes uploading;
+
+	bool strokeOpen = false;
+	std::atomic<bool> undoAvailable = false;
+	std::atomic<bool> redoAvailable = false;
+	std::atomic<bool> clipboardAvailable = false;
+
+	void submit(EditCommand command);
+	void run();
+	void takeSnapshot();
+	void apply(const EditCommand& command);
+};
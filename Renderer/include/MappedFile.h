@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return bytes != nullptr; }
+	const uint8_t* data() const { return bytes; }
+	size_t size() const { return length; }
+private:
+	uint8_t* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+};
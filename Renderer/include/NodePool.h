@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "SVDAGNode.h"
+
+constexpr uint32_t NODE_SEGMENT_SHIFT = 12;
+constexpr uint32_t NODE_SEGMENT_SIZE = 1u << NODE_SEGMENT_SHIFT;
+constexpr uint32_t NODE_PAGE_SHIFT = 8;
+constexpr uint32_t NODE_PAGE_SIZE = 1u << NODE_PAGE_SHIFT;
+
+// Copies of dirty nodes taken on the thread that edits the pool, so another thread can upload them while
+// the pool keeps changing. Later ranges overwrite earlier ones
+struct StagedNodes {
+	std::vector<std::pair<size_t, size_t>> ranges;
+	std::vector<SVDAGGPUNode> nodes;
+	size_t poolSize = 0;
+
+	bool empty() const { return ranges.empty() && poolSize == 0; }
+	void clear() {
+		ranges.clear();
+		nodes.clear();
+		poolSize = 0;
+	}
+};
+
+// A copy of the whole pool and the version it was taken at, for work that runs while the pool keeps changing
+struct NodeSnapshot {
+	std::vector<SVDAGGPUNode> nodes;
+	uint64_t version = 0;
+};
+
+// Nodes live in fixed-size segments that never move, so indices and references stay valid while the pool grows
+class NodePool
+{
+public:
+	NodePool() = default;
+	NodePool(const NodePool&) = delete;
+	NodePool& operator=(const NodePool&) = delete;
+
+	SVDAGGPUNode& operator[](uint32_t index) { return segments[index >> NODE_SEGMENT_SHIFT][index & (NODE_SEGMENT_SIZE - 1)]; }
+	const SVDAGGPUNode& operator[](uint32_t index) const { return segments[index >> NODE_SEGMENT_SHIFT][index & (NODE_SEGMENT_SIZE - 1)]; }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t segmentCount() const { return segments.size(); }
+	const SVDAGGPUNode* segment(size_t index) const { return segments[index].get(); }
+
+	// Reuses a released slot when there is one
+	uint32_t allocate(const SVDAGGPUNode& node);
+	// Hands a dead node's slot back to allocate; its contents stay until the slot is reused
+	void release(uint32_t index);
+	size_t freeCount() const { return freeNodes.size(); }
+	float fragmentation() const { return count ? static_cast<float>(freeNodes.size()) / count : 0.0f; }
+	// New nodes are left uninitialized, callers are expected to write them
+	void resize(size_t newCount);
+	void clear();
+	void write(size_t first, const SVDAGGPUNode* nodes, size_t nodeCount);
+	void assign(const SVDAGGPUNode* nodes, size_t nodeCount);
+	// Copies every slot, live or free, into one contiguous array
+	void copyTo(std::vector<SVDAGGPUNode>& outNodes) const;
+
+	void markDirty(uint32_t index);
+	void markDirtyRange(size_t first, size_t nodeCount);
+	void clearDirty();
+	bool hasDirty() const { return anyDirty; }
+	// Appends the dirty ranges to staged and clears them
+	void stageDirty(StagedNodes& staged);
+	// Changes whenever nodes are written, allocated or released, so snapshots can tell if they went stale
+	uint64_t version() const { return modifications; }
+	// The version at which the page holding the node was created, allocated into or marked dirty. write() leaves
+	// it alone so blocks can be written in parallel; callers mark what they overwrite
+	uint64_t pageVersion(uint32_t index) const { return pageVersions[index >> NODE_PAGE_SHIFT]; }
+
+	// Calls visit(first, count, data) for runs of dirty pages, split at segment boundaries
+	template <typename Visitor>
+	void forEachDirtyRange(Visitor&& visit) const;
+
+	size_t memoryUsage() const;
+private:
+	std::vector<std::unique_ptr<SVDAGGPUNode[]>> segments;
+	size_t count = 0;
+	std::vector<uint64_t> dirtyPages;
+	std::vector<uint64_t> pageVersions;
+	bool anyDirty = false;
+	std::vector<uint32_t> freeNodes;
+	uint64_t modifications = 0;
+
+	bool isPageDirty(size_t page) const { return (dirtyPages[page >> 6] >> (page & 63)) & 1; }
+};
+
+template <typename Visitor>
+void NodePool::forEachDirtyRange(Visitor&& visit) const
+{
+	if (!anyDirty) return;
+
+	constexpr size_t pagesPerSegment = NODE_SEGMENT_SIZE / NODE_PAGE_SIZE;
+	size_t pageCount = (count + NODE_PAGE_SIZE - 1) / NODE_PAGE_SIZE;
+
+	size_t page = 0;
+	while (page < pageCount) {
+		if ((page & 63) == 0 && dirtyPages[page >> 6] == 0) {
+			page += 64;
+			continue;
+		}
+		if (!isPageDirty(page)) {
+			page++;
+			continue;
+		}
+
+		size_t segmentEnd = (page / pagesPerSegment + 1) * pagesPerSegment;
+		size_t runEnd = page + 1;
+		while (runEnd < pageCount && runEnd < segmentEnd && isPageDirty(runEnd)) {
+			runEnd++;
+		}
+
+		size_t first = page * NODE_PAGE_SIZE;
+		size_t last = std::min(runEnd * NODE_PAGE_SIZE, count);
+		visit(first, last - first, &(*this)[static_cast<uint32_t>(first)]);
+		page = runEnd;
+	}
+}
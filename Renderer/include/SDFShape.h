@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+
+enum SDFShapeType : uint32_t {
+	SDF_CUSTOM,
+	SDF_SPHERE,
+	SDF_CAPSULE,
+	SDF_CYLINDER,
+	SDF_ROUNDED_BOX,
+};
+
+// What a factory was called with, so built-in shapes can be recorded and rebuilt. a is the center or first
+// end point, b the second end point or the half extents, radius the radius or the rounding
+struct SDFShapeParameters {
+	SDFShapeType type = SDF_CUSTOM;
+	glm::vec3 a = glm::vec3(0.0f);
+	glm::vec3 b = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+// Signed distance in voxel coordinates, negative inside. The Lipschitz bound limits how much the distance can
+// change per voxel moved; exact distance fields have a bound of 1
+struct SDFShape {
+	std::function<float(const glm::vec3&)> distance;
+	float lipschitz = 1.0f;
+	SDFShapeParameters parameters;
+
+	static SDFShape sphere(const glm::vec3& center, float radius);
+	static SDFShape capsule(const glm::vec3& a, const glm::vec3& b, float radius);
+	static SDFShape cylinder(const glm::vec3& a, const glm::vec3& b, float radius);
+	static SDFShape roundedBox(const glm::vec3& center, const glm::vec3& halfExtents, float rounding);
+	static SDFShape custom(std::function<float(const glm::vec3&)> distance, float lipschitz);
+	// Custom shapes cannot be rebuilt and come back without a distance function
+	static SDFShape fromParameters(const SDFShapeParameters& parameters);
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "NodePool.h"
+
+struct SweepQuery {
+	glm::vec3 center;
+	glm::vec3 halfExtents;
+	glm::vec3 displacement;
+};
+
+// time is the fraction of the displacement covered before contact, 1 if nothing was hit. The normal points
+// away from the surface that was hit
+struct SweepResult {
+	float time;
+	glm::vec3 normal;
+	bool hit;
+};
+
+// displacement is the movement wanted this step. After the move, center is where the body ended up,
+// displacement what it actually moved, and grounded whether a floor stopped it
+struct CollisionBody {
+	glm::vec3 center;
+	glm::vec3 halfExtents;
+	glm::vec3 displacement;
+	bool grounded;
+};
+
+// Sweeps axis-aligned boxes through the tree rooted at node 0, in world units where the world spans [0, 1) and
+// y is up. Only nodes the swept box passes through are visited, nearest first, and solid nodes are tested as
+// single boxes. Boxes that already overlap solid voxels when a sweep starts do not block it, so bodies can
+// move out of them. The pool must not change while a call runs
+class SVDAGCollider
+{
+public:
+	SVDAGCollider(const NodePool& nodes, uint32_t depth);
+
+	SweepResult sweep(const SweepQuery& query) const;
+	void sweep(const std::vector<SweepQuery>& queries, std::vector<SweepResult>& results) const;
+
+	// Slides along what the body hits, and a body blocked by a wall climbs onto it if the wall is no higher
+	// than the step height. Bodies are moved in parallel and do not collide with each other
+	void move(CollisionBody& body) const;
+	void move(std::vector<CollisionBody>& bodies) const;
+
+	void setStepHeight(float height) { stepHeight = height; }
+	// Distance bodies keep from the surfaces they stop at, so the next sweep does not start touching them
+	void setSkinWidth(float width) { skinWidth = width; }
+	// Nodes smaller than this fraction of the body's smallest extent count as solid if they hold any voxel,
+	// which keeps the cost of a sweep the same at every resolution. 0 tests every voxel
+	void setMinimumFeature(float fraction) { minimumFeature = fraction; }
+private:
+	struct Sweep {
+		glm::dvec3 center;
+		glm::dvec3 halfExtents;
+		glm::dvec3 displacement;
+		uint32_t nearOctant;
+		double minimumNodeSize;
+	};
+
+	const NodePool& nodes;
+	uint32_t maxDepth;
+	float stepHeight = 0.0f;
+	float skinWidth = 1e-6f;
+	float minimumFeature = 0.0f;
+
+	void sweepNode(uint32_t nodeIndex, const glm::dvec3& nodeMin, double nodeSize, uint32_t depth, const Sweep& sweep, SweepResult& result) const;
+	bool reaches(const glm::dvec3& boxMin, const glm::dvec3& boxMax, const Sweep& sweep, double maxTime) const;
+	void hitSolid(const glm::dvec3& boxMin, const glm::dvec3& boxMax, const Sweep& sweep, SweepResult& result) const;
+	// Returns the position reached; wallHit is set if a surface that is not a floor or ceiling stopped it
+	glm::vec3 slide(const glm::vec3& center, const glm::vec3& halfExtents, glm::vec3 displacement, bool& grounded, bool& wallHit) const;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SVDAGNode.h"
+
+enum CSGOperation : uint8_t {
+	CSG_UNION,
+	CSG_INTERSECTION,
+	CSG_DIFFERENCE,
+};
+
+// Boolean operations between two DAGs of the same depth, both rooted at node 0. The trees are walked together
+// and each pair of subtrees is combined once, so the cost follows the number of distinct pairs rather than the
+// voxel count. Materials come from the first operand, except that a union leaf takes the second operand's
+// material wherever the second operand has voxels in it
+class SVDAGCombiner
+{
+public:
+	// outNodes is deduplicated and laid out like a saved file; returns its highest reference count
+	static uint32_t combine(const std::vector<SVDAGGPUNode>& a, const std::vector<SVDAGGPUNode>& b, uint32_t depth, CSGOperation op, std::vector<SVDAGGPUNode>& outNodes);
+	static bool readNodes(const std::string& path, uint32_t& outDepth, std::vector<SVDAGGPUNode>& outNodes);
+	static bool combineFiles(const std::string& pathA, const std::string& pathB, CSGOperation op, const std::string& outputPath);
+};
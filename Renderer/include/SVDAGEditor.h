@@ -1,44 +1,214 @@
 #pragma once
 #include "SVDAGLoader.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <glm/glm.hpp>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "Common.h"
+#include "SDFShape.h"
+
+class EditJournal;
+
+// Voxel coordinates and resolutions are 32-bit, so 1u << depth must stay defined; Morton codes hold 21 bits per axis
+constexpr uint32_t MAX_TREE_DEPTH = 31;
+constexpr uint32_t MAX_MORTON_DEPTH = 21;
+
+enum VoxelEditOp : uint8_t {
+	VOXEL_SET,
+	VOXEL_CLEAR,
+	VOXEL_PAINT,
+};
+
+struct VoxelEdit {
+	glm::uvec3 voxel;
+	uint16_t material;
+	VoxelEditOp op;
+};
 
 class SVDAGEditor
 {
 public:
-	SVDAGEditor(std::vector<SVDAGGPUNode>& nodes, uint32_t treeDepth);
+	SVDAGEditor(NodePool& nodes, uint32_t treeDepth);
 	~SVDAGEditor();
 
 	bool setVoxel(const glm::vec3& worldPos, uint16_t material);
 	bool clearVoxel(const glm::vec3& worldPos);
 	bool paintVoxel(const glm::vec3& worldPos, uint16_t material);
 
-	const std::vector<uint32_t>& getModifiedIndices() const { return modifiedIndices; }
-	size_t getNewNodesStartIndex() const { return originalNodeCount; }
-	void clearModifiedLists() {
-		modifiedIndices.clear();
-		originalNodeCount = nodes.size();
-	}
-	
-	void uploadChangesToGPU();
+	bool setVoxel(const glm::uvec3& voxel, uint16_t material);
+	bool clearVoxel(const glm::uvec3& voxel);
+	bool paintVoxel(const glm::uvec3& voxel, uint16_t material);
+	bool getVoxel(const glm::uvec3& voxel, uint16_t* material = nullptr) const;
+
+	// Morton codes interleave x, y and z from bit 0 up, so each level's octant is three bits of the code. Only
+	// trees up to MAX_MORTON_DEPTH deep can be addressed this way
+	bool setVoxelMorton(uint64_t code, uint16_t material);
+	bool clearVoxelMorton(uint64_t code);
+	bool paintVoxelMorton(uint64_t code, uint16_t material);
+	bool getVoxelMorton(uint64_t code, uint16_t* material = nullptr) const;
+	static uint64_t mortonEncode(const glm::uvec3& voxel);
+	static glm::uvec3 mortonDecode(uint64_t code);
+
+	// Sorts the edits in Morton order and applies them in one descent, copying each shared node at most once.
+	// Edits to the same voxel are applied in the order given
+	void applyEdits(std::vector<VoxelEdit>& edits);
+
 	void modifyRegion(const Box& targetBox, bool addVoxels, uint16_t material);
+	// Nodes entirely inside the shape are filled, cleared or repainted as a whole; only the surface recurses
+	void modifyShape(const SDFShape& shape, VoxelEditOp op, uint16_t material);
+
+	// The clip is the smallest node that holds the region, kept alive by a reference. A paste shares every clip
+	// node the shift leaves on the octree grid. Other nodes are built one per node from the up to eight clip nodes
+	// they overlap, or shared when those are all empty or all solid. Tiled worlds have no clipboard, and
+	// compaction empties it
+	void copyRegion(const Box& box);
+	bool paste(const glm::uvec3& destination);
+	bool hasClipboard() const { return clipboard.valid; }
+	void clearClipboard();
+
+	// Every edit keeps the previous root alive as a version that shares all unchanged nodes, and undo and
+	// redo swap node 0 with it. Edits between beginStroke and endStroke undo as one step
+	bool undo();
+	bool redo();
+	bool canUndo() const { return !undoStack.empty(); }
+	bool canRedo() const { return !redoStack.empty(); }
+	void beginStroke();
+	void endStroke();
+	bool isInStroke() const { return strokeOpen; }
+	// The oldest versions are released once the nodes they keep alive would exceed this many bytes
+	void setHistoryBudget(size_t bytes);
+
+	// Levels above this depth are owned by someone else (the tile streamer's top level) and are neither
+	// shared with other nodes nor recycled. The root is always fixed, and history needs it to be the only one
+	void setFixedLevels(uint32_t levels) { fixedLevels = std::max(levels, 1u); }
+	// Node indices change when the loader compacts the pool, and only the current version survives it
+	void onNodesCompacted();
+
+	// Every committed edit, undo and redo is appended to the journal
+	void setJournal(std::shared_ptr<EditJournal> journal) { this->journal = std::move(journal); }
+	// Versions from before a checkpoint are not in the journal, so undoing into them pauses it
+	void markJournalBoundary() { journalBoundary = nextVersionId; clipboardJournaled = false; }
+
+	// Subtrees rooted this deep (or below the fixed levels) are edited on a worker pool; 0 edits serially
+	void setParallelDepth(uint32_t depth) { parallelDepth = depth; }
+
 private:
-	std::vector<SVDAGGPUNode>& nodes;
+	struct EditVersion {
+		uint32_t root;
+		uint64_t id;
+		// Nodes the edit allocated, about as many as the old ones the version keeps alive
+		size_t nodeCount;
+	};
+
+	// Nodes a worker allocates before they are moved into the pool
+	struct EditArena {
+		std::deque<SVDAGGPUNode> nodes;
+		std::vector<uint32_t> retained;
+		std::vector<std::pair<uint32_t, uint32_t>> released;
+	};
+
+	struct ChildTask {
+		uint32_t parent;
+		uint32_t octant;
+		uint32_t child;
+		uint32_t depth;
+		std::function<uint32_t()> run;
+		uint32_t result;
+		EditArena arena;
+	};
+
+	struct Clipboard {
+		uint32_t root = 0;
+		uint32_t depth = 0;
+		Box box = {};
+		bool valid = false;
+	};
+
+	// The clip nodes on the 2x2x2 cells of one level that a destination node's source cube overlaps, in octant
+	// order, with min the source voxel where the first cell starts
+	struct PasteWindow {
+		glm::uvec3 min = glm::uvec3(0);
+		uint32_t cells[8] = {};
+	};
+
+	struct ShapeEdit {
+		const SDFShape& shape;
+		VoxelEditOp op;
+		uint16_t material;
+		uint32_t solidNode;
+		std::unordered_map<uint32_t, uint32_t> painted;
+	};
+
+	NodePool& nodes;
 	uint32_t rootNodeIndex = 0;
 	uint32_t maxDepth;
+	uint32_t fixedLevels = 1;
+
+	// Nodes written by past edits, keyed by content, so identical edited subtrees can share again
+	std::unordered_map<NodeKey, uint32_t, NodeKeyHash> dedupIndex;
+	// Nodes created or modified by the current edit, mapped to their canonical node once visited
+	std::unordered_map<uint32_t, uint32_t> touchedNodes;
+	// Dead nodes go back to the pool once the edit commits, so no index is reused while an edit still refers to it
+	std::vector<uint32_t> releasedNodes;
+
+	std::deque<EditVersion> undoStack;
+	std::vector<EditVersion> redoStack;
+	size_t historyNodes = 0;
+	size_t historyBudget = size_t(256) << 20;
+	uint32_t pendingVersion = 0;
+	size_t pendingNodes = 0;
+	bool strokeOpen = false;
+	uint64_t nextVersionId = 0;
+
+	Clipboard clipboard;
+	// Replay needs the copy in the journal before it can repeat a paste
+	bool clipboardJournaled = false;
+
+	std::shared_ptr<EditJournal> journal;
+	uint64_t journalBoundary = 0;
+	bool strokeJournaled = false;
 
-	size_t originalNodeCount;
-	std::vector<uint32_t> modifiedIndices;
+	uint32_t parallelDepth = 2;
+	uint32_t splitDepth = 0;
+	std::vector<ChildTask>* childTasks = nullptr;
+	static thread_local EditArena* activeArena;
 
-	uint32_t recursiveModify(uint32_t nodeIndex, const glm::vec3& targetPos, uint32_t currentDepth, bool addVoxel, uint16_t material);
-	uint32_t recursivePaint(uint32_t nodeIndex, const glm::vec3& targetPos, uint32_t currentDepth, uint16_t material);
+	bool toVoxel(const glm::vec3& worldPos, glm::uvec3& outVoxel) const;
+	bool isMortonInside(uint64_t code) const;
+	bool applyEdit(const VoxelEdit& edit);
+	uint32_t applyEditAlongPath(const VoxelEdit& edit);
+	uint32_t recursiveApplyEdits(uint32_t nodeIndex, const VoxelEdit* first, const VoxelEdit* last, uint32_t currentDepth);
+	uint32_t octantAt(const glm::uvec3& voxel, uint32_t currentDepth) const;
+	void releaseNode(uint32_t nodeIndex, uint32_t currentDepth);
+	uint32_t recursiveModifyShape(uint32_t nodeIndex, const glm::uvec3& nodeMin, uint32_t currentDepth, ShapeEdit& edit);
+	uint32_t paintSubtree(uint32_t nodeIndex, uint32_t currentDepth, ShapeEdit& edit);
 	uint32_t recursiveModifyRegion(uint32_t nodeIndex, const Box& targetBox, const Box& nodeBox, uint32_t currentDepth, bool addVoxels, uint16_t material);
+	uint32_t recursivePaste(uint32_t nodeIndex, const Box& targetBox, const Box& nodeBox, uint32_t currentDepth, const PasteWindow& window);
+	uint32_t pasteNode(const PasteWindow& window, const glm::uvec3& sourceMin, uint32_t currentDepth);
+	PasteWindow pasteWindow(const PasteWindow& parent, const glm::uvec3& sourceMin, uint32_t currentDepth) const;
+	bool windowVoxel(const PasteWindow& window, const glm::uvec3& source, uint16_t* material) const;
 	uint32_t createSolidLeafNode(uint16_t material);
 	uint32_t ensureNodeIsMutable(uint32_t nodeIndex);
+	uint32_t allocateNode(const SVDAGGPUNode& node);
+	SVDAGGPUNode& nodeAt(uint32_t nodeIndex);
+	void retainNode(uint32_t nodeIndex);
+	void editTopDown(const std::function<uint32_t()>& descend);
+	void pruneEmpty(uint32_t nodeIndex, uint32_t currentDepth);
+	bool deferChild(uint32_t parentIndex, uint32_t octant, uint32_t childIndex, uint32_t childDepth, std::function<uint32_t()> run);
+	void beginEdit();
+	void commitEdits();
+	void finishVersion();
+	void swapRoot(uint32_t versionIndex);
+	void trimHistory();
+	EditJournal* journalEdit();
+	uint32_t canonicalize(uint32_t nodeIndex, uint32_t currentDepth);
+	NodeKey makeKey(const SVDAGGPUNode& node, uint32_t currentDepth) const;
 	bool boxesIntersect(const Box& a, const Box& b) const;
 	bool boxContains(const Box& container, const Box& content) const;
 	Box getChildBox(const Box& parentBox, uint32_t octant) const;
@@ -1,38 +1,71 @@
 #pragma once
 
+#include <atomic>
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/vector.hpp>
+#include <thread>
 #include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
-struct SVDAGGPUNode {
-    uint8_t childMask;
-    uint32_t refs;
-    uint16_t material;
-    uint32_t children[8];
-
-	template <class Archive>
-	void serialize(Archive& ar)
-	{
-		ar(childMask);
-        ar(refs);
-        ar(material);
-		for (size_t i = 0; i < 8; i++)
-		{
-			ar(children[i]);
-		}
+#include "MappedFile.h"
+#include "NodePool.h"
+#include "SVDAGNode.h"
+#include "UploadPlanner.h"
+
+class EditWorker;
+struct DAGFileHeader;
+
+struct LoadProgress {
+	std::atomic<uint64_t> bytesTotal = 0;
+	std::atomic<uint64_t> bytesRead = 0;
+	std::atomic<uint64_t> nodesTotal = 0;
+	std::atomic<uint64_t> nodesLoaded = 0;
+	std::atomic<bool> previewReady = false;
+	std::atomic<uint32_t> previewLevels = 0;
+
+	void reset() {
+		bytesTotal = 0;
+		bytesRead = 0;
+		nodesTotal = 0;
+		nodesLoaded = 0;
+		previewReady = false;
+		previewLevels = 0;
+	}
+
+	float fraction() const {
+		float bytes = bytesTotal ? static_cast<float>(bytesRead) / bytesTotal : 0.0f;
+		float loadedNodes = nodesTotal ? static_cast<float>(nodesLoaded) / nodesTotal : 0.0f;
+		return (bytes + loadedNodes) * 0.5f;
 	}
 };
 
 class SVDAGLoader {
 public:
 	~SVDAGLoader();
-    uint32_t maxRefs;
-    void load(std::string filePath);
+    uint32_t maxRefs = 0;
+    // With previewLevels > 0 the top levels are published first, deeper subtrees collapsed into placeholders
+    bool load(std::string filePath, uint32_t previewLevels = 0);
     void uploadToGPU();
+    void uploadPreview();
+    void uploadDirtyNodes();
+    // Same as uploadDirtyNodes for nodes staged by a thread that still owns the pool
+    void uploadStagedNodes(const StagedNodes& staged);
+    // Empties the pool down to a root slot for a streamed world of the given depth
+    void resetForStreaming(size_t depth);
+    // Once this share of the pool is on the free list, a copy without dead nodes is rebuilt on a worker thread.
+    // The edit worker takes the snapshot between batches, so the render loop never copies the pool. finishCompaction
+    // swaps the copy in and returns true if the pool did not change in the meantime; indices change
+    void setCompactionThreshold(float fraction) { compactionThreshold = fraction; }
+    bool startCompactionIfFragmented(EditWorker& editWorker);
+    bool finishCompaction();
+    // Swaps in a whole new node array, such as a compacted or combined world, and uploads it
+    void replaceNodes(const std::vector<SVDAGGPUNode>& newNodes, uint32_t newMaxRefs);
+    bool isCompacting() const { return compacting; }
+    const LoadProgress& getProgress() const { return progress; }
     GLuint getNodeCount();
     GLuint getDepth() { return static_cast<GLuint>(maxDepth); }
+    uint64_t getJournalSequence() const { return journalSequence; }
 
     void bindNodes(GLuint bindingPoint) const {
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo);
@@ -44,16 +77,33 @@ public:
 
 	GLuint getNodeBufferID() const { return ssbo; }
 
-	std::vector<SVDAGGPUNode>& getNodes() { return nodes; }
+	NodePool& getNodes() { return nodes; }
+	UploadPlanner& getUploadPlanner() { return uploadPlanner; }
 
 private:
-    std::vector<SVDAGGPUNode> nodes;
-    size_t maxDepth;
-    GLuint ssbo, nodeCounter;
-    friend class cereal::access;
-
-    template <class Archive>
-    void serialize(Archive& ar) {
-        ar(maxDepth, maxRefs, nodes);
-    }
+    NodePool nodes;
+    std::vector<SVDAGGPUNode> previewNodes;
+    size_t maxDepth = 0;
+    uint64_t journalSequence = 0;
+    GLuint ssbo = 0, nodeCounter = 0;
+    size_t gpuCapacity = 0;
+    UploadPlanner uploadPlanner;
+    LoadProgress progress;
+
+    float compactionThreshold = 0.5f;
+    std::thread compactionWorker;
+    std::atomic<bool> compacting = false;
+    std::atomic<bool> compactionDone = false;
+    uint64_t compactionVersion = 0;
+    uint32_t compactedMaxRefs = 0;
+    std::vector<SVDAGGPUNode> compactedNodes;
+
+    bool loadMapped(const MappedFile& file, uint32_t previewLevels);
+    void buildPreview(const uint8_t* data, const DAGFileHeader& header, uint32_t levels);
+    bool streamNodes(const uint8_t* data, const DAGFileHeader& header);
+    void createBuffers(size_t capacity);
+    void growGPUBuffer(size_t capacity);
+    void updateCounter(size_t count);
+    size_t gpuHeadroom(size_t count) const;
+    bool loadLegacy(const std::string& filePath);
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+struct SVDAGGPUNode {
+    uint8_t childMask;
+    uint32_t refs;
+    uint16_t material;
+    uint32_t children[8];
+
+	template <class Archive>
+	void serialize(Archive& ar)
+	{
+		ar(childMask);
+        ar(refs);
+        ar(material);
+		for (size_t i = 0; i < 8; i++)
+		{
+			ar(children[i]);
+		}
+	}
+};
+
+// A node's contents at a given depth, the identity under which the editor, the saver and the combiner merge
+// identical subtrees. Children are whatever indices the caller has already made canonical
+struct NodeKey {
+	uint32_t depth;
+	uint32_t childMask;
+	uint16_t material;
+	uint32_t children[8];
+
+	bool operator==(const NodeKey& other) const {
+		return depth == other.depth && childMask == other.childMask && material == other.material &&
+			std::equal(children, children + 8, other.children);
+	}
+};
+
+struct NodeKeyHash {
+	size_t operator()(const NodeKey& key) const {
+		size_t hash = std::hash<uint32_t>{}(key.childMask | (key.depth << 8));
+		hash ^= std::hash<uint16_t>{}(key.material) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		for (uint32_t child : key.children) {
+			hash ^= std::hash<uint32_t>{}(child) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		}
+		return hash;
+	}
+};
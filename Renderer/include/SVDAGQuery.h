@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Common.h"
+#include "NodePool.h"
+
+struct PointQueryResult {
+	bool solid;
+	uint16_t material;
+};
+
+struct BoxQueryResult {
+	bool anySolid;
+	bool allSolid;
+};
+
+// Millions of queries per second
+struct QueryBenchmark {
+	double randomPoints;
+	double coherentPoints;
+	double coherentPointsOneThread;
+	double boxes;
+};
+
+// Answers occupancy queries against the tree rooted at node 0 without touching the GPU. A batch is sorted in
+// Morton order, so each query starts from the deepest node it shares with the one before it, and the sorted
+// batch is split into chunks that run in parallel. The pool must not change while a batch runs
+class SVDAGQuery
+{
+public:
+	SVDAGQuery(const NodePool& nodes, uint32_t depth);
+
+	// Results are written in the order of the queries. Points outside the world are empty, and boxes are
+	// clamped to it
+	void queryPoints(const std::vector<glm::uvec3>& points, std::vector<PointQueryResult>& results) const;
+	void queryBoxes(const std::vector<Box>& boxes, std::vector<BoxQueryResult>& results) const;
+	void setChunkSize(size_t queries) { chunkSize = std::max<size_t>(queries, 1); }
+
+	// Times random points, points clustered around random centers, the same on one thread, and small boxes
+	QueryBenchmark benchmark(size_t queryCount, uint32_t seed = 1) const;
+private:
+	const NodePool& nodes;
+	uint32_t maxDepth;
+	size_t chunkSize = 4096;
+
+	template <typename Key>
+	std::vector<uint32_t> mortonOrder(const std::vector<Key>& queries, const glm::uvec3& (*corner)(const Key&)) const;
+	template <typename Run>
+	void forEachChunk(size_t count, const Run& run) const;
+	void runPoints(const std::vector<glm::uvec3>& points, const uint32_t* order, size_t count, PointQueryResult* results) const;
+	void runBoxes(const std::vector<Box>& boxes, const uint32_t* order, size_t count, BoxQueryResult* results) const;
+	void evaluateBox(uint32_t nodeIndex, const Box& nodeBox, uint32_t depth, const Box& box, BoxQueryResult& result) const;
+	uint32_t sharedLevels(const glm::uvec3& a, const glm::uvec3& b) const;
+	uint32_t octantAt(const glm::uvec3& voxel, uint32_t depth) const;
+};
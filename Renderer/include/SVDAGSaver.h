@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "NodePool.h"
+#include "SVDAGNode.h"
+
+// Writes the DAG reachable from node 0 to a .dag file. The snapshot is taken by whoever owns the pool, usually
+// the edit worker between batches, and garbage collection, re-deduplication and the depth-first relayout run
+// in the background once it arrives
+class SVDAGSaver
+{
+public:
+	~SVDAGSaver();
+
+	bool save(std::future<NodeSnapshot> snapshot, uint32_t depth, const std::string& path, uint64_t journalSequence = 0);
+	bool isSaving() const { return saving; }
+	bool lastSaveSucceeded() const { return succeeded; }
+
+	// Returns the highest reference count in outNodes
+	static uint32_t compact(const std::vector<SVDAGGPUNode>& nodes, uint32_t depth, std::vector<SVDAGGPUNode>& outNodes);
+private:
+	std::thread worker;
+	std::atomic<bool> saving = false;
+	std::atomic<bool> succeeded = false;
+};
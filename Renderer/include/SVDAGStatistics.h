@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <unordered_map>
+
+#include "Common.h"
+#include "NodePool.h"
+
+constexpr uint32_t MATERIAL_HISTOGRAM_SIZE = 4;
+
+struct MaterialCount {
+	uint16_t material;
+	uint64_t voxels;
+};
+
+// The most common materials, largest first. Merging keeps the largest entries and counts the rest in
+// otherVoxels, so a histogram is exact as long as the region holds no more than MATERIAL_HISTOGRAM_SIZE materials
+struct MaterialHistogram {
+	MaterialCount entries[MATERIAL_HISTOGRAM_SIZE];
+	uint32_t entryCount = 0;
+	uint64_t otherVoxels = 0;
+
+	void add(uint16_t material, uint64_t voxels);
+	void merge(const MaterialHistogram& other);
+};
+
+struct RegionStatistics {
+	uint64_t voxels = 0;
+	MaterialHistogram materials;
+};
+
+// Voxel counts and material histograms of the tree rooted at node 0. The totals of every node above the leaf level
+// are computed once and cached by index, so a node shared by many parents costs the same as one, and a region adds
+// up the nodes it contains whole without visiting them. Leaf-level and solid nodes are counted directly. A cached
+// node is recomputed once its pool page has been written since, which after an edit is only the copied or modified
+// path. Counts saturate past 2^64 voxels, which only trees deeper than MAX_MORTON_DEPTH can hold. Not thread-safe,
+// and the pool must not change while a query runs
+class SVDAGStatistics
+{
+public:
+	SVDAGStatistics(const NodePool& nodes, uint32_t depth, bool trackMaterials = true);
+
+	RegionStatistics world();
+	// The box is inclusive and clamped to the world
+	RegionStatistics region(const Box& box);
+	void clearCache();
+private:
+	// The histogram is kept as 16-bit materials with 32-bit counts in units of 1 << shift, so a material's count is
+	// exact below 2^32 voxels and rounded down above it; what the entries miss is the rest of the exact total
+	struct CachedTotals {
+		uint64_t version;
+		uint64_t voxels;
+		uint16_t materials[MATERIAL_HISTOGRAM_SIZE];
+		uint32_t materialVoxels[MATERIAL_HISTOGRAM_SIZE];
+		uint8_t materialCount;
+		uint8_t shift;
+	};
+
+	const NodePool& nodes;
+	uint32_t maxDepth;
+	bool trackMaterials;
+
+	std::unordered_map<uint32_t, CachedTotals> cache;
+
+	void addNode(uint32_t nodeIndex, uint32_t depth, RegionStatistics& result);
+	void addRegion(uint32_t nodeIndex, const Box& nodeBox, uint32_t depth, const Box& box, RegionStatistics& result);
+	void addSolid(uint16_t material, uint64_t voxels, RegionStatistics& result) const;
+	void addCached(const CachedTotals& totals, RegionStatistics& result) const;
+	const CachedTotals& cachedTotals(uint32_t nodeIndex, uint32_t depth);
+	uint64_t solidVoxels(uint32_t depth) const;
+};
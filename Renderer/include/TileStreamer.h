@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "NodePool.h"
+#include "TiledWorld.h"
+
+// Loads and evicts tiles around the camera on worker threads and composes the resident ones
+// into a single DAG rooted at node 0 of the shared pool
+class TileStreamer
+{
+public:
+	TileStreamer(std::shared_ptr<TiledWorld> world, size_t memoryBudget, uint32_t workerCount = 2);
+	~TileStreamer();
+
+	void update(const glm::vec3& cameraPosition, const glm::vec3& cameraVelocity);
+	bool compose(NodePool& nodes);
+
+	// Edited tiles hold nodes outside their range and must stay resident. Cells without a tile, or with an empty
+	// one, are always resident and start out empty
+	bool isResident(const glm::uvec3& voxelMin, const glm::uvec3& voxelMax) const;
+	void pinTiles(const glm::uvec3& voxelMin, const glm::uvec3& voxelMax);
+
+	void setLoadRadius(float tiles) { loadRadius = tiles; }
+	void setLookahead(float seconds) { lookahead = seconds; }
+	size_t getResidentBytes() const { return residentBytes; }
+	size_t getResidentTileCount() const { return residentTiles; }
+	size_t getPendingTileCount() const;
+private:
+	enum TileState : uint8_t {
+		TILE_UNLOADED,
+		TILE_REQUESTED,
+		TILE_RESIDENT,
+		TILE_FAILED,
+	};
+
+	struct TileSlot {
+		TileState state = TILE_UNLOADED;
+		bool wanted = false;
+		bool pinned = false;
+		uint32_t root = 0;
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	struct LoadedTile {
+		uint32_t tile;
+		std::vector<SVDAGGPUNode> nodes;
+	};
+
+	struct TopChild {
+		uint32_t index;
+		bool local;
+	};
+
+	std::shared_ptr<TiledWorld> world;
+	size_t memoryBudget;
+	float loadRadius = 4.0f;
+	float lookahead = 1.0f;
+
+	std::vector<TileSlot> slots;
+	// Roots of pinned cells that have no tile to load, so what was edited into them survives the next compose
+	std::unordered_map<uint64_t, uint32_t> emptyCellRoots;
+	std::vector<std::pair<uint32_t, uint32_t>> evictedRanges;
+	size_t residentBytes = 0;
+	size_t residentTiles = 0;
+
+	mutable std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::vector<uint32_t> requests;
+	std::unordered_set<uint32_t> inFlight;
+	std::vector<LoadedTile> finished;
+	std::vector<uint32_t> failed;
+	bool stopping = false;
+	std::vector<std::thread> workers;
+
+	std::map<uint32_t, uint32_t> freeRanges;
+	uint32_t topFirst = 0;
+	uint32_t topCount = 0;
+	bool topDirty = true;
+
+	void workerLoop();
+	uint32_t allocateRange(NodePool& nodes, uint32_t count);
+	void freeRange(uint32_t first, uint32_t count);
+	void refreshTileRoots(const NodePool& nodes);
+	void rebuildTopLevel(NodePool& nodes);
+	TopChild buildTopNode(const NodePool& nodes, const glm::uvec3& cell, uint32_t size, std::vector<SVDAGGPUNode>& topNodes, std::vector<uint8_t>& localMasks) const;
+	uint32_t tileRoot(const glm::uvec3& tile) const;
+	uint32_t composedRoot(const NodePool& nodes, const glm::uvec3& tile) const;
+	bool isEmptyCell(int tile) const;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DAGFile.h"
+
+// A grid of DAG tiles placed under a power-of-two top level, addressed in global voxel coordinates
+class TiledWorld
+{
+public:
+	bool open(const std::string& indexPath);
+
+	uint32_t getTileDepth() const { return header.tileDepth; }
+	uint32_t getTopLevels() const { return topLevels; }
+	uint32_t getDepth() const { return topLevels + header.tileDepth; }
+	uint32_t getTileResolution() const { return 1u << header.tileDepth; }
+	uint32_t getGridResolution() const { return 1u << topLevels; }
+	glm::uvec3 getGridSize() const { return glm::uvec3(header.gridSize[0], header.gridSize[1], header.gridSize[2]); }
+
+	const std::vector<DAGWorldTile>& getTiles() const { return tiles; }
+	int findTile(const glm::uvec3& tile) const;
+	std::string getTilePath(uint32_t tileIndex) const { return directory + tiles[tileIndex].fileName; }
+
+	glm::uvec3 tileOf(const glm::uvec3& voxel) const { return voxel >> header.tileDepth; }
+	glm::uvec3 localVoxel(const glm::uvec3& voxel) const { return voxel & glm::uvec3(getTileResolution() - 1); }
+	glm::vec3 voxelToWorld(const glm::uvec3& voxel) const { return (glm::vec3(voxel) + 0.5f) / static_cast<float>(1u << getDepth()); }
+	glm::uvec3 worldToVoxel(const glm::vec3& position) const;
+private:
+	std::string directory;
+	DAGWorldHeader header = {};
+	std::vector<DAGWorldTile> tiles;
+	std::unordered_map<uint64_t, uint32_t> tileLookup;
+	uint32_t topLevels = 0;
+
+	static uint64_t tileKey(const glm::uvec3& tile) { return (uint64_t(tile.z) << 42) | (uint64_t(tile.y) << 21) | tile.x; }
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <vector>
+
+#include "NodePool.h"
+#include "SVDAGNode.h"
+
+// Receives the copies an upload plan decides on, in order
+class NodeUploadSink
+{
+public:
+	virtual ~NodeUploadSink() = default;
+	virtual void upload(size_t first, size_t count, const SVDAGGPUNode* nodes) = 0;
+};
+
+// Writes into a shader storage buffer, which stays bound while the sink lives
+class GLNodeUploadSink : public NodeUploadSink
+{
+public:
+	explicit GLNodeUploadSink(GLuint buffer);
+	~GLNodeUploadSink() override;
+	void upload(size_t first, size_t count, const SVDAGGPUNode* nodes) override;
+};
+
+// Mirrors the buffer in memory and counts the copies, for checking and timing plans without a GL context
+class MemoryNodeUploadSink : public NodeUploadSink
+{
+public:
+	void upload(size_t first, size_t count, const SVDAGGPUNode* nodes) override;
+
+	std::vector<SVDAGGPUNode> nodes;
+	size_t commands = 0;
+	size_t bytes = 0;
+};
+
+// Turns dirty pages into as few copies as possible. Clean gaps up to the tolerance are uploaded along with their
+// neighbours, since the GPU already holds the same nodes, and no single copy is larger than the staging budget
+class UploadPlanner
+{
+public:
+	void setGapTolerance(size_t nodes) { gapNodes = nodes; }
+	void setStagingBudget(size_t bytes) { stagingBytes = bytes; }
+
+	// Returns the number of nodes uploaded; the pool's dirty pages are left for the caller to clear
+	size_t upload(const NodePool& nodes, NodeUploadSink& sink) const;
+	// Staged ranges are copied in order, merging only those that follow each other in the pool and the stage
+	size_t upload(const StagedNodes& staged, NodeUploadSink& sink) const;
+private:
+	size_t gapNodes = 2 * NODE_PAGE_SIZE;
+	size_t stagingBytes = size_t(1) << 20;
+
+	size_t emit(size_t first, size_t count, const SVDAGGPUNode* nodes, NodeUploadSink& sink) const;
+};
@@ -1,7 +1,7 @@
 #include "Brush.h"
 
-Brush::Brush(std::shared_ptr<Camera> camera, std::shared_ptr<SVDAGLoader> svdagLoader, std::shared_ptr<SVDAGEditor> svdagEditor)
-	: camera(camera), svdagLoader(svdagLoader), svdagEditor(svdagEditor)
+Brush::Brush(std::shared_ptr<Camera> camera, std::shared_ptr<SVDAGLoader> svdagLoader, std::shared_ptr<EditWorker> editWorker)
+	: camera(camera), svdagLoader(svdagLoader), editWorker(editWorker)
 {
 	brushShader = std::make_unique<Shader>(GL_COMPUTE_SHADER, "shaders/brushData.comp");
 	brushProgram = std::make_unique<GPUProgram>(brushShader.get());
@@ -53,66 +53,32 @@ BrushData Brush::getBrushData() {
  
 
 void Brush::sphere(glm::vec3 center, float radius, bool isAdding, uint16_t material) {
-    const float voxelSize = 1.0f / exp2f(svdagLoader->getDepth());
+    const float resolution = exp2f(svdagLoader->getDepth());
 
-    glm::vec3 minWorld = center - glm::vec3(radius);
-    glm::vec3 maxWorld = center + glm::vec3(radius);
-
-    glm::ivec3 minGrid = glm::floor(minWorld / voxelSize);
-    glm::ivec3 maxGrid = glm::ceil(maxWorld / voxelSize);
-
-    minGrid = glm::clamp(minGrid, glm::ivec3(0), glm::ivec3(1.0f / voxelSize - 1.0f));
-    maxGrid = glm::clamp(maxGrid, glm::ivec3(0), glm::ivec3(1.0f / voxelSize - 1.0f));
-
-    for (int z = minGrid.z; z <= maxGrid.z; ++z) {
-        for (int y = minGrid.y; y <= maxGrid.y; ++y) {
-            for (int x = minGrid.x; x <= maxGrid.x; ++x) {
-
-                glm::vec3 voxelPos = (glm::vec3(x, y, z) + 0.5f) * voxelSize;
-
-                if (glm::distance(voxelPos, center) <= radius) {
-
-                    if (isAdding) {
-                        svdagEditor->setVoxel(voxelPos, material);
-                    }
-                    else {
-                        svdagEditor->clearVoxel(voxelPos);
-                    }
-                }
-            }
-        }
-    }
+    SDFShape shape = SDFShape::sphere(center * resolution, radius * resolution);
+    editWorker->modifyShape(shape, isAdding ? VOXEL_SET : VOXEL_CLEAR, material);
 }
 
 void Brush::paint(glm::vec3 center, float radius, uint16_t material) {
-    const float voxelSize = 1.0f / exp2f(svdagLoader->getDepth());
-
-    glm::vec3 minWorld = center - glm::vec3(radius);
-    glm::vec3 maxWorld = center + glm::vec3(radius);
-
-    glm::ivec3 minGrid = glm::floor(minWorld / voxelSize);
-    glm::ivec3 maxGrid = glm::ceil(maxWorld / voxelSize);
+    const float resolution = exp2f(svdagLoader->getDepth());
 
-    minGrid = glm::clamp(minGrid, glm::ivec3(0), glm::ivec3(1.0f / voxelSize - 1.0f));
-    maxGrid = glm::clamp(maxGrid, glm::ivec3(0), glm::ivec3(1.0f / voxelSize - 1.0f));
-
-    for (int z = minGrid.z; z <= maxGrid.z; ++z) {
-        for (int y = minGrid.y; y <= maxGrid.y; ++y) {
-            for (int x = minGrid.x; x <= maxGrid.x; ++x) {
-
-                glm::vec3 voxelPos = (glm::vec3(x, y, z) + 0.5f) * voxelSize;
+    SDFShape shape = SDFShape::sphere(center * resolution, radius * resolution);
+    editWorker->modifyShape(shape, VOXEL_PAINT, material);
+}
 
-                if (glm::distance(voxelPos, center) <= radius) {
+void Brush::box(glm::vec3 p1, glm::vec3 p2, bool isAdding, uint16_t material) {
+    editWorker->modifyRegion(voxelBox(p1, p2), isAdding, material);
+}
 
-                    svdagEditor->paintVoxel(voxelPos, material);
+void Brush::copy(glm::vec3 p1, glm::vec3 p2) {
+    editWorker->copyRegion(voxelBox(p1, p2));
+}
 
-                }
-            }
-        }
-    }
+void Brush::paste(glm::vec3 position) {
+    editWorker->paste(voxelBox(position, position).min);
 }
 
-void Brush::box(glm::vec3 p1, glm::vec3 p2, bool isAdding, uint16_t material) {
+Box Brush::voxelBox(glm::vec3 p1, glm::vec3 p2) const {
     size_t resolution = static_cast<size_t>(exp2f(svdagLoader->getDepth()));
     const float voxelSize = 1.0f / resolution;
 
@@ -123,35 +89,9 @@ void Brush::box(glm::vec3 p1, glm::vec3 p2, bool isAdding, uint16_t material) {
     boxMin = glm::clamp(boxMin, glm::ivec3(0), maxCoord);
     boxMax = glm::clamp(boxMax, glm::ivec3(0), maxCoord);
 
-    Box targetBox = { boxMin, boxMax };
-
-    svdagEditor->modifyRegion(targetBox, isAdding, material);
+    return { boxMin, boxMax };
 }
 
 void Brush::uploadChangesToGPU() {
-    const auto& modified = svdagEditor->getModifiedIndices();
-    const auto& nodes = svdagLoader->getNodes();
-    size_t newNodesStart = svdagEditor->getNewNodesStartIndex();
-
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, svdagLoader->getNodeBufferID());
-
-    for (uint32_t index : modified) {
-        if (index < newNodesStart) {
-            glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                index * sizeof(SVDAGGPUNode),
-                sizeof(SVDAGGPUNode),
-                &nodes[index]);
-        }
-    }
-
-    if (nodes.size() > newNodesStart) {
-        glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-            newNodesStart * sizeof(SVDAGGPUNode),
-            (nodes.size() - newNodesStart) * sizeof(SVDAGGPUNode),
-            &nodes[newNodesStart]);
-    }
-
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-    svdagEditor->clearModifiedLists();
-}
\ No newline at end of file
+    editWorker->uploadPublished(*svdagLoader);
+}
@@ -0,0 +1,300 @@
+#include "CPURenderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <execution>
+#include <fstream>
+#include <numeric>
+
+namespace {
+	bool rayBoxIntersection(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& boxMin, const glm::vec3& boxMax, float& tNear, float& tFar) {
+		glm::vec3 invRayDir = 1.0f / rayDir;
+
+		glm::bvec3 sign = glm::lessThan(invRayDir, glm::vec3(0.0f));
+		glm::vec3 bbox1 = glm::mix(boxMin, boxMax, sign);
+		glm::vec3 bbox2 = glm::mix(boxMax, boxMin, sign);
+
+		glm::vec3 tMin = (bbox1 - rayOrigin) * invRayDir;
+		glm::vec3 tMax = (bbox2 - rayOrigin) * invRayDir;
+
+		tNear = std::max(std::max(tMin.x, tMin.y), tMin.z);
+		tFar = std::min(std::min(tMax.x, tMax.y), tMax.z);
+
+		return tNear <= tFar && tFar > 0.0f;
+	}
+
+	uint8_t toByte(float value) {
+		return static_cast<uint8_t>(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+CPURenderer::CPURenderer(const NodePool& nodes, uint32_t depth)
+	: nodes(nodes), treeDepth(depth)
+{
+}
+
+float CPURenderer::traverseOctree(const glm::vec3& p, const glm::vec3& rayDir, uint32_t& material) const
+{
+	const float epsilon = 1e-6f;
+	glm::vec3 rayPos = p + rayDir * epsilon;
+
+	uint32_t nodeIndex = 0;
+	float nodeSize = 1.0f;
+	glm::vec3 nodeCenter(0.5f);
+
+	for (int depth = 0; depth < static_cast<int>(treeDepth); depth++) {
+		const SVDAGGPUNode& node = nodes[nodeIndex];
+
+		if (node.childMask == 0xFFu && node.children[0] == 0u) {
+			material = node.material;
+			return 0.0f;
+		}
+
+		if (node.childMask == 0u) {
+			glm::vec3 nodeMin = nodeCenter - glm::vec3(nodeSize * 0.5f);
+			glm::vec3 nodeMax = nodeCenter + glm::vec3(nodeSize * 0.5f);
+
+			float exitDist = 0.0f;
+			bool hasValidExit = false;
+			for (int axis = 0; axis < 3; axis++) {
+				float planeDist = rayDir[axis] > 0.0f ?
+					(nodeMax[axis] - rayPos[axis]) / rayDir[axis] :
+					(nodeMin[axis] - rayPos[axis]) / rayDir[axis];
+
+				if (planeDist > 0.0f) {
+					if (!hasValidExit || planeDist < exitDist) {
+						exitDist = planeDist;
+						hasValidExit = true;
+					}
+				}
+			}
+
+			if (!hasValidExit) exitDist = nodeSize * 0.1f;
+
+			return std::max(exitDist * 0.95f, nodeSize * 0.01f);
+		}
+
+		uint32_t octant = 0;
+		octant |= (rayPos.x > nodeCenter.x) ? 1 : 0;
+		octant |= (rayPos.y > nodeCenter.y) ? 2 : 0;
+		octant |= (rayPos.z > nodeCenter.z) ? 4 : 0;
+
+		uint32_t childBit = 1u << octant;
+
+		if (depth == static_cast<int>(treeDepth) - 1 && (node.childMask & childBit) != 0) {
+			material = node.material;
+			return 0.0f;
+		}
+
+		if ((node.childMask & childBit) == 0) {
+			glm::vec3 octantMin = nodeCenter;
+			glm::vec3 octantMax = nodeCenter;
+			for (int axis = 0; axis < 3; axis++) {
+				if ((octant & (1u << axis)) != 0) {
+					octantMax[axis] = nodeCenter[axis] + nodeSize * 0.5f;
+				}
+				else {
+					octantMin[axis] = nodeCenter[axis] - nodeSize * 0.5f;
+				}
+			}
+
+			glm::vec3 t1 = (octantMin - rayPos) / (rayDir + glm::vec3(1e-8f));
+			glm::vec3 t2 = (octantMax - rayPos) / (rayDir + glm::vec3(1e-8f));
+
+			glm::vec3 tMax = glm::max(t1, t2);
+			float exitDist = std::min(std::min(tMax.x, tMax.y), tMax.z);
+
+			return std::max(exitDist * 0.95f, nodeSize * 0.01f);
+		}
+
+		uint32_t nextIndex = node.children[octant];
+		if (nextIndex == 0u) {
+			return nodeSize * 0.01f;
+		}
+
+		nodeIndex = nextIndex;
+		nodeSize *= 0.5f;
+		nodeCenter += nodeSize * glm::vec3(
+			(octant & 1) != 0 ? 0.5f : -0.5f,
+			(octant & 2) != 0 ? 0.5f : -0.5f,
+			(octant & 4) != 0 ? 0.5f : -0.5f
+		);
+	}
+
+	return nodeSize * 0.01f;
+}
+
+RayHit CPURenderer::castRay(const glm::vec3& origin, const glm::vec3& direction) const
+{
+	RayHit hit = { false, 0, 0, origin };
+	glm::vec3 worldMin(0.0f);
+	glm::vec3 worldMax(1.0f);
+
+	float tNear, tFar;
+	if (nodes.empty() || !rayBoxIntersection(origin, direction, worldMin, worldMax, tNear, tFar)) {
+		return hit;
+	}
+
+	float tStart = std::max(tNear, 0.0f);
+	float tEnd = tFar;
+	if (tStart >= tEnd) {
+		return hit;
+	}
+
+	glm::vec3 p = origin + direction * (tStart + 1e-5f);
+	for (uint32_t i = 0; i < 1024; i++) {
+		hit.steps = i;
+
+		if (glm::any(glm::lessThan(p, worldMin)) || glm::any(glm::greaterThan(p, worldMax))) {
+			break;
+		}
+		if (glm::length(p - origin) > tEnd) {
+			break;
+		}
+
+		uint32_t material = 0;
+		float stepSize = traverseOctree(p, direction, material);
+		if (stepSize == 0.0f) {
+			hit.found = true;
+			hit.material = static_cast<uint16_t>(material);
+			break;
+		}
+
+		p += direction * stepSize;
+	}
+	hit.position = p;
+	return hit;
+}
+
+glm::vec3 CPURenderer::shade(const RayHit& hit) const
+{
+	if (!hit.found) {
+		return glm::vec3(0.0f);
+	}
+	if (visualizeSteps) {
+		return plasmaQuintic(static_cast<float>(hit.steps) / 128.0f);
+	}
+	return getColorFromMaterial(hit.material);
+}
+
+glm::vec3 CPURenderer::getColorFromMaterial(uint32_t material)
+{
+	uint32_t redValue = (material & 0xF800u) >> 11;
+	uint32_t greenValue = (material & 0x7E0u) >> 5;
+	uint32_t blueValue = material & 0x1Fu;
+
+	return glm::vec3((redValue << 3) / 256.0f, (greenValue << 2) / 256.0f, (blueValue << 3) / 256.0f);
+}
+
+glm::vec3 CPURenderer::plasmaQuintic(float x)
+{
+	x = glm::clamp(x, 0.0f, 1.0f);
+	glm::vec4 x1(1.0f, x, x * x, x * x * x);
+	glm::vec4 x2 = x1 * x1.w * x;
+	return glm::clamp(glm::vec3(
+		glm::dot(x1, glm::vec4(+0.063861086f, +1.992659096f, -1.023901152f, -0.490832805f)) + glm::dot(glm::vec2(x2.x, x2.y), glm::vec2(+1.308442123f, -0.914547012f)),
+		glm::dot(x1, glm::vec4(+0.049718590f, -0.791144343f, +2.892305078f, +0.811726816f)) + glm::dot(glm::vec2(x2.x, x2.y), glm::vec2(-4.686502417f, +2.717794514f)),
+		glm::dot(x1, glm::vec4(+0.513275779f, +1.580255060f, -5.164414457f, +4.559573646f)) + glm::dot(glm::vec2(x2.x, x2.y), glm::vec2(-1.916810682f, +0.570638854f))),
+		glm::vec3(0.0f), glm::vec3(1.0f));
+}
+
+// Pixel (x, y) is the invocation render.comp runs for it, whose y grows upwards, so it lands in row height - 1 - y
+RenderStatistics CPURenderer::render(const RenderView& view, CPUImage& image) const
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	image.pixels.assign(size_t(image.width) * image.height, glm::vec3(0.0f));
+
+	uint32_t tilesX = (image.width + tileSize - 1) / tileSize;
+	uint32_t tilesY = (image.height + tileSize - 1) / tileSize;
+	std::vector<uint32_t> tiles(size_t(tilesX) * tilesY);
+	std::iota(tiles.begin(), tiles.end(), 0u);
+
+	std::atomic<uint64_t> totalSteps = 0;
+	glm::vec2 viewportSize(image.width, image.height);
+	std::for_each(std::execution::par, tiles.begin(), tiles.end(), [&](uint32_t tile) {
+		uint32_t firstX = (tile % tilesX) * tileSize;
+		uint32_t firstY = (tile / tilesX) * tileSize;
+		uint32_t lastX = std::min(firstX + tileSize, image.width);
+		uint32_t lastY = std::min(firstY + tileSize, image.height);
+
+		uint64_t steps = 0;
+		for (uint32_t y = firstY; y < lastY; y++) {
+			for (uint32_t x = firstX; x < lastX; x++) {
+				glm::vec2 uv = (glm::vec2(x, y) / viewportSize) * 2.0f - 1.0f;
+				glm::vec4 rayDir = glm::vec4(uv, 1.0f, 1.0f) * view.rayDirMatrix;
+				glm::vec3 d = glm::normalize(glm::vec3(rayDir));
+
+				RayHit hit = castRay(view.position, d);
+				steps += hit.steps;
+				image.pixels[size_t(image.height - 1 - y) * image.width + x] = shade(hit);
+			}
+		}
+		totalSteps += steps;
+		});
+
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return { uint64_t(image.width) * image.height, totalSteps.load(), elapsed.count() };
+}
+
+bool CPUImage::writePPM(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		printf("Failed to open %s for writing\n", path.c_str());
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<uint8_t> bytes(pixels.size() * 3);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		bytes[i * 3 + 0] = toByte(pixels[i].r);
+		bytes[i * 3 + 1] = toByte(pixels[i].g);
+		bytes[i * 3 + 2] = toByte(pixels[i].b);
+	}
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return static_cast<bool>(file);
+}
+
+bool CPUImage::readPPM(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string magic;
+	uint32_t maxValue = 0;
+	if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255) {
+		printf("%s is not an 8-bit binary PPM\n", path.c_str());
+		return false;
+	}
+	file.get();
+
+	std::vector<uint8_t> bytes(size_t(width) * height * 3);
+	if (!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) {
+		printf("%s is truncated\n", path.c_str());
+		return false;
+	}
+	pixels.resize(size_t(width) * height);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		pixels[i] = glm::vec3(bytes[i * 3], bytes[i * 3 + 1], bytes[i * 3 + 2]) / 255.0f;
+	}
+	return true;
+}
+
+bool CPUImage::compare(const CPUImage& other, uint32_t& maxDifference, double& meanDifference) const
+{
+	maxDifference = 0;
+	meanDifference = 0.0;
+	if (width != other.width || height != other.height) {
+		return false;
+	}
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < pixels.size(); i++) {
+		for (int channel = 0; channel < 3; channel++) {
+			uint32_t difference = static_cast<uint32_t>(std::abs(toByte(pixels[i][channel]) - toByte(other.pixels[i][channel])));
+			maxDifference = std::max(maxDifference, difference);
+			sum += difference;
+		}
+	}
+	meanDifference = pixels.empty() ? 0.0 : static_cast<double>(sum) / (pixels.size() * 3);
+	return true;
+}
@@ -1,8 +1,5 @@
 #include "Camera.h"
 
-#define GLFW_INCLUDE_NONE
-#include <GLFW/glfw3.h>
-
 using namespace glm;
 Camera::Camera()
 {
@@ -44,28 +41,51 @@ void Camera::setAspectRatio(float aspectRatio)
 }
 
 void Camera::move(std::set<int> keysPressed, float dt)
+{
+    setPosition(position + movement(keysPressed, dt));
+}
+
+vec3 Camera::movement(std::set<int> keysPressed, float dt)
 {
     float speed = 0.2f * dt;
+    vec3 offset(0.0f);
 
     if (keysPressed.count('w')) {
-        position += speed * ahead;
+        offset += speed * ahead;
     }
     if (keysPressed.count('s')) {
-        position -= speed * ahead;
+        offset -= speed * ahead;
     }
     if (keysPressed.count('a')) {
-        position -= speed * right;
+        offset -= speed * right;
     }
     if (keysPressed.count('d')) {
-        position += speed * right;
+        offset += speed * right;
     }
     if (keysPressed.count('q')) {
-        position += speed * up;
+        offset += speed * up;
     }
     if (keysPressed.count('e')) {
-        position -= speed * up;
+        offset -= speed * up;
     }
+    return offset;
+}
 
+void Camera::setPosition(const vec3& newPosition)
+{
+    position = newPosition;
+    update();
+}
+
+void Camera::setOrientation(float newYaw, float newPitch)
+{
+    yaw = newYaw;
+    pitch = newPitch;
+    update();
+
+    ahead = vec4(0, 0, 1, 0) * rotationMatrix;
+    right = vec4(1, 0, 0, 0) * rotationMatrix;
+    up = vec4(0, 1, 0, 0) * rotationMatrix;
     update();
 }
 
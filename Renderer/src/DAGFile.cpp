@@ -0,0 +1,351 @@
+#include "DAGFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+FILE* openFile(const std::string& path, const char* mode)
+{
+#ifdef _WIN32
+	FILE* file = nullptr;
+	return fopen_s(&file, path.c_str(), mode) == 0 ? file : nullptr;
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+bool syncFile(FILE* file)
+{
+	if (fflush(file) != 0) return false;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+// On POSIX the rename is only durable once the directory holding it has been synced as well
+bool replaceFile(const std::string& source, const std::string& target)
+{
+#ifdef _WIN32
+	if (!MoveFileExW(std::filesystem::path(source).c_str(), std::filesystem::path(target).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		printf("Failed to replace %s (error %lu)\n", target.c_str(), GetLastError());
+		return false;
+	}
+	return true;
+#else
+	std::error_code error;
+	std::filesystem::rename(source, target, error);
+	if (error) {
+		printf("Failed to replace %s: %s\n", target.c_str(), error.message().c_str());
+		return false;
+	}
+
+	std::filesystem::path directory = std::filesystem::path(target).parent_path();
+	int descriptor = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		printf("Failed to open the directory of %s\n", target.c_str());
+		return false;
+	}
+	bool synced = fsync(descriptor) == 0;
+	::close(descriptor);
+	if (!synced) {
+		printf("Failed to sync the directory of %s\n", target.c_str());
+	}
+	return synced;
+#endif
+}
+
+uint64_t dagBlockChecksum(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	size_t words = size / sizeof(uint64_t);
+	for (size_t i = 0; i < words; i++) {
+		uint64_t word;
+		std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+		hash = (hash ^ word) * 0x100000001b3ull;
+	}
+	for (size_t i = words * sizeof(uint64_t); i < size; i++) {
+		hash = (hash ^ data[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+uint64_t dagChecksum(const std::vector<uint64_t>& blockChecksums)
+{
+	return dagBlockChecksum(reinterpret_cast<const uint8_t*>(blockChecksums.data()), blockChecksums.size() * sizeof(uint64_t));
+}
+
+uint64_t dagHeaderChecksum(const DAGFileHeader& header)
+{
+	return dagBlockChecksum(reinterpret_cast<const uint8_t*>(&header), offsetof(DAGFileHeader, headerChecksum));
+}
+
+bool isDAGFile(const uint8_t* data, size_t size)
+{
+	uint32_t magic = 0;
+	if (size < sizeof(magic)) return false;
+	std::memcpy(&magic, data, sizeof(magic));
+	return magic == DAG_FILE_MAGIC;
+}
+
+bool readDAGFileHeader(const uint8_t* data, size_t size, DAGFileHeader& outHeader)
+{
+	if (size < sizeof(DAGFileHeader)) {
+		printf("DAG file is truncated\n");
+		return false;
+	}
+	std::memcpy(&outHeader, data, sizeof(DAGFileHeader));
+
+	if (outHeader.magic != DAG_FILE_MAGIC || outHeader.version != DAG_FILE_VERSION || outHeader.headerSize != sizeof(DAGFileHeader)) {
+		printf("Unsupported DAG file version %u\n", outHeader.version);
+		return false;
+	}
+	if (outHeader.headerChecksum != dagHeaderChecksum(outHeader)) {
+		printf("DAG file header checksum mismatch\n");
+		return false;
+	}
+	if ((outHeader.layoutFlags & DAG_LAYOUT_STD430) == 0 || (outHeader.layoutFlags & DAG_LAYOUT_LITTLE_ENDIAN) == 0 ||
+		outHeader.nodeSize != sizeof(SVDAGGPUNode)) {
+		printf("Unsupported DAG node layout (flags 0x%x, %u byte nodes)\n", outHeader.layoutFlags, outHeader.nodeSize);
+		return false;
+	}
+	if (outHeader.depth == 0 || outHeader.depth > DAG_MAX_DEPTH) {
+		printf("Unsupported DAG depth %u, expected 1 to %u\n", outHeader.depth, DAG_MAX_DEPTH);
+		return false;
+	}
+	if (outHeader.dataOffset % DAG_FILE_DATA_ALIGNMENT != 0 || outHeader.dataOffset > size || outHeader.dataSize > size - outHeader.dataOffset) {
+		printf("DAG file is truncated\n");
+		return false;
+	}
+	if (outHeader.encoding == DAG_ENCODING_RAW && outHeader.dataSize != outHeader.nodeCount * sizeof(SVDAGGPUNode)) {
+		printf("DAG node array size does not match node count\n");
+		return false;
+	}
+	if (outHeader.encoding == DAG_ENCODING_BLOCK_VARINT) {
+		if (outHeader.blockNodeCount == 0 ||
+			outHeader.blockCount != (outHeader.nodeCount + outHeader.blockNodeCount - 1) / outHeader.blockNodeCount ||
+			outHeader.blockTableOffset + (outHeader.blockCount + 1ull) * sizeof(uint64_t) != outHeader.dataSize) {
+			printf("DAG block table does not match node count\n");
+			return false;
+		}
+	}
+	else if (outHeader.encoding != DAG_ENCODING_RAW) {
+		printf("Unsupported DAG encoding %u\n", outHeader.encoding);
+		return false;
+	}
+	return true;
+}
+
+bool verifyDAGFileData(const uint8_t* data, const DAGFileHeader& header)
+{
+	size_t blockCount = static_cast<size_t>((header.dataSize + DAG_CHECKSUM_BLOCK_SIZE - 1) / DAG_CHECKSUM_BLOCK_SIZE);
+	std::vector<uint64_t> blockChecksums(blockCount);
+	std::vector<size_t> blocks(blockCount);
+	std::iota(blocks.begin(), blocks.end(), size_t{ 0 });
+
+	const uint8_t* payload = data + header.dataOffset;
+	std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](size_t block) {
+		size_t offset = block * DAG_CHECKSUM_BLOCK_SIZE;
+		size_t size = std::min<size_t>(DAG_CHECKSUM_BLOCK_SIZE, static_cast<size_t>(header.dataSize) - offset);
+		blockChecksums[block] = dagBlockChecksum(payload + offset, size);
+		});
+
+	if (dagChecksum(blockChecksums) != header.dataChecksum) {
+		printf("DAG file data checksum mismatch\n");
+		return false;
+	}
+	return true;
+}
+
+namespace {
+	bool readVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (cursor == end) return false;
+			uint8_t byte = *cursor++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return true;
+		}
+		return false;
+	}
+
+	int64_t unzigzag(uint64_t value)
+	{
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	bool decodeBlock(const uint8_t* cursor, const uint8_t* end, uint64_t firstIndex, size_t count, SVDAGGPUNode* outNodes)
+	{
+		int64_t previousMaterial = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			if (end - cursor < 2) return false;
+
+			SVDAGGPUNode node = {};
+			node.childMask = *cursor++;
+			uint8_t childPresent = *cursor++;
+
+			uint64_t refs, material;
+			if (!readVarint(cursor, end, refs) || !readVarint(cursor, end, material)) return false;
+			node.refs = static_cast<uint32_t>(refs);
+			previousMaterial += unzigzag(material);
+			node.material = static_cast<uint16_t>(previousMaterial);
+
+			int64_t reference = static_cast<int64_t>(firstIndex + i);
+			for (int c = 0; c < 8; c++) {
+				if ((childPresent & (1 << c)) == 0) continue;
+
+				uint64_t delta;
+				if (!readVarint(cursor, end, delta)) return false;
+				reference += unzigzag(delta);
+				node.children[c] = static_cast<uint32_t>(reference);
+			}
+
+			outNodes[i] = node;
+		}
+		return cursor == end;
+	}
+}
+
+bool decodeDAGBlock(const uint8_t* data, const DAGFileHeader& header, uint32_t block, SVDAGGPUNode* outNodes)
+{
+	const uint8_t* payload = data + header.dataOffset;
+	uint64_t range[2];
+	std::memcpy(range, payload + header.blockTableOffset + block * sizeof(uint64_t), sizeof(range));
+	if (range[0] > range[1] || range[1] > header.blockTableOffset) {
+		return false;
+	}
+
+	uint64_t firstIndex = static_cast<uint64_t>(block) * header.blockNodeCount;
+	size_t count = static_cast<size_t>(std::min<uint64_t>(header.blockNodeCount, header.nodeCount - firstIndex));
+	return decodeBlock(payload + range[0], payload + range[1], firstIndex, count, outNodes);
+}
+
+bool decodeDAGBlocks(const uint8_t* data, const DAGFileHeader& header, SVDAGGPUNode* outNodes)
+{
+	std::vector<uint32_t> blocks(header.blockCount);
+	std::iota(blocks.begin(), blocks.end(), 0u);
+
+	std::atomic<bool> failed = false;
+	std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](uint32_t block) {
+		if (!decodeDAGBlock(data, header, block, outNodes + static_cast<size_t>(block) * header.blockNodeCount)) {
+			failed = true;
+		}
+		});
+
+	if (failed) {
+		printf("DAG file contains a corrupt block\n");
+		return false;
+	}
+	return true;
+}
+
+bool readDAGFileNodes(const uint8_t* data, size_t size, DAGFileHeader& outHeader, std::vector<SVDAGGPUNode>& outNodes)
+{
+	if (!readDAGFileHeader(data, size, outHeader) || !verifyDAGFileData(data, outHeader)) {
+		return false;
+	}
+
+	outNodes.resize(outHeader.nodeCount);
+	if (outHeader.encoding == DAG_ENCODING_BLOCK_VARINT) {
+		return decodeDAGBlocks(data, outHeader, outNodes.data());
+	}
+	std::memcpy(outNodes.data(), data + outHeader.dataOffset, outNodes.size() * sizeof(SVDAGGPUNode));
+	return true;
+}
+
+bool writeDAGFile(const std::string& path, uint32_t depth, uint32_t maxRefs, const std::vector<SVDAGGPUNode>& nodes, uint64_t journalSequence)
+{
+	DAGFileHeader header = {};
+	header.magic = DAG_FILE_MAGIC;
+	header.version = DAG_FILE_VERSION;
+	header.headerSize = sizeof(DAGFileHeader);
+	header.nodeSize = sizeof(SVDAGGPUNode);
+	header.depth = depth;
+	header.maxRefs = maxRefs;
+	header.layoutFlags = DAG_LAYOUT_STD430 | DAG_LAYOUT_LITTLE_ENDIAN;
+	header.encoding = DAG_ENCODING_RAW;
+	header.nodeCount = nodes.size();
+	header.dataOffset = DAG_FILE_DATA_ALIGNMENT;
+	header.dataSize = nodes.size() * sizeof(SVDAGGPUNode);
+	header.journalSequence = journalSequence;
+
+	const uint8_t* payload = reinterpret_cast<const uint8_t*>(nodes.data());
+	std::vector<uint64_t> blockChecksums;
+	for (uint64_t offset = 0; offset < header.dataSize; offset += DAG_CHECKSUM_BLOCK_SIZE) {
+		size_t size = std::min<size_t>(DAG_CHECKSUM_BLOCK_SIZE, static_cast<size_t>(header.dataSize - offset));
+		blockChecksums.push_back(dagBlockChecksum(payload + offset, size));
+	}
+	header.dataChecksum = dagChecksum(blockChecksums);
+	header.headerChecksum = dagHeaderChecksum(header);
+
+	// Write to a temporary file first so a failed save never clobbers the previous world, and make it durable before
+	// it replaces the world, or a crash could leave an empty file in its place
+	std::string temporaryPath = path + ".tmp";
+	FILE* file = openFile(temporaryPath, "wb");
+	if (!file) {
+		printf("Failed to open %s for writing\n", temporaryPath.c_str());
+		return false;
+	}
+
+	std::vector<char> prefix(DAG_FILE_DATA_ALIGNMENT, 0);
+	std::memcpy(prefix.data(), &header, sizeof(header));
+	bool ok = fwrite(prefix.data(), prefix.size(), 1, file) == 1 &&
+		(header.dataSize == 0 || fwrite(payload, static_cast<size_t>(header.dataSize), 1, file) == 1) && syncFile(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		printf("Failed to write %s\n", temporaryPath.c_str());
+		std::error_code error;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+
+	return replaceFile(temporaryPath, path);
+}
+
+bool readDAGWorldIndex(const std::string& path, DAGWorldHeader& outHeader, std::vector<DAGWorldTile>& outTiles)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.read(reinterpret_cast<char*>(&outHeader), sizeof(outHeader))) {
+		printf("Failed to read %s\n", path.c_str());
+		return false;
+	}
+	if (outHeader.magic != DAG_WORLD_MAGIC || outHeader.version != DAG_WORLD_VERSION ||
+		outHeader.headerChecksum != dagBlockChecksum(reinterpret_cast<const uint8_t*>(&outHeader), offsetof(DAGWorldHeader, headerChecksum))) {
+		printf("%s is not a supported world index\n", path.c_str());
+		return false;
+	}
+
+	outTiles.resize(outHeader.tileCount);
+	if (!file.read(reinterpret_cast<char*>(outTiles.data()), outTiles.size() * sizeof(DAGWorldTile)) ||
+		outHeader.tableChecksum != dagBlockChecksum(reinterpret_cast<const uint8_t*>(outTiles.data()), outTiles.size() * sizeof(DAGWorldTile))) {
+		printf("World index %s is corrupt\n", path.c_str());
+		return false;
+	}
+
+	for (DAGWorldTile& tile : outTiles) {
+		tile.fileName[sizeof(tile.fileName) - 1] = '\0';
+		if (tile.x >= outHeader.gridSize[0] || tile.y >= outHeader.gridSize[1] || tile.z >= outHeader.gridSize[2]) {
+			printf("World index %s has a tile outside its grid\n", path.c_str());
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,355 @@
+#include "EditJournal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "DAGFile.h"
+
+namespace {
+	constexpr uint32_t JOURNAL_MAX_PAYLOAD = 1u << 30;
+
+	static_assert(sizeof(SDFShapeParameters) == 32);
+
+	uint64_t recordChecksum(JournalRecordHeader header, const uint8_t* payload) {
+		header.checksum = 0;
+		std::vector<uint8_t> bytes(sizeof(header) + header.payloadSize);
+		std::memcpy(bytes.data(), &header, sizeof(header));
+		if (header.payloadSize > 0) {
+			std::memcpy(bytes.data() + sizeof(header), payload, header.payloadSize);
+		}
+		return dagBlockChecksum(bytes.data(), bytes.size());
+	}
+
+	bool writeHeader(FILE* file, uint32_t depth) {
+		JournalFileHeader header = { JOURNAL_FILE_MAGIC, JOURNAL_FILE_VERSION, depth, 0 };
+		return fwrite(&header, sizeof(header), 1, file) == 1;
+	}
+
+	// Box corners followed by nothing else; the op says whether voxels are added
+	struct JournalRegion {
+		uint32_t min[3];
+		uint32_t max[3];
+	};
+}
+
+EditJournal::~EditJournal()
+{
+	close();
+}
+
+bool EditJournal::open(const std::string& path, uint32_t depth, uint64_t baseSequence)
+{
+	close();
+	this->path = path;
+	this->depth = depth;
+	sequence = baseSequence;
+	valid = true;
+	bytesSinceCheckpoint = 0;
+
+	std::error_code error;
+	if (std::filesystem::exists(path, error)) {
+		JournalFileHeader header = {};
+		std::ifstream input(path, std::ios::binary);
+		if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != JOURNAL_FILE_MAGIC || header.version != JOURNAL_FILE_VERSION) {
+			printf("%s is not an edit journal\n", path.c_str());
+			return false;
+		}
+		if (header.depth != depth) {
+			printf("%s belongs to a world of depth %u, not %u\n", path.c_str(), header.depth, depth);
+			return false;
+		}
+		input.close();
+
+		uint64_t end = readRecords([&](const JournalRecordHeader& record, const uint8_t*) {
+			sequence = std::max(sequence, record.sequence);
+			if (record.sequence > baseSequence) {
+				bytesSinceCheckpoint += sizeof(record) + record.payloadSize;
+			}
+			});
+
+		uint64_t fileSize = std::filesystem::file_size(path, error);
+		if (!error && end < fileSize) {
+			printf("Dropping %llu bytes of incomplete records from %s\n", static_cast<unsigned long long>(fileSize - end), path.c_str());
+			std::filesystem::resize_file(path, end, error);
+		}
+		file = openFile(path, "ab");
+	}
+	else {
+		file = openFile(path, "wb");
+		if (file && (!writeHeader(file, depth) || !syncFile(file))) {
+			fclose(file);
+			file = nullptr;
+		}
+	}
+
+	if (!file) {
+		printf("Failed to open %s\n", path.c_str());
+		return false;
+	}
+	lastSync = std::chrono::steady_clock::now();
+	unsynced = false;
+	return true;
+}
+
+void EditJournal::close()
+{
+	if (file) {
+		sync();
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+void EditJournal::appendVoxels(const VoxelEdit* edits, size_t count)
+{
+	std::vector<JournalVoxel> voxels(count);
+	for (size_t i = 0; i < count; i++) {
+		voxels[i] = { edits[i].voxel.x, edits[i].voxel.y, edits[i].voxel.z, edits[i].material, edits[i].op, 0 };
+	}
+	append(JOURNAL_VOXELS, 0, 0, voxels.data(), static_cast<uint32_t>(voxels.size() * sizeof(JournalVoxel)));
+}
+
+void EditJournal::appendShape(const SDFShapeParameters& shape, VoxelEditOp op, uint16_t material)
+{
+	if (shape.type == SDF_CUSTOM) {
+		invalidate();
+		return;
+	}
+	append(JOURNAL_SHAPE, op, material, &shape, sizeof(shape));
+}
+
+void EditJournal::appendRegion(const Box& box, bool addVoxels, uint16_t material)
+{
+	JournalRegion region = { { box.min.x, box.min.y, box.min.z }, { box.max.x, box.max.y, box.max.z } };
+	append(JOURNAL_REGION, addVoxels ? VOXEL_SET : VOXEL_CLEAR, material, &region, sizeof(region));
+}
+
+void EditJournal::appendCopy(const Box& box)
+{
+	JournalRegion region = { { box.min.x, box.min.y, box.min.z }, { box.max.x, box.max.y, box.max.z } };
+	append(JOURNAL_COPY, 0, 0, &region, sizeof(region));
+}
+
+void EditJournal::appendPaste(const glm::uvec3& destination)
+{
+	uint32_t corner[3] = { destination.x, destination.y, destination.z };
+	append(JOURNAL_PASTE, 0, 0, corner, sizeof(corner));
+}
+
+void EditJournal::appendMarker(JournalRecordType type)
+{
+	append(type, 0, 0, nullptr, 0);
+}
+
+void EditJournal::invalidate()
+{
+	if (valid) {
+		printf("Edit journal paused until the next checkpoint\n");
+	}
+	valid = false;
+}
+
+void EditJournal::append(JournalRecordType type, uint8_t op, uint16_t material, const void* payload, uint32_t payloadSize)
+{
+	if (!file || !valid) {
+		return;
+	}
+
+	JournalRecordHeader header = { sequence + 1, 0, payloadSize, type, op, material };
+	header.checksum = recordChecksum(header, static_cast<const uint8_t*>(payload));
+	if (fwrite(&header, sizeof(header), 1, file) != 1 || (payloadSize > 0 && fwrite(payload, payloadSize, 1, file) != 1)) {
+		printf("Failed to append to %s\n", path.c_str());
+		invalidate();
+		return;
+	}
+
+	sequence++;
+	bytesSinceCheckpoint += sizeof(header) + payloadSize;
+	unsynced = true;
+	syncIfDue();
+}
+
+void EditJournal::syncIfDue()
+{
+	if (unsynced && std::chrono::duration<float>(std::chrono::steady_clock::now() - lastSync).count() >= syncInterval) {
+		sync();
+	}
+}
+
+void EditJournal::sync()
+{
+	if (file && unsynced && !syncFile(file)) {
+		printf("Failed to sync %s\n", path.c_str());
+	}
+	unsynced = false;
+	lastSync = std::chrono::steady_clock::now();
+}
+
+template <typename Visitor>
+uint64_t EditJournal::readRecords(Visitor&& visit) const
+{
+	std::ifstream input(path, std::ios::binary);
+	input.seekg(sizeof(JournalFileHeader));
+	uint64_t end = sizeof(JournalFileHeader);
+
+	JournalRecordHeader header;
+	std::vector<uint8_t> payload;
+	while (input.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.payloadSize <= JOURNAL_MAX_PAYLOAD) {
+		payload.resize(header.payloadSize);
+		if (header.payloadSize > 0 && !input.read(reinterpret_cast<char*>(payload.data()), header.payloadSize)) break;
+		if (recordChecksum(header, payload.data()) != header.checksum) break;
+
+		visit(header, payload.data());
+		end += sizeof(header) + header.payloadSize;
+	}
+	return end;
+}
+
+size_t EditJournal::replay(SVDAGEditor& editor, uint64_t baseSequence)
+{
+	size_t applied = 0;
+	bool failed = false;
+	std::vector<VoxelEdit> edits;
+
+	readRecords([&](const JournalRecordHeader& record, const uint8_t* payload) {
+		if (failed || record.sequence <= baseSequence) return;
+
+		switch (record.type) {
+		case JOURNAL_VOXELS: {
+			edits.resize(record.payloadSize / sizeof(JournalVoxel));
+			for (size_t i = 0; i < edits.size(); i++) {
+				JournalVoxel voxel;
+				std::memcpy(&voxel, payload + i * sizeof(JournalVoxel), sizeof(voxel));
+				edits[i] = { glm::uvec3(voxel.x, voxel.y, voxel.z), voxel.material, static_cast<VoxelEditOp>(voxel.op) };
+			}
+			editor.applyEdits(edits);
+			break;
+		}
+		case JOURNAL_SHAPE: {
+			SDFShapeParameters parameters;
+			std::memcpy(&parameters, payload, std::min<size_t>(record.payloadSize, sizeof(parameters)));
+			SDFShape shape = SDFShape::fromParameters(parameters);
+			failed = !shape.distance;
+			if (!failed) {
+				editor.modifyShape(shape, static_cast<VoxelEditOp>(record.op), record.material);
+			}
+			break;
+		}
+		case JOURNAL_REGION: {
+			JournalRegion region;
+			std::memcpy(&region, payload, std::min<size_t>(record.payloadSize, sizeof(region)));
+			Box box = { glm::uvec3(region.min[0], region.min[1], region.min[2]), glm::uvec3(region.max[0], region.max[1], region.max[2]) };
+			editor.modifyRegion(box, record.op == VOXEL_SET, record.material);
+			break;
+		}
+		case JOURNAL_COPY: {
+			JournalRegion region;
+			std::memcpy(&region, payload, std::min<size_t>(record.payloadSize, sizeof(region)));
+			editor.copyRegion({ glm::uvec3(region.min[0], region.min[1], region.min[2]), glm::uvec3(region.max[0], region.max[1], region.max[2]) });
+			break;
+		}
+		case JOURNAL_PASTE: {
+			uint32_t corner[3] = {};
+			std::memcpy(corner, payload, std::min<size_t>(record.payloadSize, sizeof(corner)));
+			failed = !editor.paste(glm::uvec3(corner[0], corner[1], corner[2]));
+			break;
+		}
+		case JOURNAL_UNDO:
+			failed = !editor.undo();
+			break;
+		case JOURNAL_REDO:
+			failed = !editor.redo();
+			break;
+		case JOURNAL_BEGIN_STROKE:
+			editor.beginStroke();
+			break;
+		case JOURNAL_END_STROKE:
+			editor.endStroke();
+			break;
+		default:
+			failed = true;
+			break;
+		}
+
+		if (failed) {
+			printf("Journal record %llu cannot be replayed, stopping there\n", static_cast<unsigned long long>(record.sequence));
+		}
+		else {
+			applied++;
+		}
+		});
+
+	// A crash in the middle of a stroke leaves it open
+	if (editor.isInStroke()) {
+		editor.endStroke();
+	}
+	// Records appended after the one that failed would never be replayed either, so nothing more is recorded
+	// until a checkpoint of the current state folds the whole journal in
+	if (failed) {
+		invalidate();
+	}
+	if (applied > 0) {
+		printf("Replayed %zu journal records from %s\n", applied, path.c_str());
+	}
+	return applied;
+}
+
+uint64_t EditJournal::beginCheckpoint()
+{
+	validBeforeCheckpoint = valid;
+	valid = true;
+	return sequence;
+}
+
+void EditJournal::finishCheckpoint(uint64_t checkpointSequence, bool succeeded)
+{
+	if (!succeeded) {
+		// The base file still misses what happened while the journal was paused
+		if (!validBeforeCheckpoint) {
+			invalidate();
+		}
+		return;
+	}
+	if (!rewrite(checkpointSequence)) {
+		printf("Failed to trim %s, it will be replayed from the checkpoint on\n", path.c_str());
+	}
+}
+
+// Keeps only the records after the checkpoint; the new file replaces the old one in a single rename
+bool EditJournal::rewrite(uint64_t afterSequence)
+{
+	sync();
+
+	std::string temporaryPath = path + ".tmp";
+	FILE* output = openFile(temporaryPath, "wb");
+	if (!output) {
+		return false;
+	}
+
+	bool ok = writeHeader(output, depth);
+	size_t kept = 0;
+	readRecords([&](const JournalRecordHeader& record, const uint8_t* payload) {
+		if (!ok || record.sequence <= afterSequence) return;
+		ok = fwrite(&record, sizeof(record), 1, output) == 1 && (record.payloadSize == 0 || fwrite(payload, record.payloadSize, 1, output) == 1);
+		kept += sizeof(record) + record.payloadSize;
+		});
+	ok = ok && syncFile(output);
+	fclose(output);
+	if (!ok) {
+		std::filesystem::remove(temporaryPath);
+		return false;
+	}
+
+	fclose(file);
+	file = nullptr;
+	bool replaced = replaceFile(temporaryPath, path);
+	file = openFile(path, "ab");
+	if (!replaced || !file) {
+		if (!file) invalidate();
+		return false;
+	}
+	bytesSinceCheckpoint = kept;
+	return true;
+}
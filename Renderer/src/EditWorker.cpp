@@ -0,0 +1,231 @@
+#include "EditWorker.h"
+
+#include <cstring>
+
+#include "SVDAGLoader.h"
+
+namespace {
+	// A brush held still stamps the same shape every frame, and only the first stamp changes anything
+	bool sameStamp(const EditCommand& a, const EditCommand& b) {
+		return a.type == EDIT_SHAPE && b.type == EDIT_SHAPE && a.op == b.op && a.material == b.material &&
+			a.shape.parameters.type != SDF_CUSTOM && std::memcmp(&a.shape.parameters, &b.shape.parameters, sizeof(SDFShapeParameters)) == 0;
+	}
+}
+
+EditWorker::EditWorker(std::shared_ptr<SVDAGEditor> editor, NodePool& nodes)
+	: editor(std::move(editor)), nodes(nodes)
+{
+	undoAvailable = this->editor->canUndo();
+	redoAvailable = this->editor->canRedo();
+	worker = std::thread(&EditWorker::run, this);
+}
+
+EditWorker::~EditWorker()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	queued.notify_one();
+	worker.join();
+}
+
+void EditWorker::modifyShape(const SDFShape& shape, VoxelEditOp op, uint16_t material)
+{
+	submit({ EDIT_SHAPE, shape, {}, op, material });
+}
+
+void EditWorker::modifyRegion(const Box& targetBox, bool addVoxels, uint16_t material)
+{
+	submit({ EDIT_REGION, {}, targetBox, addVoxels ? VOXEL_SET : VOXEL_CLEAR, material });
+}
+
+void EditWorker::copyRegion(const Box& box)
+{
+	submit({ EDIT_COPY, {}, box });
+}
+
+// The destination travels as the corner of the command's box
+void EditWorker::paste(const glm::uvec3& destination)
+{
+	submit({ EDIT_PASTE, {}, { destination, destination } });
+}
+
+void EditWorker::undo()
+{
+	submit({ EDIT_UNDO });
+}
+
+void EditWorker::redo()
+{
+	submit({ EDIT_REDO });
+}
+
+void EditWorker::beginStroke()
+{
+	strokeOpen = true;
+	submit({ EDIT_BEGIN_STROKE });
+}
+
+void EditWorker::endStroke()
+{
+	strokeOpen = false;
+	submit({ EDIT_END_STROKE });
+}
+
+std::future<NodeSnapshot> EditWorker::snapshotNodes()
+{
+	std::future<NodeSnapshot> snapshot;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		snapshotRequests.emplace_back();
+		snapshot = snapshotRequests.back().get_future();
+		queue.push_back({ EDIT_SNAPSHOT });
+	}
+	queued.notify_one();
+	return snapshot;
+}
+
+void EditWorker::submit(EditCommand command)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queue.empty() || !sameStamp(queue.back(), command)) {
+			queue.push_back(std::move(command));
+		}
+	}
+	queued.notify_one();
+}
+
+bool EditWorker::uploadPublished(SVDAGLoader& loader)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (published.empty()) {
+			return false;
+		}
+		std::swap(published, uploading);
+	}
+
+	loader.uploadStagedNodes(uploading);
+	uploading.clear();
+	return true;
+}
+
+bool EditWorker::isIdle()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return queue.empty() && !busy && published.empty();
+}
+
+void EditWorker::waitIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return queue.empty() && !busy; });
+}
+
+bool EditWorker::readPoolBetweenBatches(const std::function<void(const NodePool&)>& read)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (busy) {
+		return false;
+	}
+	read(nodes);
+	return true;
+}
+
+void EditWorker::run()
+{
+	std::vector<EditCommand> batch;
+	StagedNodes staged;
+	EditCommand lastApplied = { EDIT_END_STROKE };
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queued.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (queue.empty()) {
+				return;
+			}
+			std::swap(batch, queue);
+			busy = true;
+		}
+
+		for (EditCommand& command : batch) {
+			if (command.type == EDIT_SNAPSHOT) {
+				takeSnapshot();
+				continue;
+			}
+			if (sameStamp(lastApplied, command)) continue;
+			apply(command);
+			lastApplied = std::move(command);
+		}
+		batch.clear();
+		nodes.stageDirty(staged);
+		undoAvailable = editor->canUndo();
+		redoAvailable = editor->canRedo();
+		clipboardAvailable = editor->hasClipboard();
+
+		{
+			// A batch the render loop has not picked up yet is extended rather than replaced
+			std::lock_guard<std::mutex> lock(mutex);
+			if (published.empty()) {
+				std::swap(published, staged);
+			}
+			else {
+				published.ranges.insert(published.ranges.end(), staged.ranges.begin(), staged.ranges.end());
+				published.nodes.insert(published.nodes.end(), staged.nodes.begin(), staged.nodes.end());
+				published.poolSize = staged.poolSize;
+			}
+			staged.clear();
+			busy = false;
+		}
+		finished.notify_all();
+	}
+}
+
+void EditWorker::takeSnapshot()
+{
+	std::promise<NodeSnapshot> request;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		request = std::move(snapshotRequests.front());
+		snapshotRequests.pop_front();
+	}
+
+	NodeSnapshot snapshot;
+	nodes.copyTo(snapshot.nodes);
+	snapshot.version = nodes.version();
+	request.set_value(std::move(snapshot));
+}
+
+void EditWorker::apply(const EditCommand& command)
+{
+	switch (command.type) {
+	case EDIT_SHAPE:
+		editor->modifyShape(command.shape, command.op, command.material);
+		break;
+	case EDIT_REGION:
+		editor->modifyRegion(command.box, command.op == VOXEL_SET, command.material);
+		break;
+	case EDIT_COPY:
+		editor->copyRegion(command.box);
+		break;
+	case EDIT_PASTE:
+		editor->paste(command.box.min);
+		break;
+	case EDIT_UNDO:
+		editor->undo();
+		break;
+	case EDIT_REDO:
+		editor->redo();
+		break;
+	case EDIT_BEGIN_STROKE:
+		editor->beginStroke();
+		break;
+	case EDIT_END_STROKE:
+		editor->endStroke();
+		break;
+	case EDIT_SNAPSHOT:
+		break;
+	}
+}
@@ -0,0 +1,116 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	bytes = static_cast<uint8_t*>(view);
+	length = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes != nullptr) {
+		UnmapViewOfFile(bytes);
+	}
+	if (mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != nullptr) {
+		CloseHandle(fileHandle);
+	}
+	bytes = nullptr;
+	length = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED) {
+		::close(fd);
+		return false;
+	}
+	madvise(view, static_cast<size_t>(fileStat.st_size), MADV_WILLNEED);
+
+	fileDescriptor = fd;
+	bytes = static_cast<uint8_t*>(view);
+	length = static_cast<size_t>(fileStat.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes != nullptr) {
+		munmap(bytes, length);
+	}
+	if (fileDescriptor >= 0) {
+		::close(fileDescriptor);
+	}
+	bytes = nullptr;
+	length = 0;
+	fileDescriptor = -1;
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "NodePool.h"
+
+#include <algorithm>
+#include <cstring>
+
+uint32_t NodePool::allocate(const SVDAGGPUNode& node)
+{
+	uint32_t index;
+	if (!freeNodes.empty()) {
+		index = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(count);
+		resize(count + 1);
+	}
+	(*this)[index] = node;
+	markDirty(index);
+	return index;
+}
+
+void NodePool::release(uint32_t index)
+{
+	if (index >= count) return;
+
+	freeNodes.push_back(index);
+	modifications++;
+}
+
+void NodePool::resize(size_t newCount)
+{
+	size_t segmentsNeeded = (newCount + NODE_SEGMENT_SIZE - 1) / NODE_SEGMENT_SIZE;
+	while (segments.size() < segmentsNeeded) {
+		segments.push_back(std::make_unique_for_overwrite<SVDAGGPUNode[]>(NODE_SEGMENT_SIZE));
+	}
+	segments.resize(segmentsNeeded);
+
+	size_t pageCount = (newCount + NODE_PAGE_SIZE - 1) / NODE_PAGE_SIZE;
+	dirtyPages.resize((pageCount + 63) / 64, 0);
+	count = newCount;
+	modifications++;
+	pageVersions.resize(pageCount, modifications);
+}
+
+void NodePool::clear()
+{
+	segments.clear();
+	segments.shrink_to_fit();
+	dirtyPages.clear();
+	pageVersions.clear();
+	freeNodes.clear();
+	freeNodes.shrink_to_fit();
+	count = 0;
+	anyDirty = false;
+	modifications++;
+}
+
+void NodePool::write(size_t first, const SVDAGGPUNode* nodes, size_t nodeCount)
+{
+	while (nodeCount > 0) {
+		size_t offset = first & (NODE_SEGMENT_SIZE - 1);
+		size_t take = std::min<size_t>(nodeCount, NODE_SEGMENT_SIZE - offset);
+		std::memcpy(segments[first >> NODE_SEGMENT_SHIFT].get() + offset, nodes, take * sizeof(SVDAGGPUNode));
+		first += take;
+		nodes += take;
+		nodeCount -= take;
+	}
+}
+
+void NodePool::assign(const SVDAGGPUNode* nodes, size_t nodeCount)
+{
+	clear();
+	resize(nodeCount);
+	write(0, nodes, nodeCount);
+}
+
+void NodePool::copyTo(std::vector<SVDAGGPUNode>& outNodes) const
+{
+	outNodes.resize(count);
+	for (size_t segment = 0; segment < segments.size(); segment++) {
+		size_t first = segment << NODE_SEGMENT_SHIFT;
+		size_t take = std::min<size_t>(NODE_SEGMENT_SIZE, count - first);
+		std::copy(segments[segment].get(), segments[segment].get() + take, outNodes.begin() + first);
+	}
+}
+
+void NodePool::markDirty(uint32_t index)
+{
+	if (index >= count) return;
+
+	size_t page = index >> NODE_PAGE_SHIFT;
+	dirtyPages[page >> 6] |= 1ull << (page & 63);
+	anyDirty = true;
+	pageVersions[page] = ++modifications;
+}
+
+void NodePool::markDirtyRange(size_t first, size_t nodeCount)
+{
+	size_t last = std::min(first + nodeCount, count);
+	modifications++;
+	for (size_t page = first >> NODE_PAGE_SHIFT; page << NODE_PAGE_SHIFT < last; page++) {
+		dirtyPages[page >> 6] |= 1ull << (page & 63);
+		pageVersions[page] = modifications;
+		anyDirty = true;
+	}
+}
+
+void NodePool::clearDirty()
+{
+	std::fill(dirtyPages.begin(), dirtyPages.end(), 0);
+	anyDirty = false;
+}
+
+void NodePool::stageDirty(StagedNodes& staged)
+{
+	forEachDirtyRange([&](size_t first, size_t nodeCount, const SVDAGGPUNode* data) {
+		staged.ranges.push_back({ first, nodeCount });
+		staged.nodes.insert(staged.nodes.end(), data, data + nodeCount);
+		});
+	staged.poolSize = count;
+	clearDirty();
+}
+
+size_t NodePool::memoryUsage() const
+{
+	return segments.size() * NODE_SEGMENT_SIZE * sizeof(SVDAGGPUNode) + dirtyPages.capacity() * sizeof(uint64_t) +
+		pageVersions.capacity() * sizeof(uint64_t) + freeNodes.capacity() * sizeof(uint32_t) + segments.capacity() * sizeof(std::unique_ptr<SVDAGGPUNode[]>);
+}
@@ -0,0 +1,64 @@
+#include "SDFShape.h"
+
+#include <utility>
+
+SDFShape SDFShape::sphere(const glm::vec3& center, float radius)
+{
+	return { [=](const glm::vec3& p) { return glm::distance(p, center) - radius; }, 1.0f, { SDF_SPHERE, center, glm::vec3(0.0f), radius } };
+}
+
+SDFShape SDFShape::capsule(const glm::vec3& a, const glm::vec3& b, float radius)
+{
+	glm::vec3 ba = b - a;
+	float baba = glm::max(glm::dot(ba, ba), 1e-12f);
+	return { [=](const glm::vec3& p) {
+		glm::vec3 pa = p - a;
+		float h = glm::clamp(glm::dot(pa, ba) / baba, 0.0f, 1.0f);
+		return glm::length(pa - ba * h) - radius;
+		}, 1.0f, { SDF_CAPSULE, a, b, radius } };
+}
+
+SDFShape SDFShape::cylinder(const glm::vec3& a, const glm::vec3& b, float radius)
+{
+	glm::vec3 ba = b - a;
+	float baba = glm::max(glm::dot(ba, ba), 1e-12f);
+	return { [=](const glm::vec3& p) {
+		glm::vec3 pa = p - a;
+		float paba = glm::dot(pa, ba);
+		float x = glm::length(pa * baba - ba * paba) - radius * baba;
+		float y = glm::abs(paba - baba * 0.5f) - baba * 0.5f;
+		float x2 = x * x;
+		float y2 = y * y * baba;
+		float d = glm::max(x, y) < 0.0f ? -glm::min(x2, y2) : (x > 0.0f ? x2 : 0.0f) + (y > 0.0f ? y2 : 0.0f);
+		return glm::sign(d) * glm::sqrt(glm::abs(d)) / baba;
+		}, 1.0f, { SDF_CYLINDER, a, b, radius } };
+}
+
+SDFShape SDFShape::roundedBox(const glm::vec3& center, const glm::vec3& halfExtents, float rounding)
+{
+	return { [=](const glm::vec3& p) {
+		glm::vec3 q = glm::abs(p - center) - halfExtents + rounding;
+		return glm::length(glm::max(q, glm::vec3(0.0f))) + glm::min(glm::max(q.x, glm::max(q.y, q.z)), 0.0f) - rounding;
+		}, 1.0f, { SDF_ROUNDED_BOX, center, halfExtents, rounding } };
+}
+
+SDFShape SDFShape::custom(std::function<float(const glm::vec3&)> distance, float lipschitz)
+{
+	return { std::move(distance), lipschitz, SDFShapeParameters{} };
+}
+
+SDFShape SDFShape::fromParameters(const SDFShapeParameters& parameters)
+{
+	switch (parameters.type) {
+	case SDF_SPHERE:
+		return sphere(parameters.a, parameters.radius);
+	case SDF_CAPSULE:
+		return capsule(parameters.a, parameters.b, parameters.radius);
+	case SDF_CYLINDER:
+		return cylinder(parameters.a, parameters.b, parameters.radius);
+	case SDF_ROUNDED_BOX:
+		return roundedBox(parameters.a, parameters.b, parameters.radius);
+	default:
+		return {};
+	}
+}
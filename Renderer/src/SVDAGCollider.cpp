@@ -0,0 +1,209 @@
+#include "SVDAGCollider.h"
+
+#include <algorithm>
+#include <execution>
+#include <limits>
+
+namespace {
+	bool isSolid(const SVDAGGPUNode& node) {
+		return node.childMask == 0xFFu && node.children[0] == 0u;
+	}
+
+	float horizontalLength(const glm::vec3& v) {
+		return glm::length(glm::vec2(v.x, v.z));
+	}
+}
+
+SVDAGCollider::SVDAGCollider(const NodePool& nodes, uint32_t depth)
+	: nodes(nodes), maxDepth(depth)
+{
+}
+
+SweepResult SVDAGCollider::sweep(const SweepQuery& query) const
+{
+	SweepResult result = { 1.0f, glm::vec3(0.0f), false };
+	if (query.displacement == glm::vec3(0.0f) || maxDepth == 0 || nodes.size() == 0) {
+		return result;
+	}
+
+	// Children are visited starting from the one on the side the box comes from
+	Sweep sweep = { glm::dvec3(query.center), glm::dvec3(query.halfExtents), glm::dvec3(query.displacement), 0u, 0.0 };
+	for (uint32_t axis = 0; axis < 3; axis++) {
+		if (query.displacement[axis] < 0.0f) {
+			sweep.nearOctant |= 1u << axis;
+		}
+	}
+	float smallestExtent = 2.0f * std::min({ query.halfExtents.x, query.halfExtents.y, query.halfExtents.z });
+	sweep.minimumNodeSize = minimumFeature * smallestExtent;
+
+	sweepNode(0, glm::dvec3(0.0), 1.0, 0, sweep, result);
+	return result;
+}
+
+void SVDAGCollider::sweep(const std::vector<SweepQuery>& queries, std::vector<SweepResult>& results) const
+{
+	results.resize(queries.size());
+	std::transform(std::execution::par, queries.begin(), queries.end(), results.begin(), [&](const SweepQuery& query) {
+		return sweep(query);
+		});
+}
+
+void SVDAGCollider::sweepNode(uint32_t nodeIndex, const glm::dvec3& nodeMin, double nodeSize, uint32_t depth, const Sweep& sweep, SweepResult& result) const
+{
+	if (!reaches(nodeMin, nodeMin + nodeSize, sweep, result.time)) {
+		return;
+	}
+
+	const SVDAGGPUNode& node = nodes[nodeIndex];
+	if (node.childMask == 0) {
+		return;
+	}
+	if (isSolid(node) || nodeSize < sweep.minimumNodeSize) {
+		hitSolid(nodeMin, nodeMin + nodeSize, sweep, result);
+		return;
+	}
+
+	double half = nodeSize * 0.5;
+	for (uint32_t i = 0; i < 8; i++) {
+		uint32_t octant = i ^ sweep.nearOctant;
+		if ((node.childMask & (1u << octant)) == 0) continue;
+
+		glm::dvec3 childMin = nodeMin + glm::dvec3((octant & 1) ? half : 0.0, (octant & 2) ? half : 0.0, (octant & 4) ? half : 0.0);
+		if (depth == maxDepth - 1) {
+			hitSolid(childMin, childMin + half, sweep, result);
+		}
+		else if (node.children[octant] != 0) {
+			sweepNode(node.children[octant], childMin, half, depth + 1, sweep, result);
+		}
+	}
+}
+
+// Whether the swept box touches the given box before maxTime. Touching counts, so no node holding a contact
+// is skipped
+bool SVDAGCollider::reaches(const glm::dvec3& boxMin, const glm::dvec3& boxMax, const Sweep& sweep, double maxTime) const
+{
+	double enter = 0.0;
+	double exit = maxTime;
+	for (uint32_t axis = 0; axis < 3; axis++) {
+		double low = boxMin[axis] - sweep.halfExtents[axis];
+		double high = boxMax[axis] + sweep.halfExtents[axis];
+		double origin = sweep.center[axis];
+		double direction = sweep.displacement[axis];
+		if (direction == 0.0) {
+			if (origin < low || origin > high) return false;
+			continue;
+		}
+		double t0 = (low - origin) / direction;
+		double t1 = (high - origin) / direction;
+		if (t0 > t1) std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		exit = std::min(exit, t1);
+		if (enter > exit) return false;
+	}
+	return true;
+}
+
+// The box center moves along a ray against the solid box grown by the half extents. Sliding along a face only
+// touches it, which is not a hit, and a start less than the skin width inside a face counts as touching it
+void SVDAGCollider::hitSolid(const glm::dvec3& boxMin, const glm::dvec3& boxMax, const Sweep& sweep, SweepResult& result) const
+{
+	double enter = -std::numeric_limits<double>::infinity();
+	double exit = std::numeric_limits<double>::infinity();
+	int enterAxis = -1;
+	for (uint32_t axis = 0; axis < 3; axis++) {
+		double low = boxMin[axis] - sweep.halfExtents[axis];
+		double high = boxMax[axis] + sweep.halfExtents[axis];
+		double origin = sweep.center[axis];
+		double direction = sweep.displacement[axis];
+		if (direction == 0.0) {
+			if (origin <= low || origin >= high) return;
+			continue;
+		}
+		double t0 = (low - origin) / direction;
+		double t1 = (high - origin) / direction;
+		if (t0 > t1) std::swap(t0, t1);
+		if (t0 > enter) {
+			enter = t0;
+			enterAxis = static_cast<int>(axis);
+		}
+		exit = std::min(exit, t1);
+	}
+	if (enterAxis < 0 || enter >= exit || exit <= 0.0) {
+		return;
+	}
+	if (enter < 0.0) {
+		if (-enter * std::abs(sweep.displacement[enterAxis]) > skinWidth) {
+			return;
+		}
+		enter = 0.0;
+	}
+	if (enter >= result.time) {
+		return;
+	}
+
+	result.time = static_cast<float>(enter);
+	result.normal = glm::vec3(0.0f);
+	result.normal[enterAxis] = sweep.displacement[enterAxis] > 0.0 ? -1.0f : 1.0f;
+	result.hit = true;
+}
+
+// Each hit removes the part of the remaining movement that points into the surface, so the body slides along
+// it; three surfaces at most can stop it
+glm::vec3 SVDAGCollider::slide(const glm::vec3& center, const glm::vec3& halfExtents, glm::vec3 displacement, bool& grounded, bool& wallHit) const
+{
+	glm::vec3 position = center;
+	for (uint32_t iteration = 0; iteration < 4 && displacement != glm::vec3(0.0f); iteration++) {
+		SweepResult hit = sweep({ position, halfExtents, displacement });
+		if (!hit.hit) {
+			position += displacement;
+			break;
+		}
+
+		position += displacement * hit.time + hit.normal * skinWidth;
+		if (hit.normal.y > 0.0f) {
+			grounded = true;
+		}
+		else if (hit.normal.y == 0.0f) {
+			wallHit = true;
+		}
+		displacement *= 1.0f - hit.time;
+		displacement -= hit.normal * glm::dot(displacement, hit.normal);
+	}
+	return position;
+}
+
+// A blocked body also tries rising by the step height, moving across and coming back down, and keeps that
+// if it lands somewhere farther along
+void SVDAGCollider::move(CollisionBody& body) const
+{
+	bool grounded = false;
+	bool wallHit = false;
+	glm::vec3 start = body.center;
+	glm::vec3 end = slide(start, body.halfExtents, body.displacement, grounded, wallHit);
+
+	if (wallHit && stepHeight > 0.0f) {
+		SweepResult rise = sweep({ start, body.halfExtents, glm::vec3(0.0f, stepHeight, 0.0f) });
+		float height = rise.hit ? std::max(stepHeight * rise.time - skinWidth, 0.0f) : stepHeight;
+
+		bool landed = false;
+		bool ignored = false;
+		glm::vec3 across = slide(start + glm::vec3(0.0f, height, 0.0f), body.halfExtents,
+			glm::vec3(body.displacement.x, 0.0f, body.displacement.z), ignored, ignored);
+		glm::vec3 stepped = slide(across, body.halfExtents, glm::vec3(0.0f, std::min(body.displacement.y, 0.0f) - height, 0.0f), landed, ignored);
+		if (landed && horizontalLength(stepped - start) > horizontalLength(end - start) + skinWidth) {
+			end = stepped;
+			grounded = true;
+		}
+	}
+
+	body.displacement = end - start;
+	body.center = end;
+	body.grounded = grounded;
+}
+
+void SVDAGCollider::move(std::vector<CollisionBody>& bodies) const
+{
+	std::for_each(std::execution::par, bodies.begin(), bodies.end(), [&](CollisionBody& body) {
+		move(body);
+		});
+}
@@ -0,0 +1,190 @@
+#include "SVDAGCombiner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+#include "DAGFile.h"
+#include "MappedFile.h"
+#include "SVDAGSaver.h"
+
+namespace {
+	constexpr uint32_t NO_NODE = UINT32_MAX;
+
+	struct PairKey {
+		uint32_t a;
+		uint32_t b;
+		uint32_t depth;
+
+		bool operator==(const PairKey& other) const {
+			return a == other.a && b == other.b && depth == other.depth;
+		}
+	};
+
+	struct PairKeyHash {
+		size_t operator()(const PairKey& key) const {
+			size_t hash = std::hash<uint64_t>{}((static_cast<uint64_t>(key.a) << 32) | key.b);
+			return hash ^ (std::hash<uint32_t>{}(key.depth) + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+		}
+	};
+
+	// Result nodes are hash-consed as they are made. Slot 0 is kept for the root, so a child index of 0 still
+	// means "no child" and the table can go through SVDAGSaver::compact for the final layout
+	class PairCombiner
+	{
+	public:
+		PairCombiner(const std::vector<SVDAGGPUNode>& a, const std::vector<SVDAGGPUNode>& b, uint32_t depth, CSGOperation op)
+			: a(a), b(b), maxDepth(depth), op(op), unique(1) {}
+
+		uint32_t combine(std::vector<SVDAGGPUNode>& outNodes) {
+			uint32_t root = maxDepth == 0 ? NO_NODE : combinePair(a.empty() ? NO_NODE : 0, b.empty() ? NO_NODE : 0, 0);
+			unique[0] = root == NO_NODE ? SVDAGGPUNode{} : unique[root];
+			return SVDAGSaver::compact(unique, maxDepth, outNodes);
+		}
+	private:
+		const std::vector<SVDAGGPUNode>& a;
+		const std::vector<SVDAGGPUNode>& b;
+		uint32_t maxDepth;
+		CSGOperation op;
+		std::vector<SVDAGGPUNode> unique;
+		std::unordered_map<NodeKey, uint32_t, NodeKeyHash> lookup;
+		std::unordered_map<PairKey, uint32_t, PairKeyHash> memo;
+
+		static bool isSolid(const SVDAGGPUNode& node) {
+			return node.childMask == 0xFFu && node.children[0] == 0u;
+		}
+
+		// A solid node stands for itself on every level below it
+		static uint32_t childOf(const std::vector<SVDAGGPUNode>& nodes, uint32_t index, uint32_t octant) {
+			if (index == NO_NODE) return NO_NODE;
+			const SVDAGGPUNode& node = nodes[index];
+			if (isSolid(node)) return index;
+			if ((node.childMask & (1u << octant)) == 0 || node.children[octant] == 0) return NO_NODE;
+			return node.children[octant];
+		}
+
+		uint32_t intern(const NodeKey& key) {
+			auto [it, inserted] = lookup.try_emplace(key, static_cast<uint32_t>(unique.size()));
+			if (inserted) {
+				SVDAGGPUNode node = {};
+				node.childMask = key.childMask;
+				node.material = key.material;
+				std::copy(key.children, key.children + 8, node.children);
+				unique.push_back(node);
+			}
+			return it->second;
+		}
+
+		uint32_t combineLeaf(uint32_t indexA, uint32_t indexB, uint32_t depth) {
+			uint32_t maskA = indexA == NO_NODE ? 0 : a[indexA].childMask;
+			uint32_t maskB = indexB == NO_NODE ? 0 : b[indexB].childMask;
+			uint16_t material = indexA == NO_NODE ? 0 : a[indexA].material;
+
+			uint32_t mask = 0;
+			switch (op) {
+			case CSG_UNION:
+				mask = maskA | maskB;
+				if (maskB != 0) material = b[indexB].material;
+				break;
+			case CSG_INTERSECTION:
+				mask = maskA & maskB;
+				break;
+			case CSG_DIFFERENCE:
+				mask = maskA & ~maskB;
+				break;
+			}
+			return mask == 0 ? NO_NODE : intern({ depth, mask, material, {} });
+		}
+
+		uint32_t combinePair(uint32_t indexA, uint32_t indexB, uint32_t depth) {
+			// Pairs whose result is already known without looking further down
+			bool emptyA = indexA == NO_NODE, emptyB = indexB == NO_NODE;
+			if ((emptyA && emptyB) || (op == CSG_INTERSECTION && (emptyA || emptyB)) || (op == CSG_DIFFERENCE && emptyA)) {
+				return NO_NODE;
+			}
+			if (op == CSG_DIFFERENCE && !emptyB && isSolid(b[indexB])) {
+				return NO_NODE;
+			}
+			if (op == CSG_UNION && !emptyB && isSolid(b[indexB])) {
+				return intern({ depth, 0xFFu, b[indexB].material, {} });
+			}
+			if (depth == maxDepth - 1) {
+				return combineLeaf(indexA, indexB, depth);
+			}
+
+			auto [entry, inserted] = memo.try_emplace({ indexA, indexB, depth }, NO_NODE);
+			if (!inserted) {
+				return entry->second;
+			}
+
+			NodeKey key = { depth, 0, 0, {} };
+			for (uint32_t octant = 0; octant < 8; octant++) {
+				uint32_t child = combinePair(childOf(a, indexA, octant), childOf(b, indexB, octant), depth + 1);
+				if (child != NO_NODE) {
+					key.childMask |= 1u << octant;
+					key.children[octant] = child;
+				}
+			}
+
+			uint32_t result = NO_NODE;
+			if (key.childMask != 0) {
+				// Eight copies of the same solid node are that solid node one level up
+				const SVDAGGPUNode& first = unique[key.children[0]];
+				bool uniform = key.childMask == 0xFFu && std::all_of(key.children, key.children + 8, [&](uint32_t child) { return child == key.children[0]; });
+				result = uniform && isSolid(first) ? intern({ depth, 0xFFu, first.material, {} }) : intern(key);
+			}
+			// The map may have rehashed during the recursion
+			memo[{ indexA, indexB, depth }] = result;
+			return result;
+		}
+	};
+
+	const char* operationName(CSGOperation op) {
+		switch (op) {
+		case CSG_UNION: return "union";
+		case CSG_INTERSECTION: return "intersection";
+		case CSG_DIFFERENCE: return "difference";
+		}
+		return "combination";
+	}
+}
+
+uint32_t SVDAGCombiner::combine(const std::vector<SVDAGGPUNode>& a, const std::vector<SVDAGGPUNode>& b, uint32_t depth, CSGOperation op, std::vector<SVDAGGPUNode>& outNodes)
+{
+	PairCombiner combiner(a, b, depth, op);
+	return combiner.combine(outNodes);
+}
+
+bool SVDAGCombiner::readNodes(const std::string& path, uint32_t& outDepth, std::vector<SVDAGGPUNode>& outNodes)
+{
+	MappedFile file;
+	DAGFileHeader header = {};
+	if (!file.open(path) || !readDAGFileNodes(file.data(), file.size(), header, outNodes)) {
+		printf("Failed to read %s\n", path.c_str());
+		return false;
+	}
+	outDepth = header.depth;
+	return true;
+}
+
+bool SVDAGCombiner::combineFiles(const std::string& pathA, const std::string& pathB, CSGOperation op, const std::string& outputPath)
+{
+	uint32_t depthA = 0, depthB = 0;
+	std::vector<SVDAGGPUNode> a, b;
+	if (!readNodes(pathA, depthA, a) || !readNodes(pathB, depthB, b)) {
+		return false;
+	}
+	if (depthA != depthB) {
+		printf("Cannot combine %s of depth %u with %s of depth %u\n", pathA.c_str(), depthA, pathB.c_str(), depthB);
+		return false;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<SVDAGGPUNode> combined;
+	uint32_t maxRefs = combine(a, b, depthA, op, combined);
+	std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+	printf("Computed the %s of %zu and %zu nodes into %zu nodes in %.2f seconds\n", operationName(op), a.size(), b.size(), combined.size(), elapsed.count());
+
+	return writeDAGFile(outputPath, depthA, maxRefs, combined);
+}
@@ -1,9 +1,19 @@
 #include "SVDAGEditor.h"
 
-SVDAGEditor::SVDAGEditor(std::vector<SVDAGGPUNode>& nodes, uint32_t treeDepth)
-	: nodes(nodes), maxDepth(treeDepth)
+#include <algorithm>
+#include <execution>
+
+#include "EditJournal.h"
+
+constexpr uint32_t NO_NODE = UINT32_MAX;
+// Marks indices into the current worker's arena; pool indices stay below it
+constexpr uint32_t ARENA_NODE = 0x80000000u;
+
+thread_local SVDAGEditor::EditArena* SVDAGEditor::activeArena = nullptr;
+
+SVDAGEditor::SVDAGEditor(NodePool& nodes, uint32_t treeDepth)
+	: nodes(nodes), maxDepth(std::min(treeDepth, MAX_TREE_DEPTH))
 {
-    clearModifiedLists();
 }
 
 SVDAGEditor::~SVDAGEditor()
@@ -12,140 +22,966 @@ SVDAGEditor::~SVDAGEditor()
 
 uint32_t SVDAGEditor::ensureNodeIsMutable(uint32_t nodeIndex)
 {
-	if (nodes[nodeIndex].refs > 1) {
-		nodes[nodeIndex].refs--;
-		modifiedIndices.push_back(nodeIndex);
-		
-		SVDAGGPUNode newNode = nodes[nodeIndex];
+	// The caller swaps the copy into its parent and releases the original there. Workers only ever write to
+	// nodes from their own arena
+	bool shared = activeArena ? (nodeIndex & ARENA_NODE) == 0 || nodeAt(nodeIndex).refs > 1 : nodes[nodeIndex].refs > 1;
+	if (shared) {
+		SVDAGGPUNode newNode = nodeAt(nodeIndex);
 		newNode.refs = 1;
 
-		uint32_t newIndex = nodes.size();
-		nodes.push_back(newNode);
-		return newIndex;
+		// The copy is one more parent of every child it shares with the original
+		for (uint32_t child : newNode.children) {
+			if (child != 0) {
+				retainNode(child);
+			}
+		}
+
+		return allocateNode(newNode);
 	}
 
-	modifiedIndices.push_back(nodeIndex);
+	if (!activeArena) {
+		nodes.markDirty(nodeIndex);
+		touchedNodes.try_emplace(nodeIndex, NO_NODE);
+	}
 	return nodeIndex;
 }
 
-bool SVDAGEditor::setVoxel(const glm::vec3& worldPos, uint16_t material) {
-	if (glm::any(glm::lessThan(worldPos, glm::vec3(0))) || glm::any(glm::greaterThanEqual(worldPos, glm::vec3(1)))) {
+uint32_t SVDAGEditor::allocateNode(const SVDAGGPUNode& node)
+{
+	if (activeArena) {
+		activeArena->nodes.push_back(node);
+		return ARENA_NODE | static_cast<uint32_t>(activeArena->nodes.size() - 1);
+	}
+
+	uint32_t nodeIndex = nodes.allocate(node);
+	touchedNodes.try_emplace(nodeIndex, NO_NODE);
+	pendingNodes++;
+	return nodeIndex;
+}
+
+SVDAGGPUNode& SVDAGEditor::nodeAt(uint32_t nodeIndex)
+{
+	if (nodeIndex & ARENA_NODE) {
+		return activeArena->nodes[nodeIndex & ~ARENA_NODE];
+	}
+	return nodes[nodeIndex];
+}
+
+void SVDAGEditor::retainNode(uint32_t nodeIndex)
+{
+	if (activeArena && (nodeIndex & ARENA_NODE) == 0) {
+		activeArena->retained.push_back(nodeIndex);
+		return;
+	}
+
+	nodeAt(nodeIndex).refs++;
+	if (!activeArena) {
+		nodes.markDirty(nodeIndex);
+	}
+}
+
+NodeKey SVDAGEditor::makeKey(const SVDAGGPUNode& node, uint32_t currentDepth) const
+{
+	NodeKey key = { currentDepth, node.childMask, node.material, {} };
+	bool solid = node.childMask == 0xFFu && node.children[0] == 0u;
+	if (!solid && currentDepth < maxDepth - 1) {
+		for (int c = 0; c < 8; c++) {
+			if (node.childMask & (1u << c)) key.children[c] = node.children[c];
+		}
+	}
+	return key;
+}
+
+// Runs after every edit: the touched nodes form a connected region below the root, so one bottom-up pass
+// over it swaps each touched node for an identical live node from earlier edits or registers it as canonical
+void SVDAGEditor::commitEdits()
+{
+	if (!touchedNodes.empty()) {
+		canonicalize(rootNodeIndex, 0);
+		touchedNodes.clear();
+	}
+
+	if (pendingVersion != 0 && !strokeOpen) {
+		finishVersion();
+	}
+
+	for (uint32_t nodeIndex : releasedNodes) {
+		nodes.release(nodeIndex);
+	}
+	releasedNodes.clear();
+}
+
+// Pins a copy of the root before the first edit of a step. Its children now have two parents, so the edit
+// copies its path instead of writing over nodes the previous version still needs
+void SVDAGEditor::beginEdit()
+{
+	if (pendingVersion != 0 || fixedLevels > 1) {
+		return;
+	}
+
+	SVDAGGPUNode version = nodes[rootNodeIndex];
+	version.refs = 1;
+	bool solid = version.childMask == 0xFFu && version.children[0] == 0u;
+	if (!solid && maxDepth > 1) {
+		for (int c = 0; c < 8; c++) {
+			if ((version.childMask & (1u << c)) && version.children[c] != 0) {
+				nodes[version.children[c]].refs++;
+				nodes.markDirty(version.children[c]);
+			}
+		}
+	}
+	pendingVersion = nodes.allocate(version);
+	pendingNodes = 0;
+}
+
+void SVDAGEditor::finishVersion()
+{
+	const SVDAGGPUNode& root = nodes[rootNodeIndex];
+	const SVDAGGPUNode& version = nodes[pendingVersion];
+	bool unchanged = root.childMask == version.childMask && root.material == version.material &&
+		std::equal(std::begin(root.children), std::end(root.children), std::begin(version.children));
+
+	if (unchanged) {
+		releaseNode(pendingVersion, 0);
+	}
+	else {
+		for (const EditVersion& redone : redoStack) {
+			releaseNode(redone.root, 0);
+			historyNodes -= redone.nodeCount;
+		}
+		redoStack.clear();
+
+		undoStack.push_back({ pendingVersion, nextVersionId++, pendingNodes + 1 });
+		historyNodes += pendingNodes + 1;
+		trimHistory();
+	}
+	pendingVersion = 0;
+}
+
+void SVDAGEditor::trimHistory()
+{
+	while (!undoStack.empty() && historyNodes * sizeof(SVDAGGPUNode) > historyBudget) {
+		releaseNode(undoStack.front().root, 0);
+		historyNodes -= undoStack.front().nodeCount;
+		undoStack.pop_front();
+	}
+}
+
+// Node 0 and the version trade contents and each keeps its single reference, so no counts change
+void SVDAGEditor::swapRoot(uint32_t versionIndex)
+{
+	SVDAGGPUNode& root = nodes[rootNodeIndex];
+	SVDAGGPUNode& version = nodes[versionIndex];
+	std::swap(root, version);
+	std::swap(root.refs, version.refs);
+	nodes.markDirty(rootNodeIndex);
+	nodes.markDirty(versionIndex);
+}
+
+bool SVDAGEditor::undo()
+{
+	if (undoStack.empty() || strokeOpen) {
 		return false;
 	}
-	rootNodeIndex = recursiveModify(rootNodeIndex, worldPos, 0, true, material);
+
+	EditVersion version = undoStack.back();
+	undoStack.pop_back();
+	swapRoot(version.root);
+	redoStack.push_back(version);
+
+	if (journal && version.id < journalBoundary) {
+		journal->invalidate();
+	}
+	else if (journal) {
+		journal->appendMarker(JOURNAL_UNDO);
+	}
 	return true;
 }
 
-bool SVDAGEditor::clearVoxel(const glm::vec3& worldPos) {
-	if (glm::any(glm::lessThan(worldPos, glm::vec3(0))) || glm::any(glm::greaterThanEqual(worldPos, glm::vec3(1)))) {
+bool SVDAGEditor::redo()
+{
+	if (redoStack.empty() || strokeOpen) {
 		return false;
 	}
-	rootNodeIndex = recursiveModify(rootNodeIndex, worldPos, 0, false, 0);
+
+	EditVersion version = redoStack.back();
+	redoStack.pop_back();
+	swapRoot(version.root);
+	undoStack.push_back(version);
+
+	if (journal && version.id < journalBoundary) {
+		journal->invalidate();
+	}
+	else if (journal) {
+		journal->appendMarker(JOURNAL_REDO);
+	}
 	return true;
 }
 
+void SVDAGEditor::beginStroke()
+{
+	strokeOpen = true;
+	strokeJournaled = false;
+}
+
+void SVDAGEditor::endStroke()
+{
+	strokeOpen = false;
+	commitEdits();
+
+	if (journal && strokeJournaled) {
+		journal->appendMarker(JOURNAL_END_STROKE);
+	}
+	strokeJournaled = false;
+}
+
+// Strokes without edits leave no trace in the journal
+EditJournal* SVDAGEditor::journalEdit()
+{
+	if (!journal) {
+		return nullptr;
+	}
+	if (strokeOpen && !strokeJournaled) {
+		journal->appendMarker(JOURNAL_BEGIN_STROKE);
+		strokeJournaled = true;
+	}
+	return journal.get();
+}
+
+void SVDAGEditor::setHistoryBudget(size_t bytes)
+{
+	historyBudget = bytes;
+	trimHistory();
+	commitEdits();
+}
+
+void SVDAGEditor::onNodesCompacted()
+{
+	dedupIndex.clear();
+	undoStack.clear();
+	redoStack.clear();
+	historyNodes = 0;
+	pendingVersion = 0;
+	clipboard = {};
+	clipboardJournaled = false;
+}
+
+uint32_t SVDAGEditor::canonicalize(uint32_t nodeIndex, uint32_t currentDepth)
+{
+	auto touched = touchedNodes.find(nodeIndex);
+	if (touched == touchedNodes.end()) {
+		return nodeIndex;
+	}
+	if (touched->second != NO_NODE) {
+		if (touched->second != nodeIndex) {
+			nodes[touched->second].refs++;
+			nodes.markDirty(touched->second);
+		}
+		return touched->second;
+	}
+
+	SVDAGGPUNode& node = nodes[nodeIndex];
+	bool solid = node.childMask == 0xFFu && node.children[0] == 0u;
+	if (!solid && currentDepth < maxDepth - 1) {
+		for (int c = 0; c < 8; c++) {
+			if ((node.childMask & (1u << c)) == 0 || node.children[c] == 0) continue;
+
+			uint32_t oldChildIndex = node.children[c];
+			uint32_t newChildIndex = canonicalize(oldChildIndex, currentDepth + 1);
+			if (newChildIndex != oldChildIndex) {
+				node.children[c] = newChildIndex;
+				releaseNode(oldChildIndex, currentDepth + 1);
+			}
+		}
+	}
+
+	// The root stays in place because the renderer always starts from it, and so do the other fixed levels
+	uint32_t canonicalIndex = nodeIndex;
+	if (currentDepth >= fixedLevels) {
+		NodeKey key = makeKey(node, currentDepth);
+		auto [entry, inserted] = dedupIndex.try_emplace(key, nodeIndex);
+		if (!inserted && entry->second != nodeIndex) {
+			// Entries go stale when their node is released or edited in place, so check before sharing
+			const SVDAGGPUNode& candidate = nodes[entry->second];
+			if (candidate.refs > 0 && makeKey(candidate, currentDepth) == key) {
+				canonicalIndex = entry->second;
+				nodes[canonicalIndex].refs++;
+				nodes.markDirty(canonicalIndex);
+			}
+			else {
+				entry->second = nodeIndex;
+			}
+		}
+	}
+
+	touched->second = canonicalIndex;
+	return canonicalIndex;
+}
+
+bool SVDAGEditor::setVoxel(const glm::vec3& worldPos, uint16_t material) {
+    glm::uvec3 voxel;
+    return toVoxel(worldPos, voxel) && setVoxel(voxel, material);
+}
+
+bool SVDAGEditor::clearVoxel(const glm::vec3& worldPos) {
+    glm::uvec3 voxel;
+    return toVoxel(worldPos, voxel) && clearVoxel(voxel);
+}
+
 bool SVDAGEditor::paintVoxel(const glm::vec3& worldPos, uint16_t material) {
+    glm::uvec3 voxel;
+    return toVoxel(worldPos, voxel) && paintVoxel(voxel, material);
+}
+
+bool SVDAGEditor::setVoxel(const glm::uvec3& voxel, uint16_t material) {
+    return applyEdit({ voxel, material, VOXEL_SET });
+}
+
+bool SVDAGEditor::clearVoxel(const glm::uvec3& voxel) {
+    return applyEdit({ voxel, 0, VOXEL_CLEAR });
+}
+
+bool SVDAGEditor::paintVoxel(const glm::uvec3& voxel, uint16_t material) {
+    return applyEdit({ voxel, material, VOXEL_PAINT });
+}
+
+bool SVDAGEditor::getVoxel(const glm::uvec3& voxel, uint16_t* material) const {
+    if (glm::any(glm::greaterThanEqual(voxel, glm::uvec3(1u << maxDepth)))) {
+        return false;
+    }
+
+    uint32_t nodeIndex = rootNodeIndex;
+    for (uint32_t depth = 0; depth < maxDepth; depth++) {
+        const SVDAGGPUNode& node = nodes[nodeIndex];
+        if (node.childMask == 0xFFu && node.children[0] == 0u) {
+            if (material) *material = node.material;
+            return true;
+        }
+
+        uint32_t shift = maxDepth - 1 - depth;
+        uint32_t octant = ((voxel.x >> shift) & 1) | (((voxel.y >> shift) & 1) << 1) | (((voxel.z >> shift) & 1) << 2);
+        if ((node.childMask & (1u << octant)) == 0) {
+            return false;
+        }
+        if (depth == maxDepth - 1) {
+            if (material) *material = node.material;
+            return true;
+        }
+
+        nodeIndex = node.children[octant];
+        if (nodeIndex == 0) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool SVDAGEditor::isMortonInside(uint64_t code) const {
+    return maxDepth <= MAX_MORTON_DEPTH && code < (uint64_t(1) << (3 * maxDepth));
+}
+
+bool SVDAGEditor::setVoxelMorton(uint64_t code, uint16_t material) {
+    return isMortonInside(code) && setVoxel(mortonDecode(code), material);
+}
+
+bool SVDAGEditor::clearVoxelMorton(uint64_t code) {
+    return isMortonInside(code) && clearVoxel(mortonDecode(code));
+}
+
+bool SVDAGEditor::paintVoxelMorton(uint64_t code, uint16_t material) {
+    return isMortonInside(code) && paintVoxel(mortonDecode(code), material);
+}
+
+bool SVDAGEditor::getVoxelMorton(uint64_t code, uint16_t* material) const {
+    return isMortonInside(code) && getVoxel(mortonDecode(code), material);
+}
+
+namespace {
+    // Spreads the low 21 bits of v so that two zero bits follow each one
+    uint64_t spreadBits(uint64_t v) {
+        v &= 0x1FFFFF;
+        v = (v | (v << 32)) & 0x1F00000000FFFFull;
+        v = (v | (v << 16)) & 0x1F0000FF0000FFull;
+        v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+        v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+        v = (v | (v << 2)) & 0x1249249249249249ull;
+        return v;
+    }
+
+    uint32_t compactBits(uint64_t v) {
+        v &= 0x1249249249249249ull;
+        v = (v | (v >> 2)) & 0x10C30C30C30C30C3ull;
+        v = (v | (v >> 4)) & 0x100F00F00F00F00Full;
+        v = (v | (v >> 8)) & 0x1F0000FF0000FFull;
+        v = (v | (v >> 16)) & 0x1F00000000FFFFull;
+        v = (v | (v >> 32)) & 0x1FFFFF;
+        return static_cast<uint32_t>(v);
+    }
+}
+
+uint64_t SVDAGEditor::mortonEncode(const glm::uvec3& voxel) {
+    return spreadBits(voxel.x) | (spreadBits(voxel.y) << 1) | (spreadBits(voxel.z) << 2);
+}
+
+glm::uvec3 SVDAGEditor::mortonDecode(uint64_t code) {
+    return glm::uvec3(compactBits(code), compactBits(code >> 1), compactBits(code >> 2));
+}
+
+namespace {
+    bool lessMostSignificantBit(uint32_t a, uint32_t b) {
+        return a < b && a < (a ^ b);
+    }
+
+    // Orders voxels by the axis holding the highest differing bit, z before y before x like the octant bits
+    bool mortonLess(const glm::uvec3& a, const glm::uvec3& b) {
+        int axis = 2;
+        uint32_t highest = a.z ^ b.z;
+        if (lessMostSignificantBit(highest, a.y ^ b.y)) {
+            axis = 1;
+            highest = a.y ^ b.y;
+        }
+        if (lessMostSignificantBit(highest, a.x ^ b.x)) {
+            axis = 0;
+        }
+        return a[axis] < b[axis];
+    }
+}
+
+void SVDAGEditor::applyEdits(std::vector<VoxelEdit>& edits) {
+    uint32_t resolution = 1u << maxDepth;
+    std::erase_if(edits, [resolution](const VoxelEdit& edit) {
+        return glm::any(glm::greaterThanEqual(edit.voxel, glm::uvec3(resolution)));
+        });
+    if (edits.empty()) {
+        return;
+    }
+
+    std::stable_sort(edits.begin(), edits.end(), [](const VoxelEdit& a, const VoxelEdit& b) {
+        return mortonLess(a.voxel, b.voxel);
+        });
+    beginEdit();
+    editTopDown([&] { return recursiveApplyEdits(rootNodeIndex, edits.data(), edits.data() + edits.size(), 0); });
+    commitEdits();
+
+    if (EditJournal* log = journalEdit()) {
+        log->appendVoxels(edits.data(), edits.size());
+    }
+}
+
+bool SVDAGEditor::applyEdit(const VoxelEdit& edit) {
+    if (glm::any(glm::greaterThanEqual(edit.voxel, glm::uvec3(1u << maxDepth)))) {
+        return false;
+    }
+    beginEdit();
+    rootNodeIndex = applyEditAlongPath(edit);
+    commitEdits();
+
+    if (EditJournal* log = journalEdit()) {
+        log->appendVoxels(&edit, 1);
+    }
+    return true;
+}
+
+// Edits above the split depth run here and leave the subtrees below it to deferChild. Those are edited in
+// parallel, each worker allocating into its own arena and recording what it would retain or release in the
+// pool, since two workers may hold the same shared node. The arenas are then moved into the pool serially
+void SVDAGEditor::editTopDown(const std::function<uint32_t()>& descend) {
+    std::vector<ChildTask> tasks;
+    splitDepth = std::max(parallelDepth, fixedLevels);
+    if (parallelDepth > 0 && splitDepth + 1 < maxDepth) {
+        childTasks = &tasks;
+    }
+    rootNodeIndex = descend();
+    childTasks = nullptr;
+
+    if (tasks.size() == 1) {
+        tasks[0].result = tasks[0].run();
+    }
+    else if (!tasks.empty()) {
+        std::for_each(std::execution::par, tasks.begin(), tasks.end(), [](ChildTask& task) {
+            activeArena = &task.arena;
+            task.result = task.run();
+            activeArena = nullptr;
+            });
+    }
+
+    // Live arena nodes first, so every parent slot and child refers to pool indices before anything is released
+    std::vector<uint32_t> placed;
+    for (ChildTask& task : tasks) {
+        std::deque<SVDAGGPUNode>& arenaNodes = task.arena.nodes;
+        placed.assign(arenaNodes.size(), 0);
+        for (size_t i = 0; i < arenaNodes.size(); i++) {
+            if (arenaNodes[i].refs > 0) {
+                placed[i] = allocateNode(arenaNodes[i]);
+            }
+        }
+        auto toPool = [&](uint32_t index) { return (index & ARENA_NODE) ? placed[index & ~ARENA_NODE] : index; };
+
+        for (size_t i = 0; i < arenaNodes.size(); i++) {
+            if (placed[i] == 0) continue;
+            SVDAGGPUNode& node = nodes[placed[i]];
+            for (uint32_t& child : node.children) {
+                child = toPool(child);
+            }
+        }
+        task.result = toPool(task.result);
+
+        for (uint32_t retained : task.arena.retained) {
+            nodes[retained].refs++;
+            nodes.markDirty(retained);
+        }
+    }
+
+    for (ChildTask& task : tasks) {
+        uint32_t newChildIndex = task.result;
+        if (newChildIndex != task.child && task.child != 0) {
+            releaseNode(task.child, task.depth);
+        }
+        if (newChildIndex != 0 && nodes[newChildIndex].childMask == 0) {
+            releaseNode(newChildIndex, task.depth);
+            newChildIndex = 0;
+        }
+
+        SVDAGGPUNode& parent = nodes[task.parent];
+        uint32_t childBit = 1u << task.octant;
+        parent.children[task.octant] = newChildIndex;
+        if (newChildIndex != 0) {
+            parent.childMask |= childBit;
+        }
+        else {
+            parent.childMask &= ~childBit;
+        }
+        nodes.markDirty(task.parent);
+
+        for (auto [released, depth] : task.arena.released) {
+            releaseNode(released, depth);
+        }
+    }
+    if (!tasks.empty()) {
+        pruneEmpty(rootNodeIndex, 0);
+    }
+}
+
+// Drops the nodes above the split depth that the workers left empty
+void SVDAGEditor::pruneEmpty(uint32_t nodeIndex, uint32_t currentDepth) {
+    SVDAGGPUNode& node = nodes[nodeIndex];
+    bool solid = node.childMask == 0xFFu && node.children[0] == 0u;
+    if (solid || currentDepth + 1 >= splitDepth) {
+        return;
+    }
+
+    for (uint32_t octant = 0; octant < 8; octant++) {
+        uint32_t childIndex = node.children[octant];
+        if ((node.childMask & (1u << octant)) == 0 || childIndex == 0 || !touchedNodes.contains(childIndex)) continue;
+
+        pruneEmpty(childIndex, currentDepth + 1);
+        if (nodes[childIndex].childMask == 0) {
+            releaseNode(childIndex, currentDepth + 1);
+            node.children[octant] = 0;
+            node.childMask &= ~(1u << octant);
+            nodes.markDirty(nodeIndex);
+        }
+    }
+}
+
+bool SVDAGEditor::deferChild(uint32_t parentIndex, uint32_t octant, uint32_t childIndex, uint32_t childDepth, std::function<uint32_t()> run) {
+    if (!childTasks || childDepth != splitDepth) {
+        return false;
+    }
+    childTasks->push_back({ parentIndex, octant, childIndex, childDepth, std::move(run), 0, {} });
+    return true;
+}
+
+// A float only tells voxels apart down to about depth 24; deeper trees need the integer or Morton entry points
+bool SVDAGEditor::toVoxel(const glm::vec3& worldPos, glm::uvec3& outVoxel) const {
     if (glm::any(glm::lessThan(worldPos, glm::vec3(0))) || glm::any(glm::greaterThanEqual(worldPos, glm::vec3(1)))) {
         return false;
     }
-    rootNodeIndex = recursivePaint(rootNodeIndex, worldPos, 0, material);
+    uint32_t resolution = 1u << maxDepth;
+    outVoxel = glm::min(glm::uvec3(glm::dvec3(worldPos) * static_cast<double>(resolution)), glm::uvec3(resolution - 1));
     return true;
 }
 
-uint32_t SVDAGEditor::recursiveModify(uint32_t nodeIndex, const glm::vec3& targetPos, uint32_t currentDepth, bool addVoxel, uint16_t material) {
-    uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
-    SVDAGGPUNode& node = nodes[mutableNodeIndex];
+// The same result as recursiveApplyEdits for one edit. The first walk finds where the voxel's path ends and
+// whether the edit changes anything there, the second copies the path down to it and the last one drops
+// the nodes the edit emptied on the way back up
+uint32_t SVDAGEditor::applyEditAlongPath(const VoxelEdit& edit) {
+    uint32_t depth = 0;
+    uint32_t nodeIndex = rootNodeIndex;
+    while (depth < maxDepth - 1) {
+        const SVDAGGPUNode& node = nodes[nodeIndex];
+        uint32_t octant = octantAt(edit.voxel, depth);
+        if ((node.childMask == 0xFFu && node.children[0] == 0u) || (node.childMask & (1u << octant)) == 0 || node.children[octant] == 0) {
+            break;
+        }
+        nodeIndex = node.children[octant];
+        depth++;
+    }
 
-    if (currentDepth == maxDepth - 1) {
-        glm::vec3 relPos = glm::fract(targetPos * exp2f(currentDepth));
-        uint32_t octant = (relPos.x > 0.5f ? 1 : 0) | (relPos.y > 0.5f ? 2 : 0) | (relPos.z > 0.5f ? 4 : 0);
-        uint32_t childBit = 1u << octant;
+    const SVDAGGPUNode& end = nodes[nodeIndex];
+    uint32_t endBit = 1u << octantAt(edit.voxel, depth);
+    bool changes;
+    if (depth == maxDepth - 1) {
+        bool filled = (end.childMask & endBit) != 0;
+        changes = edit.op == VOXEL_SET ? !filled || end.material != edit.material :
+            edit.op == VOXEL_CLEAR ? filled : filled && end.material != edit.material;
+    }
+    else if (end.childMask == 0xFFu && end.children[0] == 0u) {
+        changes = edit.op == VOXEL_CLEAR || edit.material != end.material;
+    }
+    else {
+        changes = edit.op == VOXEL_SET;
+    }
+    if (!changes) {
+        return rootNodeIndex;
+    }
 
-        if (addVoxel) {
-            node.childMask |= childBit;
-            node.material = material;
+    uint32_t path[MAX_TREE_DEPTH];
+    path[0] = ensureNodeIsMutable(rootNodeIndex);
+    for (depth = 0; depth < maxDepth - 1; depth++) {
+        SVDAGGPUNode& node = nodes[path[depth]];
+        if (node.childMask == 0xFFu && node.children[0] == 0u) {
+            SVDAGGPUNode solidChild = node;
+            solidChild.refs = 8;
+            uint32_t solidChildIndex = allocateNode(solidChild);
+            std::fill(std::begin(node.children), std::end(node.children), solidChildIndex);
+        }
+
+        uint32_t octant = octantAt(edit.voxel, depth);
+        uint32_t oldChildIndex = (node.childMask & (1u << octant)) ? node.children[octant] : 0;
+        uint32_t childIndex;
+        if (oldChildIndex == 0) {
+            SVDAGGPUNode newNode = {};
+            newNode.refs = 1;
+            childIndex = allocateNode(newNode);
         }
         else {
-            node.childMask &= ~childBit;
+            childIndex = ensureNodeIsMutable(oldChildIndex);
+            if (childIndex != oldChildIndex) {
+                releaseNode(oldChildIndex, depth + 1);
+            }
         }
-        return mutableNodeIndex;
+        // allocateNode may have grown the pool, but segments never move
+        node.children[octant] = childIndex;
+        node.childMask |= 1u << octant;
+        path[depth + 1] = childIndex;
+    }
+
+    SVDAGGPUNode& leaf = nodes[path[depth]];
+    uint32_t leafBit = 1u << octantAt(edit.voxel, depth);
+    if (edit.op == VOXEL_SET) {
+        leaf.childMask |= leafBit;
+        leaf.material = edit.material;
+    }
+    else if (edit.op == VOXEL_CLEAR) {
+        leaf.childMask &= ~leafBit;
+    }
+    else if (leaf.childMask & leafBit) {
+        leaf.material = edit.material;
+    }
+
+    for (; depth > 0 && nodes[path[depth]].childMask == 0; depth--) {
+        releaseNode(path[depth], depth);
+        SVDAGGPUNode& parent = nodes[path[depth - 1]];
+        uint32_t octant = octantAt(edit.voxel, depth - 1);
+        parent.children[octant] = 0;
+        parent.childMask &= ~(1u << octant);
+    }
+    return path[0];
+}
+
+uint32_t SVDAGEditor::octantAt(const glm::uvec3& voxel, uint32_t currentDepth) const {
+    uint32_t shift = maxDepth - 1 - currentDepth;
+    return ((voxel.x >> shift) & 1) | (((voxel.y >> shift) & 1) << 1) | (((voxel.z >> shift) & 1) << 2);
+}
+
+// A node whose last parent let go takes its references to its children with it. Below the root, only
+// history versions live at depth 0. Workers leave nodes outside their arena to the stitching pass
+void SVDAGEditor::releaseNode(uint32_t nodeIndex, uint32_t currentDepth) {
+    if (activeArena && (nodeIndex & ARENA_NODE) == 0) {
+        activeArena->released.push_back({ nodeIndex, currentDepth });
+        return;
+    }
+
+    SVDAGGPUNode& node = nodeAt(nodeIndex);
+    node.refs--;
+    if (!activeArena) {
+        nodes.markDirty(nodeIndex);
+    }
+    if (node.refs > 0 || (currentDepth > 0 && currentDepth < fixedLevels)) {
+        return;
     }
 
-    glm::vec3 relPos = glm::fract(targetPos * exp2f(currentDepth));
-    uint32_t octant = (relPos.x > 0.5f ? 1 : 0) | (relPos.y > 0.5f ? 2 : 0) | (relPos.z > 0.5f ? 4 : 0);
-    uint32_t childBit = 1u << octant;
+    bool solid = node.childMask == 0xFFu && node.children[0] == 0u;
+    if (!solid && currentDepth < maxDepth - 1) {
+        for (int c = 0; c < 8; c++) {
+            if ((node.childMask & (1u << c)) && node.children[c] != 0) {
+                releaseNode(node.children[c], currentDepth + 1);
+            }
+        }
+    }
+    // Dead arena nodes are simply never copied into the pool
+    if (!activeArena) {
+        releasedNodes.push_back(nodeIndex);
+    }
+}
+
+// [first, last) are the Morton-sorted edits inside this node. A node is only copied once all edits below
+// it are known to change something, and index 0 below the root means the child does not exist yet
+uint32_t SVDAGEditor::recursiveApplyEdits(uint32_t nodeIndex, const VoxelEdit* first, const VoxelEdit* last, uint32_t currentDepth) {
+    if (nodeIndex == 0 && currentDepth > 0) {
+        if (std::none_of(first, last, [](const VoxelEdit& edit) { return edit.op == VOXEL_SET; })) {
+            return 0;
+        }
 
-    if ((node.childMask & childBit) == 0 && addVoxel) {
         SVDAGGPUNode newNode = {};
         newNode.refs = 1;
-        uint32_t newChildIndex = nodes.size();
-        nodes.push_back(newNode);
-
-        node.children[octant] = newChildIndex;
-        node.childMask |= childBit;
+        nodeIndex = allocateNode(newNode);
     }
-    else if ((node.childMask & childBit) == 0) {
+
+    if (currentDepth == maxDepth - 1) {
+        SVDAGGPUNode updated = nodeAt(nodeIndex);
+        for (const VoxelEdit* edit = first; edit != last; ++edit) {
+            uint32_t childBit = 1u << octantAt(edit->voxel, currentDepth);
+            if (edit->op == VOXEL_SET) {
+                updated.childMask |= childBit;
+                updated.material = edit->material;
+            }
+            else if (edit->op == VOXEL_CLEAR) {
+                updated.childMask &= ~childBit;
+            }
+            else if (updated.childMask & childBit) {
+                updated.material = edit->material;
+            }
+        }
+
+        if (updated.childMask == nodeAt(nodeIndex).childMask && updated.material == nodeAt(nodeIndex).material) {
+            return nodeIndex;
+        }
+        uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
+        nodeAt(mutableNodeIndex).childMask = updated.childMask;
+        nodeAt(mutableNodeIndex).material = updated.material;
         return mutableNodeIndex;
     }
 
-    uint32_t oldChildIndex = node.children[octant];
-    uint32_t newChildIndex = recursiveModify(oldChildIndex, targetPos, currentDepth + 1, addVoxel, material);
+    const SVDAGGPUNode& current = nodeAt(nodeIndex);
+    bool solid = current.childMask == 0xFFu && current.children[0] == 0u;
+    bool changes = std::any_of(first, last, [&](const VoxelEdit& edit) {
+        if (solid) return edit.op == VOXEL_CLEAR || edit.material != current.material;
+        return edit.op == VOXEL_SET || (current.childMask & (1u << octantAt(edit.voxel, currentDepth))) != 0;
+        });
+    if (!changes) {
+        return nodeIndex;
+    }
+
+    uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
+    if (solid) {
+        // Split into eight references to one solid child; copy-on-write separates them as they are edited
+        SVDAGGPUNode solidChild = nodeAt(mutableNodeIndex);
+        solidChild.refs = 8;
+        uint32_t solidChildIndex = allocateNode(solidChild);
+        std::fill(std::begin(nodeAt(mutableNodeIndex).children), std::end(nodeAt(mutableNodeIndex).children), solidChildIndex);
+    }
+
+    const VoxelEdit* octantBegin = first;
+    while (octantBegin != last) {
+        uint32_t octant = octantAt(octantBegin->voxel, currentDepth);
+        const VoxelEdit* octantEnd = octantBegin + 1;
+        while (octantEnd != last && octantAt(octantEnd->voxel, currentDepth) == octant) {
+            ++octantEnd;
+        }
+
+        SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
+        uint32_t childBit = 1u << octant;
+        uint32_t oldChildIndex = (node.childMask & childBit) ? node.children[octant] : 0;
+        if (deferChild(mutableNodeIndex, octant, oldChildIndex, currentDepth + 1, [=, this] {
+            return recursiveApplyEdits(oldChildIndex, octantBegin, octantEnd, currentDepth + 1);
+            })) {
+            octantBegin = octantEnd;
+            continue;
+        }
+        uint32_t newChildIndex = recursiveApplyEdits(oldChildIndex, octantBegin, octantEnd, currentDepth + 1);
+
+        if (newChildIndex != oldChildIndex && oldChildIndex != 0) {
+            releaseNode(oldChildIndex, currentDepth + 1);
+        }
+        // Above the split depth, children still waiting for a worker make the node look empty
+        if (newChildIndex != 0 && !childTasks && nodeAt(newChildIndex).childMask == 0) {
+            releaseNode(newChildIndex, currentDepth + 1);
+            newChildIndex = 0;
+        }
 
-    if (newChildIndex != oldChildIndex) {
         node.children[octant] = newChildIndex;
-        nodes[oldChildIndex].refs--;
-        modifiedIndices.push_back(oldChildIndex);
+        if (newChildIndex != 0) {
+            node.childMask |= childBit;
+        }
+        else {
+            node.childMask &= ~childBit;
+        }
+        octantBegin = octantEnd;
     }
 
     return mutableNodeIndex;
 }
 
-uint32_t SVDAGEditor::recursivePaint(uint32_t nodeIndex, const glm::vec3& targetPos, uint32_t currentDepth, uint16_t material) {
-    if (nodeIndex == 0) {
+void SVDAGEditor::modifyShape(const SDFShape& shape, VoxelEditOp op, uint16_t material) {
+    ShapeEdit edit = { shape, op, material, 0, {} };
+    beginEdit();
+    editTopDown([&] { return recursiveModifyShape(rootNodeIndex, glm::uvec3(0), 0, edit); });
+    commitEdits();
+
+    if (EditJournal* log = journalEdit()) {
+        log->appendShape(shape.parameters, op, material);
+    }
+}
+
+// Voxels are inside when the distance at their center is <= 0. The node's voxel centers lie within
+// (size - 1) * sqrt(3) / 2 of its center, so the Lipschitz bound turns one sample into a whole-node answer
+uint32_t SVDAGEditor::recursiveModifyShape(uint32_t nodeIndex, const glm::uvec3& nodeMin, uint32_t currentDepth, ShapeEdit& edit) {
+    uint32_t size = 1u << (maxDepth - currentDepth);
+    float distance = edit.shape.distance(glm::vec3(nodeMin) + size * 0.5f);
+    float reach = edit.shape.lipschitz * (size - 1) * 0.8660254f;
+    if (distance > reach) {
         return nodeIndex;
     }
 
-    if (currentDepth == maxDepth - 1) {
-        glm::vec3 relPos = glm::fract(targetPos * exp2f(currentDepth));
-        uint32_t octant = (relPos.x > 0.5f ? 1 : 0) | (relPos.y > 0.5f ? 2 : 0) | (relPos.z > 0.5f ? 4 : 0);
-        uint32_t childBit = 1u << octant;
+    bool absent = nodeIndex == 0 && currentDepth > 0;
+    if (distance <= -reach && currentDepth > 0) {
+        if (edit.op == VOXEL_CLEAR) {
+            return 0;
+        }
+        if (edit.op == VOXEL_PAINT) {
+            return absent ? 0 : paintSubtree(nodeIndex, currentDepth, edit);
+        }
 
-        if ((nodes[nodeIndex].childMask & childBit) != 0) {
-            uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
-            nodes[mutableNodeIndex].material = material;
-            return mutableNodeIndex;
+        // Every filled node shares one solid node
+        if (edit.solidNode == 0) {
+            SVDAGGPUNode solidNode = {};
+            solidNode.childMask = 0xFF;
+            solidNode.material = edit.material;
+            edit.solidNode = allocateNode(solidNode);
         }
-        else {
-            return nodeIndex;
+        retainNode(edit.solidNode);
+        return edit.solidNode;
+    }
+
+    if (absent) {
+        if (edit.op != VOXEL_SET) {
+            return 0;
         }
+        SVDAGGPUNode newNode = {};
+        newNode.refs = 1;
+        nodeIndex = allocateNode(newNode);
     }
 
-    if (nodes[nodeIndex].childMask == 0xFFu && nodes[nodeIndex].children[0] == 0u) {
+    if (currentDepth == maxDepth - 1) {
+        SVDAGGPUNode updated = nodeAt(nodeIndex);
+        for (uint32_t octant = 0; octant < 8; octant++) {
+            glm::uvec3 voxel = nodeMin + glm::uvec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1);
+            if (edit.shape.distance(glm::vec3(voxel) + 0.5f) > 0.0f) continue;
+
+            uint32_t childBit = 1u << octant;
+            if (edit.op == VOXEL_SET) {
+                updated.childMask |= childBit;
+                updated.material = edit.material;
+            }
+            else if (edit.op == VOXEL_CLEAR) {
+                updated.childMask &= ~childBit;
+            }
+            else if (updated.childMask & childBit) {
+                updated.material = edit.material;
+            }
+        }
+
+        if (updated.childMask == nodeAt(nodeIndex).childMask && updated.material == nodeAt(nodeIndex).material) {
+            return nodeIndex;
+        }
         uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
-        nodes[mutableNodeIndex].material = material;
+        nodeAt(mutableNodeIndex).childMask = updated.childMask;
+        nodeAt(mutableNodeIndex).material = updated.material;
         return mutableNodeIndex;
     }
 
-    glm::vec3 relPos = glm::fract(targetPos * exp2f(currentDepth));
-    uint32_t octant = (relPos.x > 0.5f ? 1 : 0) | (relPos.y > 0.5f ? 2 : 0) | (relPos.z > 0.5f ? 4 : 0);
-    uint32_t childBit = 1u << octant;
-
-    if ((nodes[nodeIndex].childMask & childBit) == 0) {
+    const SVDAGGPUNode& current = nodeAt(nodeIndex);
+    bool solid = current.childMask == 0xFFu && current.children[0] == 0u;
+    if (solid && edit.op != VOXEL_CLEAR && current.material == edit.material) {
         return nodeIndex;
     }
 
     uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
-    SVDAGGPUNode& node = nodes[mutableNodeIndex];
+    if (solid) {
+        SVDAGGPUNode solidChild = nodeAt(mutableNodeIndex);
+        solidChild.refs = 8;
+        uint32_t solidChildIndex = allocateNode(solidChild);
+        std::fill(std::begin(nodeAt(mutableNodeIndex).children), std::end(nodeAt(mutableNodeIndex).children), solidChildIndex);
+    }
 
-    uint32_t oldChildIndex = node.children[octant];
-    uint32_t newChildIndex = recursivePaint(oldChildIndex, targetPos, currentDepth + 1, material);
+    uint32_t half = size / 2;
+    for (uint32_t octant = 0; octant < 8; octant++) {
+        SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
+        uint32_t childBit = 1u << octant;
+        glm::uvec3 childMin = nodeMin + glm::uvec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1) * half;
+
+        uint32_t oldChildIndex = (node.childMask & childBit) ? node.children[octant] : 0;
+        // Each subtree gets its own solid node and paint memo; the commit shares them again
+        if (deferChild(mutableNodeIndex, octant, oldChildIndex, currentDepth + 1, [=, this, &shape = edit.shape, op = edit.op, material = edit.material] {
+            ShapeEdit subtreeEdit = { shape, op, material, 0, {} };
+            return recursiveModifyShape(oldChildIndex, childMin, currentDepth + 1, subtreeEdit);
+            })) {
+            continue;
+        }
+        uint32_t newChildIndex = recursiveModifyShape(oldChildIndex, childMin, currentDepth + 1, edit);
+
+        if (newChildIndex != oldChildIndex && oldChildIndex != 0) {
+            releaseNode(oldChildIndex, currentDepth + 1);
+        }
+        // Above the split depth, children still waiting for a worker make the node look empty
+        if (newChildIndex != 0 && !childTasks && nodeAt(newChildIndex).childMask == 0) {
+            releaseNode(newChildIndex, currentDepth + 1);
+            newChildIndex = 0;
+        }
 
-    if (newChildIndex != oldChildIndex) {
         node.children[octant] = newChildIndex;
-        nodes[oldChildIndex].refs--;
-        modifiedIndices.push_back(oldChildIndex);
+        if (newChildIndex != 0) {
+            node.childMask |= childBit;
+        }
+        else {
+            node.childMask &= ~childBit;
+        }
+    }
+
+    return mutableNodeIndex;
+}
+
+// Shared subtrees are repainted once and the copy is reused for every other parent inside the shape
+uint32_t SVDAGEditor::paintSubtree(uint32_t nodeIndex, uint32_t currentDepth, ShapeEdit& edit) {
+    auto it = edit.painted.find(nodeIndex);
+    if (it != edit.painted.end()) {
+        if (it->second != nodeIndex) {
+            retainNode(it->second);
+        }
+        return it->second;
+    }
+
+    uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
+    SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
+    node.material = edit.material;
+
+    bool solid = node.childMask == 0xFFu && node.children[0] == 0u;
+    if (!solid && currentDepth < maxDepth - 1) {
+        for (uint32_t octant = 0; octant < 8; octant++) {
+            uint32_t oldChildIndex = node.children[octant];
+            if ((node.childMask & (1u << octant)) == 0 || oldChildIndex == 0) continue;
+
+            uint32_t newChildIndex = paintSubtree(oldChildIndex, currentDepth + 1, edit);
+            if (newChildIndex != oldChildIndex) {
+                releaseNode(oldChildIndex, currentDepth + 1);
+                node.children[octant] = newChildIndex;
+            }
+        }
     }
 
+    edit.painted[nodeIndex] = mutableNodeIndex;
     return mutableNodeIndex;
 }
 
@@ -153,7 +989,13 @@ void SVDAGEditor::modifyRegion(const Box& targetBox, bool addVoxels, uint16_t ma
     uint32_t resolution = 1 << maxDepth;
     Box rootBox = { glm::uvec3(0), glm::uvec3(resolution - 1) };
 
-    rootNodeIndex = recursiveModifyRegion(rootNodeIndex, targetBox, rootBox, 0, addVoxels, material);
+    beginEdit();
+    editTopDown([&] { return recursiveModifyRegion(rootNodeIndex, targetBox, rootBox, 0, addVoxels, material); });
+    commitEdits();
+
+    if (EditJournal* log = journalEdit()) {
+        log->appendRegion(targetBox, addVoxels, material);
+    }
 }
 
 uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targetBox, const Box& nodeBox, uint32_t currentDepth, bool addVoxels, uint16_t material) {
@@ -174,7 +1016,7 @@ uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targe
 
     if (currentDepth == maxDepth - 1) {
         uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
-        SVDAGGPUNode& node = nodes[mutableNodeIndex];
+        SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
         for (uint32_t octant = 0; octant < 8; ++octant) {
             Box voxelBox = getChildBox(nodeBox, octant);
             if (boxesIntersect(targetBox, voxelBox)) {
@@ -191,10 +1033,10 @@ uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targe
         return mutableNodeIndex;
     }
 
-    if (nodes[nodeIndex].childMask == 0xFFu && nodes[nodeIndex].children[0] == 0u) {
+    if (nodeAt(nodeIndex).childMask == 0xFFu && nodeAt(nodeIndex).children[0] == 0u) {
 
         uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
-        SVDAGGPUNode& node = nodes[mutableNodeIndex];
+        SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
         uint16_t originalMaterial = node.material;
 
         for (int i = 0; i < 8; i++) {
@@ -206,7 +1048,7 @@ uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targe
     }
 
     uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
-    SVDAGGPUNode& node = nodes[mutableNodeIndex];
+    SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
 
     for (uint32_t octant = 0; octant < 8; ++octant) {
         Box childNodeBox = getChildBox(nodeBox, octant);
@@ -225,8 +1067,7 @@ uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targe
 
             SVDAGGPUNode newNode = {};
             newNode.refs = 1;
-            uint32_t newChildIndex = nodes.size();
-            nodes.push_back(newNode);
+            uint32_t newChildIndex = allocateNode(newNode);
 
             node.children[octant] = newChildIndex;
             node.childMask |= childBit;
@@ -236,6 +1077,11 @@ uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targe
             oldChildIndex = node.children[octant];
         }
 
+        if (deferChild(mutableNodeIndex, octant, oldChildIndex, currentDepth + 1, [=, this] {
+            return recursiveModifyRegion(oldChildIndex, targetBox, childNodeBox, currentDepth + 1, addVoxels, material);
+            })) {
+            continue;
+        }
         uint32_t newChildIndex = recursiveModifyRegion(
             oldChildIndex,
             targetBox,
@@ -249,8 +1095,327 @@ uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targe
             node.children[octant] = newChildIndex;
 
             if (oldChildIndex != 0) {
-                nodes[oldChildIndex].refs--;
-                modifiedIndices.push_back(oldChildIndex);
+                releaseNode(oldChildIndex, currentDepth + 1);
+            }
+
+            if (newChildIndex == 0) {
+                node.childMask &= ~childBit;
+            }
+        }
+    }
+
+    return mutableNodeIndex;
+}
+
+// The clip holds a reference of its own, so later edits to the source copy their path instead of changing it
+void SVDAGEditor::copyRegion(const Box& box) {
+    clearClipboard();
+    if (fixedLevels > 1) {
+        return;
+    }
+
+    uint32_t resolution = 1u << maxDepth;
+    Box region = { glm::min(box.min, box.max), glm::max(box.min, box.max) };
+    if (glm::any(glm::greaterThanEqual(region.min, glm::uvec3(resolution)))) {
+        return;
+    }
+    region.max = glm::min(region.max, glm::uvec3(resolution - 1));
+
+    // The smallest node whose cube holds the whole region; empty and solid nodes stand for everything below them
+    uint32_t nodeIndex = rootNodeIndex;
+    uint32_t depth = 0;
+    while (depth < maxDepth - 1 && (depth == 0 || nodeIndex != 0)) {
+        const SVDAGGPUNode& node = nodes[nodeIndex];
+        uint32_t octant = octantAt(region.min, depth);
+        if ((node.childMask == 0xFFu && node.children[0] == 0u) || octant != octantAt(region.max, depth)) {
+            break;
+        }
+        nodeIndex = (node.childMask & (1u << octant)) ? node.children[octant] : 0;
+        depth++;
+    }
+
+    if (depth == 0) {
+        // Node 0 has to stay the only reference to the root, so the clip pins a copy like a history version does
+        SVDAGGPUNode copy = nodes[rootNodeIndex];
+        copy.refs = 1;
+        bool solid = copy.childMask == 0xFFu && copy.children[0] == 0u;
+        if (!solid && maxDepth > 1) {
+            for (int c = 0; c < 8; c++) {
+                if ((copy.childMask & (1u << c)) && copy.children[c] != 0) {
+                    nodes[copy.children[c]].refs++;
+                    nodes.markDirty(copy.children[c]);
+                }
+            }
+        }
+        nodeIndex = nodes.allocate(copy);
+    }
+    else if (nodeIndex != 0) {
+        nodes[nodeIndex].refs++;
+        nodes.markDirty(nodeIndex);
+    }
+    clipboard = { nodeIndex, depth, region, true };
+
+    if (journal) {
+        journal->appendCopy(region);
+        clipboardJournaled = true;
+    }
+}
+
+void SVDAGEditor::clearClipboard() {
+    if (clipboard.valid && clipboard.root != 0) {
+        releaseNode(clipboard.root, clipboard.depth);
+        commitEdits();
+    }
+    clipboard = {};
+    clipboardJournaled = false;
+}
+
+bool SVDAGEditor::paste(const glm::uvec3& destination) {
+    uint32_t resolution = 1u << maxDepth;
+    if (!clipboard.valid || glm::any(glm::greaterThanEqual(destination, glm::uvec3(resolution)))) {
+        return false;
+    }
+
+    Box targetBox = { destination, glm::min(destination + (clipboard.box.max - clipboard.box.min), glm::uvec3(resolution - 1)) };
+    Box rootBox = { glm::uvec3(0), glm::uvec3(resolution - 1) };
+
+    beginEdit();
+    PasteWindow window = pasteWindow({}, rootBox.min - targetBox.min + clipboard.box.min, 0);
+    rootNodeIndex = recursivePaste(rootNodeIndex, targetBox, rootBox, 0, window);
+    commitEdits();
+
+    if (journal && !clipboardJournaled) {
+        journal->invalidate();
+    }
+    else if (EditJournal* log = journalEdit()) {
+        log->appendPaste(destination);
+    }
+    return true;
+}
+
+// The window of a node holds the clip nodes of its level on the 2x2x2 grid cells its source cube overlaps. Above
+// the clip's level there are none, and below it each cell is a child of one cell of the parent's window
+SVDAGEditor::PasteWindow SVDAGEditor::pasteWindow(const PasteWindow& parent, const glm::uvec3& sourceMin, uint32_t currentDepth) const {
+    uint32_t size = 1u << (maxDepth - currentDepth);
+    PasteWindow window;
+    window.min = sourceMin & glm::uvec3(~(size - 1));
+    if (currentDepth < clipboard.depth) {
+        return window;
+    }
+
+    glm::uvec3 clipMin = clipboard.box.min & glm::uvec3(~(size - 1));
+    for (uint32_t cell = 0; cell < 8; cell++) {
+        glm::uvec3 cellMin = window.min + glm::uvec3(cell & 1, (cell >> 1) & 1, (cell >> 2) & 1) * size;
+        if (currentDepth == clipboard.depth) {
+            window.cells[cell] = glm::all(glm::equal(cellMin, clipMin)) ? clipboard.root : 0;
+            continue;
+        }
+
+        // Source coordinates may wrap below zero, which the unsigned difference undoes
+        glm::uvec3 offset = (cellMin - parent.min) / size;
+        if (glm::any(glm::greaterThan(offset, glm::uvec3(3)))) {
+            continue;
+        }
+        uint32_t parentCell = (offset.x >> 1) | ((offset.y >> 1) << 1) | ((offset.z >> 1) << 2);
+        uint32_t octant = (offset.x & 1) | ((offset.y & 1) << 1) | ((offset.z & 1) << 2);
+        uint32_t parentIndex = parent.cells[parentCell];
+        if (parentIndex == 0) {
+            continue;
+        }
+
+        const SVDAGGPUNode& node = nodes[parentIndex];
+        if (node.childMask == 0xFFu && node.children[0] == 0u) {
+            window.cells[cell] = parentIndex;
+        }
+        else if (node.childMask & (1u << octant)) {
+            window.cells[cell] = node.children[octant];
+        }
+    }
+    return window;
+}
+
+// Reads one source voxel from a window at the leaf level, whose cells are leaf nodes two voxels wide
+bool SVDAGEditor::windowVoxel(const PasteWindow& window, const glm::uvec3& source, uint16_t* material) const {
+    glm::uvec3 offset = source - window.min;
+    if (glm::any(glm::greaterThan(offset, glm::uvec3(3)))) {
+        return false;
+    }
+
+    uint32_t cell = (offset.x >> 1) | ((offset.y >> 1) << 1) | ((offset.z >> 1) << 2);
+    uint32_t octant = (offset.x & 1) | ((offset.y & 1) << 1) | ((offset.z & 1) << 2);
+    uint32_t nodeIndex = window.cells[cell];
+    if (nodeIndex == 0) {
+        return false;
+    }
+
+    const SVDAGGPUNode& node = nodes[nodeIndex];
+    if ((node.childMask & (1u << octant)) == 0) {
+        return false;
+    }
+    *material = node.material;
+    return true;
+}
+
+// Builds the node a destination cube entirely inside the target gets, walking its source cells in lockstep with it.
+// A cube on the grid is its one source cell, shared with one more reference, and so is a misaligned cube whose cells
+// are all empty or all solid in one material. Anything else becomes a new node whose children are built the same
+// way, so each misaligned node costs one look at up to eight source nodes rather than a clip descent per voxel
+uint32_t SVDAGEditor::pasteNode(const PasteWindow& window, const glm::uvec3& sourceMin, uint32_t currentDepth) {
+    uint32_t size = 1u << (maxDepth - currentDepth);
+    glm::uvec3 misaligned = glm::uvec3(glm::notEqual(sourceMin & (size - 1), glm::uvec3(0)));
+
+    uint32_t shared = window.cells[0];
+    bool uniform = true;
+    if (misaligned != glm::uvec3(0)) {
+        const SVDAGGPUNode& first = nodes[shared];
+        bool solid = shared != 0 && first.childMask == 0xFFu && first.children[0] == 0u;
+        uniform = shared == 0 || solid;
+        for (uint32_t cell = 1; cell < 8 && uniform; cell++) {
+            if (((cell & 1) && !misaligned.x) || ((cell & 2) && !misaligned.y) || ((cell & 4) && !misaligned.z)) {
+                continue;
+            }
+
+            uint32_t cellIndex = window.cells[cell];
+            const SVDAGGPUNode& node = nodes[cellIndex];
+            if (solid) {
+                uniform = cellIndex != 0 && node.childMask == 0xFFu && node.children[0] == 0u && node.material == first.material;
+            }
+            else {
+                uniform = cellIndex == 0;
+            }
+        }
+    }
+    if (uniform) {
+        if (shared != 0) {
+            retainNode(shared);
+        }
+        return shared;
+    }
+
+    SVDAGGPUNode pasted = {};
+    pasted.refs = 1;
+    if (currentDepth == maxDepth - 1) {
+        for (uint32_t octant = 0; octant < 8; ++octant) {
+            glm::uvec3 source = sourceMin + glm::uvec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1);
+            uint16_t material = 0;
+            if (windowVoxel(window, source, &material)) {
+                pasted.childMask |= 1u << octant;
+                pasted.material = material;
+            }
+        }
+    }
+    else {
+        uint32_t childSize = size / 2;
+        for (uint32_t octant = 0; octant < 8; ++octant) {
+            glm::uvec3 childSource = sourceMin + glm::uvec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1) * childSize;
+            uint32_t childIndex = pasteNode(pasteWindow(window, childSource, currentDepth + 1), childSource, currentDepth + 1);
+            if (childIndex != 0) {
+                pasted.childMask |= 1u << octant;
+                pasted.children[octant] = childIndex;
+            }
+        }
+    }
+
+    if (pasted.childMask == 0) {
+        return 0;
+    }
+    return allocateNode(pasted);
+}
+
+// A destination node entirely inside the target is replaced by pasteNode. One on the target's border keeps its
+// voxels outside and recurses, carrying the window of source nodes down with it
+uint32_t SVDAGEditor::recursivePaste(uint32_t nodeIndex, const Box& targetBox, const Box& nodeBox, uint32_t currentDepth, const PasteWindow& window) {
+
+    if (!boxesIntersect(targetBox, nodeBox)) {
+        return nodeIndex;
+    }
+
+    if (currentDepth > 0 && boxContains(targetBox, nodeBox)) {
+        glm::uvec3 sourceMin = nodeBox.min - targetBox.min + clipboard.box.min;
+        uint32_t pastedIndex = pasteNode(window, sourceMin, currentDepth);
+        if (pastedIndex != 0 && pastedIndex == nodeIndex) {
+            // The node is already in place, and the parent keeps the reference it has
+            releaseNode(nodeIndex, currentDepth);
+        }
+        return pastedIndex;
+    }
+
+    if (currentDepth == maxDepth - 1) {
+        uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
+        SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
+        for (uint32_t octant = 0; octant < 8; ++octant) {
+            Box voxelBox = getChildBox(nodeBox, octant);
+            if (boxesIntersect(targetBox, voxelBox)) {
+                uint32_t childBit = 1u << octant;
+                uint16_t material = 0;
+                if (windowVoxel(window, voxelBox.min - targetBox.min + clipboard.box.min, &material)) {
+                    node.childMask |= childBit;
+                    node.material = material;
+                }
+                else {
+                    node.childMask &= ~childBit;
+                }
+            }
+        }
+        if (node.childMask == 0) {
+            if (mutableNodeIndex != nodeIndex) {
+                releaseNode(mutableNodeIndex, currentDepth);
+            }
+            return 0;
+        }
+        return mutableNodeIndex;
+    }
+
+    uint32_t originalNodeIndex = nodeIndex;
+    if (nodeAt(nodeIndex).childMask == 0xFFu && nodeAt(nodeIndex).children[0] == 0u) {
+
+        uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
+        SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
+        uint16_t originalMaterial = node.material;
+
+        for (int i = 0; i < 8; i++) {
+            node.children[i] = createSolidLeafNode(originalMaterial);
+        }
+
+        node.material = 0;
+        nodeIndex = mutableNodeIndex;
+    }
+
+    uint32_t mutableNodeIndex = ensureNodeIsMutable(nodeIndex);
+    SVDAGGPUNode& node = nodeAt(mutableNodeIndex);
+
+    for (uint32_t octant = 0; octant < 8; ++octant) {
+        Box childNodeBox = getChildBox(nodeBox, octant);
+
+        if (!boxesIntersect(targetBox, childNodeBox)) {
+            continue;
+        }
+
+        uint32_t childBit = 1u << octant;
+        uint32_t oldChildIndex = 0;
+
+        if ((node.childMask & childBit) == 0) {
+            SVDAGGPUNode newNode = {};
+            newNode.refs = 1;
+            uint32_t newChildIndex = allocateNode(newNode);
+
+            node.children[octant] = newChildIndex;
+            node.childMask |= childBit;
+            oldChildIndex = newChildIndex;
+        }
+        else {
+            oldChildIndex = node.children[octant];
+        }
+
+        glm::uvec3 childSource = childNodeBox.min - targetBox.min + clipboard.box.min;
+        PasteWindow childWindow = pasteWindow(window, childSource, currentDepth + 1);
+        uint32_t newChildIndex = recursivePaste(oldChildIndex, targetBox, childNodeBox, currentDepth + 1, childWindow);
+
+        if (newChildIndex != oldChildIndex) {
+            node.children[octant] = newChildIndex;
+
+            if (oldChildIndex != 0) {
+                releaseNode(oldChildIndex, currentDepth + 1);
             }
 
             if (newChildIndex == 0) {
@@ -259,6 +1424,12 @@ uint32_t SVDAGEditor::recursiveModifyRegion(uint32_t nodeIndex, const Box& targe
         }
     }
 
+    if (node.childMask == 0 && currentDepth > 0) {
+        if (mutableNodeIndex != originalNodeIndex) {
+            releaseNode(mutableNodeIndex, currentDepth);
+        }
+        return 0;
+    }
     return mutableNodeIndex;
 }
 
@@ -268,9 +1439,7 @@ uint32_t SVDAGEditor::createSolidLeafNode(uint16_t material) {
     solidNode.childMask = 0xFF;
     solidNode.material = material;
 
-    uint32_t newIndex = nodes.size();
-    nodes.push_back(solidNode);
-    return newIndex;
+    return allocateNode(solidNode);
 }
 
 bool SVDAGEditor::boxesIntersect(const Box& a, const Box& b) const {
@@ -1,22 +1,438 @@
 #include "SVDAGLoader.h"
+#include "DAGFile.h"
+#include "EditWorker.h"
+#include "SVDAGSaver.h"
+#include <algorithm>
+#include <bit>
 #include <chrono>
+#include <cstring>
+#include <execution>
 #include <fstream>
+#include <numeric>
+#include <unordered_map>
 
-void SVDAGLoader::load(std::string filePath)
+namespace {
+	// Random access to file nodes for the preview; compressed blocks are decoded on first use
+	class FileNodeReader {
+	public:
+		FileNodeReader(const uint8_t* data, const DAGFileHeader& header) : data(data), header(header) {}
+
+		bool prefetch(const std::vector<uint32_t>& indices) {
+			if (header.encoding != DAG_ENCODING_BLOCK_VARINT) return true;
+
+			std::vector<uint32_t> missing;
+			for (uint32_t index : indices) {
+				uint32_t block = index / header.blockNodeCount;
+				if (blocks.find(block) == blocks.end()) {
+					blocks[block];
+					missing.push_back(block);
+				}
+			}
+
+			std::atomic<bool> failed = false;
+			std::for_each(std::execution::par, missing.begin(), missing.end(), [&](uint32_t block) {
+				std::vector<SVDAGGPUNode>& decoded = blocks.at(block);
+				decoded.resize(header.blockNodeCount);
+				if (!decodeDAGBlock(data, header, block, decoded.data())) failed = true;
+				});
+			return !failed;
+		}
+
+		const SVDAGGPUNode& node(uint32_t index) const {
+			if (header.encoding == DAG_ENCODING_BLOCK_VARINT) {
+				return blocks.at(index / header.blockNodeCount)[index % header.blockNodeCount];
+			}
+			return reinterpret_cast<const SVDAGGPUNode*>(data + header.dataOffset)[index];
+		}
+	private:
+		const uint8_t* data;
+		const DAGFileHeader& header;
+		std::unordered_map<uint32_t, std::vector<SVDAGGPUNode>> blocks;
+	};
+}
+
+bool SVDAGLoader::load(std::string filePath, uint32_t previewLevels)
 {
-	nodes.clear();
 	auto start = std::chrono::steady_clock::now();
-	std::ifstream file(filePath, std::ios::binary);
-	cereal::BinaryInputArchive archive(file);
-	archive(*this);
+	progress.reset();
+	journalSequence = 0;
+
+	MappedFile file;
+	if (!file.open(filePath)) {
+		printf("Failed to open %s\n", filePath.c_str());
+		return false;
+	}
+	progress.bytesTotal = file.size();
+
+	bool loaded = isDAGFile(file.data(), file.size()) ? loadMapped(file, previewLevels) : loadLegacy(filePath);
+	if (!loaded) {
+		return false;
+	}
+
 	auto end = std::chrono::steady_clock::now();
-	printf("SVO loaded in %.1f seconds\n", std::chrono::duration<double>(end - start).count());
+	double seconds = std::chrono::duration<double>(end - start).count();
+	printf("SVO loaded in %.1f seconds (%.2f GB/s)\n", seconds, file.size() / seconds / 1e9);
 	printf("Size: %d^3\n", static_cast<int>(exp2(maxDepth)));
 	printf("Max refs: %u\n", maxRefs);
+	return true;
+}
+
+bool SVDAGLoader::loadMapped(const MappedFile& file, uint32_t previewLevels)
+{
+	DAGFileHeader header;
+	if (!readDAGFileHeader(file.data(), file.size(), header)) {
+		return false;
+	}
+	progress.bytesTotal = header.dataSize;
+	progress.nodesTotal = header.nodeCount;
 
+	maxDepth = header.depth;
+	maxRefs = header.maxRefs;
+	journalSequence = header.journalSequence;
+
+	if (previewLevels > 0 && header.nodeCount > 0) {
+		auto start = std::chrono::steady_clock::now();
+		buildPreview(file.data(), header, previewLevels);
+		if (!previewNodes.empty()) {
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("Preview of %u levels (%zu nodes) ready in %.3f seconds\n", progress.previewLevels.load(), previewNodes.size(), seconds);
+			progress.previewReady = true;
+		}
+	}
+
+	nodes.clear();
+	nodes.resize(header.nodeCount);
+
+	auto start = std::chrono::steady_clock::now();
+	if (!streamNodes(file.data(), header)) {
+		nodes.clear();
+		return false;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (header.encoding == DAG_ENCODING_BLOCK_VARINT) {
+		printf("Decoded %u blocks in %.3f seconds (%.2f GB/s, %.2fx compression)\n", header.blockCount, seconds,
+			nodes.size() * sizeof(SVDAGGPUNode) / seconds / 1e9, static_cast<double>(nodes.size() * sizeof(SVDAGGPUNode)) / header.dataSize);
+	}
+	return true;
+}
+
+void SVDAGLoader::buildPreview(const uint8_t* data, const DAGFileHeader& header, uint32_t levels)
+{
+	previewNodes.clear();
+	if (header.depth < 2) return;
+	levels = std::min<uint32_t>(levels, header.depth - 1);
+
+	FileNodeReader reader(data, header);
+	std::unordered_map<uint32_t, uint32_t> remap = { { 0u, 0u } };
+	std::unordered_map<uint16_t, uint32_t> placeholders;
+	std::vector<uint32_t> frontier = { 0u };
+	previewNodes.push_back({});
+
+	for (uint32_t level = 0; level < levels && !frontier.empty(); level++) {
+		if (!reader.prefetch(frontier)) {
+			previewNodes.clear();
+			return;
+		}
+
+		std::vector<uint32_t> next;
+		for (uint32_t index : frontier) {
+			const SVDAGGPUNode& source = reader.node(index);
+			for (int c = 0; c < 8; c++) {
+				uint32_t child = source.children[c];
+				if (child != 0 && child < header.nodeCount && remap.find(child) == remap.end()) {
+					remap[child] = UINT32_MAX;
+					next.push_back(child);
+				}
+			}
+		}
+
+		bool truncate = level + 1 == levels;
+		if (!reader.prefetch(next)) {
+			previewNodes.clear();
+			return;
+		}
+
+		for (uint32_t child : next) {
+			if (!truncate) {
+				remap[child] = static_cast<uint32_t>(previewNodes.size());
+				previewNodes.push_back({});
+				continue;
+			}
+
+			// Collapse the subtree to solid when at least half of its octants are occupied, otherwise drop it
+			const SVDAGGPUNode& source = reader.node(child);
+			if (std::popcount(source.childMask) < 4) continue;
+
+			auto [it, inserted] = placeholders.try_emplace(source.material, static_cast<uint32_t>(previewNodes.size()));
+			if (inserted) {
+				SVDAGGPUNode solid = {};
+				solid.childMask = 0xFF;
+				solid.refs = 1;
+				solid.material = source.material;
+				previewNodes.push_back(solid);
+			}
+			remap[child] = it->second;
+		}
+
+		for (uint32_t index : frontier) {
+			SVDAGGPUNode node = reader.node(index);
+			for (int c = 0; c < 8; c++) {
+				if (node.children[c] == 0) continue;
+
+				auto it = remap.find(node.children[c]);
+				if (it == remap.end() || it->second == UINT32_MAX) {
+					node.childMask &= ~(1u << c);
+					node.children[c] = 0;
+				}
+				else {
+					node.children[c] = it->second;
+				}
+			}
+			previewNodes[remap[index]] = node;
+		}
+
+		frontier = truncate ? std::vector<uint32_t>() : std::move(next);
+	}
+
+	progress.previewLevels = levels;
+}
+
+bool SVDAGLoader::streamNodes(const uint8_t* data, const DAGFileHeader& header)
+{
+	const uint8_t* payload = data + header.dataOffset;
+	bool blockEncoded = header.encoding == DAG_ENCODING_BLOCK_VARINT;
+
+	size_t checksumBlocks = static_cast<size_t>((header.dataSize + DAG_CHECKSUM_BLOCK_SIZE - 1) / DAG_CHECKSUM_BLOCK_SIZE);
+	size_t nodeBlockSize = blockEncoded ? header.blockNodeCount : NODE_SEGMENT_SIZE;
+	size_t nodeBlocks = static_cast<size_t>((header.nodeCount + nodeBlockSize - 1) / nodeBlockSize);
+
+	// Checksum and copy/decode tasks share one parallel pass so the file is only streamed in once
+	std::vector<uint64_t> blockChecksums(checksumBlocks);
+	std::vector<size_t> tasks(checksumBlocks + nodeBlocks);
+	std::iota(tasks.begin(), tasks.end(), size_t{ 0 });
+
+	std::atomic<bool> failed = false;
+	std::for_each(std::execution::par, tasks.begin(), tasks.end(), [&](size_t task) {
+		if (task < checksumBlocks) {
+			size_t offset = task * DAG_CHECKSUM_BLOCK_SIZE;
+			size_t size = std::min<size_t>(DAG_CHECKSUM_BLOCK_SIZE, static_cast<size_t>(header.dataSize) - offset);
+			blockChecksums[task] = dagBlockChecksum(payload + offset, size);
+			progress.bytesRead += size;
+			return;
+		}
+
+		size_t block = task - checksumBlocks;
+		size_t first = block * nodeBlockSize;
+		size_t count = std::min<size_t>(nodeBlockSize, static_cast<size_t>(header.nodeCount) - first);
+		if (blockEncoded) {
+			thread_local std::vector<SVDAGGPUNode> decoded;
+			decoded.resize(count);
+			if (!decodeDAGBlock(data, header, static_cast<uint32_t>(block), decoded.data())) failed = true;
+			nodes.write(first, decoded.data(), count);
+		}
+		else {
+			nodes.write(first, reinterpret_cast<const SVDAGGPUNode*>(payload) + first, count);
+		}
+		progress.nodesLoaded += count;
+		});
+
+	if (failed) {
+		printf("DAG file contains a corrupt block\n");
+		return false;
+	}
+	if (dagChecksum(blockChecksums) != header.dataChecksum) {
+		printf("DAG file data checksum mismatch\n");
+		return false;
+	}
+	return true;
+}
+
+bool SVDAGLoader::loadLegacy(const std::string& filePath)
+{
+	size_t depth;
+	uint32_t refs;
+	std::vector<SVDAGGPUNode> loadedNodes;
+
+	try {
+		std::ifstream file(filePath, std::ios::binary);
+		cereal::BinaryInputArchive archive(file);
+		archive(depth, refs, loadedNodes);
+	}
+	catch (const std::exception& e) {
+		printf("Failed to read %s: %s\n", filePath.c_str(), e.what());
+		return false;
+	}
+
+	if (depth == 0 || depth > DAG_MAX_DEPTH) {
+		printf("Unsupported depth %zu in %s\n", depth, filePath.c_str());
+		return false;
+	}
+
+	progress.nodesTotal = loadedNodes.size();
+	progress.nodesLoaded = loadedNodes.size();
+	progress.bytesRead = progress.bytesTotal.load();
+
+	nodes.assign(loadedNodes.data(), loadedNodes.size());
+	maxDepth = depth;
+	maxRefs = refs;
+	return true;
 }
 
 void SVDAGLoader::uploadToGPU()
+{
+	previewNodes.clear();
+	previewNodes.shrink_to_fit();
+
+	createBuffers(nodes.size() + gpuHeadroom(nodes.size()));
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	for (size_t segment = 0; segment < nodes.segmentCount(); segment++) {
+		size_t first = segment * NODE_SEGMENT_SIZE;
+		size_t count = std::min<size_t>(NODE_SEGMENT_SIZE, nodes.size() - first);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(SVDAGGPUNode), count * sizeof(SVDAGGPUNode), nodes.segment(segment));
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	nodes.clearDirty();
+	updateCounter(nodes.size());
+}
+
+void SVDAGLoader::uploadPreview()
+{
+	createBuffers(previewNodes.size());
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, previewNodes.size() * sizeof(SVDAGGPUNode), previewNodes.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GLuint count = static_cast<GLuint>(previewNodes.size());
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, nodeCounter);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &count);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+	previewNodes.clear();
+	previewNodes.shrink_to_fit();
+}
+
+void SVDAGLoader::uploadDirtyNodes()
+{
+	if (nodes.size() > gpuCapacity) {
+		growGPUBuffer(nodes.size() + gpuHeadroom(nodes.size()));
+	}
+
+	{
+		GLNodeUploadSink sink(ssbo);
+		uploadPlanner.upload(nodes, sink);
+	}
+
+	nodes.clearDirty();
+	updateCounter(nodes.size());
+}
+
+void SVDAGLoader::uploadStagedNodes(const StagedNodes& staged)
+{
+	if (staged.poolSize > gpuCapacity) {
+		growGPUBuffer(staged.poolSize + gpuHeadroom(staged.poolSize));
+	}
+
+	{
+		GLNodeUploadSink sink(ssbo);
+		uploadPlanner.upload(staged, sink);
+	}
+
+	updateCounter(staged.poolSize);
+}
+
+void SVDAGLoader::resetForStreaming(size_t depth)
+{
+	previewNodes.clear();
+	previewNodes.shrink_to_fit();
+	nodes.clear();
+	nodes.allocate(SVDAGGPUNode{});
+	maxDepth = depth;
+	maxRefs = 0;
+
+	createBuffers(NODE_SEGMENT_SIZE);
+	uploadDirtyNodes();
+}
+
+bool SVDAGLoader::startCompactionIfFragmented(EditWorker& editWorker)
+{
+	if (compacting || compactionDone || nodes.freeCount() < NODE_SEGMENT_SIZE || nodes.fragmentation() < compactionThreshold) {
+		return false;
+	}
+	if (compactionWorker.joinable()) {
+		compactionWorker.join();
+	}
+
+	compacting = true;
+	compactionWorker = std::thread([this, pending = editWorker.snapshotNodes(), depth = static_cast<uint32_t>(maxDepth)]() mutable {
+		NodeSnapshot snapshot = pending.get();
+		compactionVersion = snapshot.version;
+		compactedMaxRefs = SVDAGSaver::compact(snapshot.nodes, depth, compactedNodes);
+		compactionDone = true;
+		compacting = false;
+		});
+	return true;
+}
+
+bool SVDAGLoader::finishCompaction()
+{
+	if (!compactionDone) {
+		return false;
+	}
+	compactionWorker.join();
+	compactionDone = false;
+
+	bool current = nodes.version() == compactionVersion;
+	if (current) {
+		size_t before = nodes.size();
+		replaceNodes(compactedNodes, compactedMaxRefs);
+		printf("Compacted %zu nodes to %zu\n", before, nodes.size());
+	}
+	compactedNodes.clear();
+	compactedNodes.shrink_to_fit();
+	return current;
+}
+
+void SVDAGLoader::replaceNodes(const std::vector<SVDAGGPUNode>& newNodes, uint32_t newMaxRefs)
+{
+	nodes.assign(newNodes.data(), newNodes.size());
+	maxRefs = newMaxRefs;
+	uploadToGPU();
+}
+
+size_t SVDAGLoader::gpuHeadroom(size_t count) const
+{
+	return std::max<size_t>(count / 16, NODE_SEGMENT_SIZE);
+}
+
+void SVDAGLoader::growGPUBuffer(size_t capacity)
+{
+	GLuint grown;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(SVDAGGPUNode), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, ssbo);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, gpuCapacity * sizeof(SVDAGGPUNode));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &ssbo);
+	ssbo = grown;
+	gpuCapacity = capacity;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo);
+}
+
+void SVDAGLoader::updateCounter(size_t nodeCount)
+{
+	GLuint count = static_cast<GLuint>(nodeCount);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, nodeCounter);
+	glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(GLuint), &count);
+	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+}
+
+void SVDAGLoader::createBuffers(size_t capacity)
 {
 	if (ssbo != 0) {
 		glDeleteBuffers(1, &ssbo);
@@ -27,18 +443,15 @@ void SVDAGLoader::uploadToGPU()
 		nodeCounter = 0;
 	}
 
-	size_t maxNodes =  nodes.size() * 2;
-
-	nodes.reserve(maxNodes);
-
 	glGenBuffers(1, &ssbo);
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, nodes.capacity() * sizeof(SVDAGGPUNode), nodes.data(), GL_DYNAMIC_DRAW);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(SVDAGGPUNode), nullptr, GL_DYNAMIC_DRAW);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo);
+	gpuCapacity = capacity;
 
 	glGenBuffers(1, &nodeCounter);
 	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, nodeCounter);
-	GLuint initialCount = nodes.size();
+	GLuint initialCount = 0;
 	glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), &initialCount, GL_DYNAMIC_DRAW);
 	glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 1, nodeCounter);
 	glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
@@ -54,6 +467,9 @@ GLuint SVDAGLoader::getNodeCount()
 }
 
 SVDAGLoader::~SVDAGLoader() {
+	if (compactionWorker.joinable()) {
+		compactionWorker.join();
+	}
 	if (ssbo != 0) {
 		glDeleteBuffers(1, &ssbo);
 	}
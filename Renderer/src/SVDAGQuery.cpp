@@ -0,0 +1,318 @@
+#include "SVDAGQuery.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <execution>
+#include <numeric>
+#include <random>
+
+#include "SVDAGEditor.h"
+
+namespace {
+	bool isSolid(const SVDAGGPUNode& node) {
+		return node.childMask == 0xFFu && node.children[0] == 0u;
+	}
+
+	// True if the highest set bit of a is below that of b
+	bool lowerMsb(uint32_t a, uint32_t b) {
+		return a < b && a < (a ^ b);
+	}
+
+	// Compares by the axis whose coordinates differ in the highest bit, z before y before x on a tie, which is
+	// Morton order without building the codes, so it works for every depth
+	bool mortonLess(const glm::uvec3& a, const glm::uvec3& b) {
+		uint32_t axis = 2;
+		uint32_t highest = a.z ^ b.z;
+		if (lowerMsb(highest, a.y ^ b.y)) {
+			axis = 1;
+			highest = a.y ^ b.y;
+		}
+		if (lowerMsb(highest, a.x ^ b.x)) {
+			axis = 0;
+		}
+		return a[axis] < b[axis];
+	}
+
+	const glm::uvec3& pointCorner(const glm::uvec3& point) {
+		return point;
+	}
+
+	const glm::uvec3& boxCorner(const Box& box) {
+		return box.min;
+	}
+
+	bool boxesIntersect(const Box& a, const Box& b) {
+		return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::greaterThanEqual(a.max, b.min));
+	}
+
+	Box childBox(const Box& parent, uint32_t octant) {
+		glm::uvec3 half = (parent.max - parent.min + 1u) / 2u;
+		glm::uvec3 offset((octant & 1) ? half.x : 0, (octant & 2) ? half.y : 0, (octant & 4) ? half.z : 0);
+		return { parent.min + offset, parent.min + offset + half - 1u };
+	}
+
+	template <typename Function>
+	double millionsPerSecond(size_t count, const Function& run) {
+		auto start = std::chrono::high_resolution_clock::now();
+		run();
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return count / std::max(elapsed.count(), 1e-9) / 1e6;
+	}
+}
+
+SVDAGQuery::SVDAGQuery(const NodePool& nodes, uint32_t depth)
+	: nodes(nodes), maxDepth(std::min(depth, MAX_TREE_DEPTH))
+{
+}
+
+uint32_t SVDAGQuery::octantAt(const glm::uvec3& voxel, uint32_t depth) const
+{
+	uint32_t shift = maxDepth - 1 - depth;
+	return ((voxel.x >> shift) & 1) | (((voxel.y >> shift) & 1) << 1) | (((voxel.z >> shift) & 1) << 2);
+}
+
+// Levels from the root down on which both voxels take the same octant
+uint32_t SVDAGQuery::sharedLevels(const glm::uvec3& a, const glm::uvec3& b) const
+{
+	uint32_t difference = (a.x ^ b.x) | (a.y ^ b.y) | (a.z ^ b.z);
+	return difference == 0 ? maxDepth : maxDepth - 1 - (31 - std::countl_zero(difference));
+}
+
+template <typename Key>
+std::vector<uint32_t> SVDAGQuery::mortonOrder(const std::vector<Key>& queries, const glm::uvec3& (*corner)(const Key&)) const
+{
+	std::vector<uint32_t> order(queries.size());
+	if (maxDepth > MAX_MORTON_DEPTH) {
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(std::execution::par, order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return mortonLess(corner(queries[a]), corner(queries[b]));
+			});
+		return order;
+	}
+
+	// Codes are built once and radix sorted with their query, 11 bits per pass over the 3 * depth bits in use
+	std::vector<std::pair<uint64_t, uint32_t>> codes(queries.size()), sorted(queries.size());
+	for (size_t i = 0; i < queries.size(); i++) {
+		codes[i] = { SVDAGEditor::mortonEncode(corner(queries[i])), static_cast<uint32_t>(i) };
+	}
+	constexpr uint32_t RADIX_BITS = 11;
+	for (uint32_t shift = 0; shift < 3 * maxDepth; shift += RADIX_BITS) {
+		std::vector<size_t> offsets((size_t(1) << RADIX_BITS) + 1, 0);
+		for (const auto& code : codes) {
+			offsets[((code.first >> shift) & ((1u << RADIX_BITS) - 1)) + 1]++;
+		}
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+		for (const auto& code : codes) {
+			sorted[offsets[(code.first >> shift) & ((1u << RADIX_BITS) - 1)]++] = code;
+		}
+		std::swap(codes, sorted);
+	}
+	for (size_t i = 0; i < codes.size(); i++) {
+		order[i] = codes[i].second;
+	}
+	return order;
+}
+
+template <typename Run>
+void SVDAGQuery::forEachChunk(size_t count, const Run& run) const
+{
+	std::vector<size_t> chunks((count + chunkSize - 1) / chunkSize);
+	std::iota(chunks.begin(), chunks.end(), size_t(0));
+	std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk) {
+		size_t first = chunk * chunkSize;
+		run(first, std::min(chunkSize, count - first));
+		});
+}
+
+void SVDAGQuery::queryPoints(const std::vector<glm::uvec3>& points, std::vector<PointQueryResult>& results) const
+{
+	results.resize(points.size());
+	std::vector<uint32_t> order = mortonOrder(points, &pointCorner);
+	forEachChunk(points.size(), [&](size_t first, size_t count) {
+		runPoints(points, order.data() + first, count, results.data());
+		});
+}
+
+void SVDAGQuery::queryBoxes(const std::vector<Box>& boxes, std::vector<BoxQueryResult>& results) const
+{
+	results.resize(boxes.size());
+	std::vector<uint32_t> order = mortonOrder(boxes, &boxCorner);
+	forEachChunk(boxes.size(), [&](size_t first, size_t count) {
+		runBoxes(boxes, order.data() + first, count, results.data());
+		});
+}
+
+// path[level] holds the node the previous walk passed through on that level. An answer that depends only on
+// the first `settled` levels is reused as long as the next point agrees with the previous one on all of them
+void SVDAGQuery::runPoints(const std::vector<glm::uvec3>& points, const uint32_t* order, size_t count, PointQueryResult* results) const
+{
+	uint32_t path[MAX_TREE_DEPTH + 1] = {};
+	uint32_t pathLevels = 0;
+	uint32_t settled = UINT32_MAX;
+	PointQueryResult previous = {};
+	glm::uvec3 previousPoint(0);
+	uint32_t resolution = 1u << maxDepth;
+
+	for (size_t i = 0; i < count; i++) {
+		const glm::uvec3& point = points[order[i]];
+		if (glm::any(glm::greaterThanEqual(point, glm::uvec3(resolution)))) {
+			results[order[i]] = {};
+			continue;
+		}
+
+		uint32_t shared = sharedLevels(point, previousPoint);
+		if (settled != UINT32_MAX && shared >= settled) {
+			results[order[i]] = previous;
+			previousPoint = point;
+			continue;
+		}
+
+		PointQueryResult result = {};
+		uint32_t level = std::min(shared, pathLevels);
+		while (true) {
+			const SVDAGGPUNode& node = nodes[path[level]];
+			if (isSolid(node)) {
+				result = { true, node.material };
+				settled = level;
+				break;
+			}
+			uint32_t octant = octantAt(point, level);
+			if ((node.childMask & (1u << octant)) == 0 || (level < maxDepth - 1 && node.children[octant] == 0)) {
+				settled = level + 1;
+				break;
+			}
+			if (level == maxDepth - 1) {
+				result = { true, node.material };
+				settled = maxDepth;
+				break;
+			}
+			path[++level] = node.children[octant];
+		}
+
+		pathLevels = level;
+		previous = result;
+		previousPoint = point;
+		results[order[i]] = result;
+	}
+}
+
+// Each box first walks down to the smallest node holding all of it, starting from the deepest node it shares
+// with the box before it, and is then answered from that node's subtree
+void SVDAGQuery::runBoxes(const std::vector<Box>& boxes, const uint32_t* order, size_t count, BoxQueryResult* results) const
+{
+	uint32_t path[MAX_TREE_DEPTH + 1] = {};
+	uint32_t pathLevels = 0;
+	glm::uvec3 previousCorner(0);
+	uint32_t resolution = 1u << maxDepth;
+
+	for (size_t i = 0; i < count; i++) {
+		Box box = { glm::min(boxes[order[i]].min, boxes[order[i]].max), glm::max(boxes[order[i]].min, boxes[order[i]].max) };
+		if (glm::any(glm::greaterThanEqual(box.min, glm::uvec3(resolution)))) {
+			results[order[i]] = {};
+			continue;
+		}
+		box.max = glm::min(box.max, glm::uvec3(resolution - 1));
+
+		uint32_t container = std::min(sharedLevels(box.min, box.max), maxDepth - 1);
+		uint32_t level = std::min({ sharedLevels(box.min, previousCorner), pathLevels, container });
+		previousCorner = box.min;
+
+		BoxQueryResult result = { false, true };
+		bool answered = false;
+		while (level < container) {
+			const SVDAGGPUNode& node = nodes[path[level]];
+			if (isSolid(node)) {
+				result = { true, true };
+				answered = true;
+				break;
+			}
+			uint32_t octant = octantAt(box.min, level);
+			if ((node.childMask & (1u << octant)) == 0 || node.children[octant] == 0) {
+				result = { false, false };
+				answered = true;
+				break;
+			}
+			path[++level] = node.children[octant];
+		}
+		pathLevels = level;
+
+		if (!answered) {
+			uint32_t size = 1u << (maxDepth - container);
+			glm::uvec3 nodeMin = box.min & glm::uvec3(~(size - 1));
+			evaluateBox(path[container], { nodeMin, nodeMin + (size - 1) }, container, box, result);
+		}
+		results[order[i]] = result;
+	}
+}
+
+// Stops as soon as the box is known to be partly solid
+void SVDAGQuery::evaluateBox(uint32_t nodeIndex, const Box& nodeBox, uint32_t depth, const Box& box, BoxQueryResult& result) const
+{
+	const SVDAGGPUNode& node = nodes[nodeIndex];
+	if (isSolid(node)) {
+		result.anySolid = true;
+		return;
+	}
+
+	for (uint32_t octant = 0; octant < 8; octant++) {
+		Box child = childBox(nodeBox, octant);
+		if (!boxesIntersect(box, child)) continue;
+
+		if ((node.childMask & (1u << octant)) == 0) {
+			result.allSolid = false;
+		}
+		else if (depth == maxDepth - 1) {
+			result.anySolid = true;
+		}
+		else if (node.children[octant] == 0) {
+			result.allSolid = false;
+		}
+		else {
+			evaluateBox(node.children[octant], child, depth + 1, box, result);
+		}
+
+		if (result.anySolid && !result.allSolid) return;
+	}
+}
+
+QueryBenchmark SVDAGQuery::benchmark(size_t queryCount, uint32_t seed) const
+{
+	std::mt19937 random(seed);
+	uint32_t resolution = 1u << maxDepth;
+	std::uniform_int_distribution<uint32_t> coordinate(0, resolution - 1);
+
+	std::vector<glm::uvec3> randomPoints(queryCount);
+	for (glm::uvec3& point : randomPoints) {
+		point = glm::uvec3(coordinate(random), coordinate(random), coordinate(random));
+	}
+
+	// Clusters of 4096 points within 32 voxels of a center, like the probes of nearby objects in one tick
+	std::vector<glm::uvec3> coherentPoints(queryCount);
+	std::uniform_int_distribution<uint32_t> offset(0, std::min(resolution, 32u) - 1);
+	glm::uvec3 center(0);
+	for (size_t i = 0; i < queryCount; i++) {
+		if (i % 4096 == 0) {
+			center = glm::uvec3(coordinate(random), coordinate(random), coordinate(random));
+		}
+		coherentPoints[i] = glm::min(center + glm::uvec3(offset(random), offset(random), offset(random)), glm::uvec3(resolution - 1));
+	}
+
+	std::vector<Box> boxes(queryCount / 4);
+	for (Box& box : boxes) {
+		glm::uvec3 corner(coordinate(random), coordinate(random), coordinate(random));
+		box = { corner, corner + glm::uvec3(offset(random), offset(random), offset(random)) / 4u };
+	}
+
+	QueryBenchmark result = {};
+	std::vector<PointQueryResult> pointResults;
+	std::vector<BoxQueryResult> boxResults;
+	result.randomPoints = millionsPerSecond(queryCount, [&] { queryPoints(randomPoints, pointResults); });
+	result.coherentPoints = millionsPerSecond(queryCount, [&] { queryPoints(coherentPoints, pointResults); });
+
+	SVDAGQuery serial(nodes, maxDepth);
+	serial.setChunkSize(queryCount);
+	result.coherentPointsOneThread = millionsPerSecond(queryCount, [&] { serial.queryPoints(coherentPoints, pointResults); });
+	result.boxes = millionsPerSecond(boxes.size(), [&] { queryBoxes(boxes, boxResults); });
+	return result;
+}
@@ -0,0 +1,151 @@
+#include "SVDAGSaver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+#include "DAGFile.h"
+
+namespace {
+	constexpr uint32_t NO_NODE = UINT32_MAX;
+
+	// Children of unique nodes are stored as unique index + 1 so that 0 keeps meaning "no child"
+	class DAGCompactor
+	{
+	public:
+		DAGCompactor(const std::vector<SVDAGGPUNode>& nodes, uint32_t depth)
+			: nodes(nodes), maxDepth(depth), canonical(nodes.size(), NO_NODE), canonicalDepth(nodes.size(), 0) {}
+
+		uint32_t compact(std::vector<SVDAGGPUNode>& outNodes) {
+			uint32_t root = nodes.empty() ? NO_NODE : canonicalize(0, 0);
+
+			outNodes.clear();
+			outNodes.push_back(root == NO_NODE ? SVDAGGPUNode{} : unique[root]);
+			outNodes[0].refs = 1;
+			if (root == NO_NODE) return 1;
+
+			layout.assign(unique.size(), NO_NODE);
+			layout[root] = 0;
+			maxRefs = 1;
+			layoutChildren(root, 0, outNodes);
+			return maxRefs;
+		}
+	private:
+		const std::vector<SVDAGGPUNode>& nodes;
+		uint32_t maxDepth;
+		std::vector<uint32_t> canonical;
+		std::vector<uint8_t> canonicalDepth;
+		std::vector<SVDAGGPUNode> unique;
+		std::unordered_map<NodeKey, uint32_t, NodeKeyHash> lookup;
+		std::vector<uint32_t> layout;
+		uint32_t maxRefs = 1;
+
+		// Post-order hash-consing; empty subtrees collapse to NO_NODE so their parents drop the child bit
+		uint32_t canonicalize(uint32_t index, uint32_t depth) {
+			if (canonical[index] != NO_NODE && canonicalDepth[index] == depth) {
+				return canonical[index];
+			}
+
+			const SVDAGGPUNode& node = nodes[index];
+			NodeKey key = { depth, node.childMask, node.material, {} };
+			bool solid = node.childMask == 0xFFu && node.children[0] == 0u;
+			if (!solid && depth + 1 < maxDepth) {
+				for (int c = 0; c < 8; c++) {
+					if ((node.childMask & (1u << c)) == 0) continue;
+
+					uint32_t child = node.children[c] == 0 ? NO_NODE : canonicalize(node.children[c], depth + 1);
+					if (child == NO_NODE) {
+						key.childMask &= ~(1u << c);
+					}
+					else {
+						key.children[c] = child + 1;
+					}
+				}
+			}
+
+			uint32_t result = NO_NODE;
+			if (key.childMask != 0 || depth == 0) {
+				auto [it, inserted] = lookup.try_emplace(key, static_cast<uint32_t>(unique.size()));
+				if (inserted) {
+					SVDAGGPUNode uniqueNode = {};
+					uniqueNode.childMask = key.childMask;
+					uniqueNode.material = key.material;
+					std::copy(key.children, key.children + 8, uniqueNode.children);
+					unique.push_back(uniqueNode);
+				}
+				result = it->second;
+			}
+
+			if (canonical[index] == NO_NODE) {
+				canonical[index] = result;
+				canonicalDepth[index] = static_cast<uint8_t>(depth);
+			}
+			return result;
+		}
+
+		// Depth-first pre-order, the same order SVDAGBuilder::linearize produces
+		void layoutChildren(uint32_t uniqueIndex, uint32_t outIndex, std::vector<SVDAGGPUNode>& outNodes) {
+			for (int c = 0; c < 8; c++) {
+				uint32_t child = unique[uniqueIndex].children[c];
+				if (child == 0) continue;
+				child--;
+
+				if (layout[child] == NO_NODE) {
+					layout[child] = static_cast<uint32_t>(outNodes.size());
+					outNodes.push_back(unique[child]);
+					outNodes.back().refs = 0;
+					layoutChildren(child, layout[child], outNodes);
+				}
+
+				SVDAGGPUNode& childNode = outNodes[layout[child]];
+				childNode.refs++;
+				maxRefs = std::max(maxRefs, childNode.refs);
+				outNodes[outIndex].children[c] = layout[child];
+			}
+		}
+	};
+}
+
+SVDAGSaver::~SVDAGSaver()
+{
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+bool SVDAGSaver::save(std::future<NodeSnapshot> snapshot, uint32_t depth, const std::string& path, uint64_t journalSequence)
+{
+	if (saving) {
+		printf("A save is already in progress\n");
+		return false;
+	}
+	if (worker.joinable()) {
+		worker.join();
+	}
+
+	saving = true;
+	succeeded = false;
+	worker = std::thread([this, pending = std::move(snapshot), depth, path, journalSequence]() mutable {
+		NodeSnapshot snapshot = pending.get();
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::vector<SVDAGGPUNode> compacted;
+		uint32_t maxRefs = compact(snapshot.nodes, depth, compacted);
+		bool ok = writeDAGFile(path, depth, maxRefs, compacted, journalSequence);
+
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (ok) {
+			printf("Saved %s: %zu nodes compacted to %zu in %.2f seconds\n", path.c_str(), snapshot.nodes.size(), compacted.size(), elapsed.count());
+		}
+		succeeded = ok;
+		saving = false;
+		});
+	return true;
+}
+
+uint32_t SVDAGSaver::compact(const std::vector<SVDAGGPUNode>& nodes, uint32_t depth, std::vector<SVDAGGPUNode>& outNodes)
+{
+	DAGCompactor compactor(nodes, depth);
+	return compactor.compact(outNodes);
+}
@@ -0,0 +1,217 @@
+#include "SVDAGStatistics.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <utility>
+
+namespace {
+	bool isSolid(const SVDAGGPUNode& node) {
+		return node.childMask == 0xFFu && node.children[0] == 0u;
+	}
+
+	uint64_t saturatingAdd(uint64_t a, uint64_t b) {
+		return a > std::numeric_limits<uint64_t>::max() - b ? std::numeric_limits<uint64_t>::max() : a + b;
+	}
+
+	bool boxContains(const Box& container, const Box& content) {
+		return glm::all(glm::lessThanEqual(container.min, content.min)) && glm::all(glm::greaterThanEqual(container.max, content.max));
+	}
+
+	bool boxesIntersect(const Box& a, const Box& b) {
+		return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::greaterThanEqual(a.max, b.min));
+	}
+
+	Box childBox(const Box& parent, uint32_t octant) {
+		glm::uvec3 half = (parent.max - parent.min + 1u) / 2u;
+		glm::uvec3 offset((octant & 1) ? half.x : 0, (octant & 2) ? half.y : 0, (octant & 4) ? half.z : 0);
+		return { parent.min + offset, parent.min + offset + half - 1u };
+	}
+}
+
+// Entries stay sorted, so the last one is the first to give way to a larger material
+void MaterialHistogram::add(uint16_t material, uint64_t voxels)
+{
+	if (voxels == 0) return;
+
+	uint32_t i = 0;
+	while (i < entryCount && entries[i].material != material) {
+		i++;
+	}
+	if (i < entryCount) {
+		entries[i].voxels = saturatingAdd(entries[i].voxels, voxels);
+	}
+	else if (entryCount < MATERIAL_HISTOGRAM_SIZE) {
+		entries[entryCount++] = { material, voxels };
+	}
+	else if (voxels > entries[entryCount - 1].voxels) {
+		i = entryCount - 1;
+		otherVoxels = saturatingAdd(otherVoxels, entries[i].voxels);
+		entries[i] = { material, voxels };
+	}
+	else {
+		otherVoxels = saturatingAdd(otherVoxels, voxels);
+		return;
+	}
+
+	while (i > 0 && entries[i].voxels > entries[i - 1].voxels) {
+		std::swap(entries[i], entries[i - 1]);
+		i--;
+	}
+}
+
+void MaterialHistogram::merge(const MaterialHistogram& other)
+{
+	for (uint32_t i = 0; i < other.entryCount; i++) {
+		add(other.entries[i].material, other.entries[i].voxels);
+	}
+	otherVoxels = saturatingAdd(otherVoxels, other.otherVoxels);
+}
+
+SVDAGStatistics::SVDAGStatistics(const NodePool& nodes, uint32_t depth, bool trackMaterials)
+	: nodes(nodes), maxDepth(depth), trackMaterials(trackMaterials)
+{
+}
+
+void SVDAGStatistics::clearCache()
+{
+	cache = {};
+}
+
+RegionStatistics SVDAGStatistics::world()
+{
+	RegionStatistics result;
+	if (nodes.empty() || maxDepth == 0) {
+		return result;
+	}
+	addNode(0, 0, result);
+	return result;
+}
+
+RegionStatistics SVDAGStatistics::region(const Box& box)
+{
+	RegionStatistics result;
+	uint32_t resolution = 1u << maxDepth;
+	Box clamped = { glm::min(box.min, box.max), glm::max(box.min, box.max) };
+	if (nodes.empty() || maxDepth == 0 || glm::any(glm::greaterThanEqual(clamped.min, glm::uvec3(resolution)))) {
+		return result;
+	}
+	clamped.max = glm::min(clamped.max, glm::uvec3(resolution - 1));
+
+	addRegion(0, { glm::uvec3(0), glm::uvec3(resolution - 1) }, 0, clamped, result);
+	return result;
+}
+
+uint64_t SVDAGStatistics::solidVoxels(uint32_t depth) const
+{
+	uint32_t bits = 3 * (maxDepth - depth);
+	return bits >= 64 ? std::numeric_limits<uint64_t>::max() : uint64_t(1) << bits;
+}
+
+void SVDAGStatistics::addSolid(uint16_t material, uint64_t voxels, RegionStatistics& result) const
+{
+	result.voxels = saturatingAdd(result.voxels, voxels);
+	if (trackMaterials) {
+		result.materials.add(material, voxels);
+	}
+}
+
+void SVDAGStatistics::addNode(uint32_t nodeIndex, uint32_t depth, RegionStatistics& result)
+{
+	const SVDAGGPUNode& node = nodes[nodeIndex];
+	if (isSolid(node)) {
+		addSolid(node.material, solidVoxels(depth), result);
+	}
+	else if (node.childMask == 0) {
+		return;
+	}
+	else if (depth == maxDepth - 1) {
+		addSolid(node.material, std::popcount(node.childMask & 0xFFu), result);
+	}
+	else {
+		addCached(cachedTotals(nodeIndex, depth), result);
+	}
+}
+
+void SVDAGStatistics::addCached(const CachedTotals& totals, RegionStatistics& result) const
+{
+	result.voxels = saturatingAdd(result.voxels, totals.voxels);
+	if (!trackMaterials) {
+		return;
+	}
+
+	uint64_t listed = 0;
+	for (uint32_t i = 0; i < totals.materialCount; i++) {
+		uint64_t voxels = uint64_t(totals.materialVoxels[i]) << totals.shift;
+		result.materials.add(totals.materials[i], voxels);
+		listed += voxels;
+	}
+	result.materials.otherVoxels = saturatingAdd(result.materials.otherVoxels, totals.voxels - std::min(listed, totals.voxels));
+}
+
+// Solid nodes are shared across levels, so their totals depend on where they are and are never cached. Entries
+// keep their address while the children below insert theirs
+const SVDAGStatistics::CachedTotals& SVDAGStatistics::cachedTotals(uint32_t nodeIndex, uint32_t depth)
+{
+	auto [cached, inserted] = cache.try_emplace(nodeIndex);
+	CachedTotals& totals = cached->second;
+	if (!inserted && totals.version >= nodes.pageVersion(nodeIndex)) {
+		return totals;
+	}
+
+	const SVDAGGPUNode& node = nodes[nodeIndex];
+	RegionStatistics sum;
+	for (uint32_t octant = 0; octant < 8; octant++) {
+		if ((node.childMask & (1u << octant)) != 0 && node.children[octant] != 0) {
+			addNode(node.children[octant], depth + 1, sum);
+		}
+	}
+
+	totals = {};
+	totals.version = nodes.version();
+	totals.voxels = sum.voxels;
+	if (trackMaterials) {
+		const MaterialHistogram& materials = sum.materials;
+		uint64_t largest = materials.entryCount > 0 ? materials.entries[0].voxels : 0;
+		while ((largest >> totals.shift) > std::numeric_limits<uint32_t>::max()) {
+			totals.shift++;
+		}
+		for (uint32_t i = 0; i < materials.entryCount; i++) {
+			totals.materials[i] = materials.entries[i].material;
+			totals.materialVoxels[i] = static_cast<uint32_t>(materials.entries[i].voxels >> totals.shift);
+		}
+		totals.materialCount = static_cast<uint8_t>(materials.entryCount);
+	}
+	return totals;
+}
+
+void SVDAGStatistics::addRegion(uint32_t nodeIndex, const Box& nodeBox, uint32_t depth, const Box& box, RegionStatistics& result)
+{
+	const SVDAGGPUNode& node = nodes[nodeIndex];
+	if (node.childMask == 0) {
+		return;
+	}
+	if (boxContains(box, nodeBox)) {
+		addNode(nodeIndex, depth, result);
+		return;
+	}
+	if (isSolid(node)) {
+		glm::uvec3 overlap = glm::min(box.max, nodeBox.max) - glm::max(box.min, nodeBox.min) + 1u;
+		addSolid(node.material, uint64_t(overlap.x) * overlap.y * overlap.z, result);
+		return;
+	}
+
+	for (uint32_t octant = 0; octant < 8; octant++) {
+		if ((node.childMask & (1u << octant)) == 0) continue;
+
+		Box child = childBox(nodeBox, octant);
+		if (!boxesIntersect(box, child)) continue;
+
+		if (depth == maxDepth - 1) {
+			addSolid(node.material, 1, result);
+		}
+		else if (node.children[octant] != 0) {
+			addRegion(node.children[octant], child, depth + 1, box, result);
+		}
+	}
+}
@@ -0,0 +1,392 @@
+#include "TileStreamer.h"
+
+#include <algorithm>
+
+#include "MappedFile.h"
+
+namespace {
+	uint64_t cellKey(const glm::uvec3& tile) {
+		return (uint64_t(tile.z) << 42) | (uint64_t(tile.y) << 21) | tile.x;
+	}
+}
+
+TileStreamer::TileStreamer(std::shared_ptr<TiledWorld> world, size_t memoryBudget, uint32_t workerCount)
+	: world(world), memoryBudget(memoryBudget)
+{
+	slots.resize(world->getTiles().size());
+	for (uint32_t i = 0; i < std::max(workerCount, 1u); i++) {
+		workers.emplace_back(&TileStreamer::workerLoop, this);
+	}
+}
+
+TileStreamer::~TileStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void TileStreamer::update(const glm::vec3& cameraPosition, const glm::vec3& cameraVelocity)
+{
+	const std::vector<DAGWorldTile>& tiles = world->getTiles();
+	float gridResolution = static_cast<float>(world->getGridResolution());
+	glm::vec3 current = cameraPosition * gridResolution;
+	glm::vec3 predicted = (cameraPosition + cameraVelocity * lookahead) * gridResolution;
+
+	std::vector<std::pair<float, uint32_t>> candidates;
+	for (uint32_t i = 0; i < tiles.size(); i++) {
+		slots[i].wanted = false;
+		if ((tiles[i].flags & DAG_TILE_EMPTY) || slots[i].state == TILE_FAILED) continue;
+
+		glm::vec3 center = glm::vec3(tiles[i].x, tiles[i].y, tiles[i].z) + 0.5f;
+		float distance = std::min(glm::distance(center, current), glm::distance(center, predicted));
+		if (slots[i].pinned) {
+			distance = -1.0f;
+		}
+		if (distance <= loadRadius) {
+			candidates.push_back({ distance, i });
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	size_t budgetUsed = 0;
+	for (auto [distance, tile] : candidates) {
+		size_t bytes = tiles[tile].nodeCount * sizeof(SVDAGGPUNode);
+		if (!slots[tile].pinned && budgetUsed + bytes > memoryBudget) break;
+		budgetUsed += bytes;
+		slots[tile].wanted = true;
+	}
+
+	for (TileSlot& slot : slots) {
+		if (slot.state == TILE_RESIDENT && !slot.wanted && !slot.pinned) {
+			evictedRanges.push_back({ slot.first, slot.count });
+			slot = TileSlot();
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(queueMutex);
+	requests.clear();
+	for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+		uint32_t tile = it->second;
+		if (slots[tile].wanted && slots[tile].state != TILE_RESIDENT && !inFlight.contains(tile)) {
+			slots[tile].state = TILE_REQUESTED;
+			requests.push_back(tile);
+		}
+	}
+	for (uint32_t i = 0; i < slots.size(); i++) {
+		if (slots[i].state == TILE_REQUESTED && !slots[i].wanted && !inFlight.contains(i)) {
+			slots[i].state = TILE_UNLOADED;
+		}
+	}
+	queueCondition.notify_all();
+}
+
+bool TileStreamer::compose(NodePool& nodes)
+{
+	if (nodes.empty()) {
+		nodes.allocate(SVDAGGPUNode{});
+	}
+
+	std::vector<LoadedTile> loaded;
+	std::vector<uint32_t> failedTiles;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		loaded.swap(finished);
+		failedTiles.swap(failed);
+	}
+
+	for (uint32_t tile : failedTiles) {
+		slots[tile].state = TILE_FAILED;
+	}
+
+	if (evictedRanges.empty() && loaded.empty() && !topDirty) {
+		return false;
+	}
+
+	refreshTileRoots(nodes);
+
+	for (auto [first, count] : evictedRanges) {
+		freeRange(first, count);
+		residentBytes -= count * sizeof(SVDAGGPUNode);
+		residentTiles--;
+		topDirty = true;
+	}
+	evictedRanges.clear();
+
+	for (LoadedTile& tile : loaded) {
+		TileSlot& slot = slots[tile.tile];
+		if (!slot.wanted || slot.state != TILE_REQUESTED) {
+			if (slot.state == TILE_REQUESTED) slot.state = TILE_UNLOADED;
+			continue;
+		}
+
+		uint32_t count = static_cast<uint32_t>(tile.nodes.size());
+		uint32_t first = allocateRange(nodes, count);
+		for (SVDAGGPUNode& node : tile.nodes) {
+			for (int c = 0; c < 8; c++) {
+				if (node.children[c] != 0) node.children[c] += first;
+			}
+		}
+		nodes.write(first, tile.nodes.data(), count);
+		nodes.markDirtyRange(first, count);
+
+		slot.state = TILE_RESIDENT;
+		slot.root = first;
+		slot.first = first;
+		slot.count = count;
+		residentBytes += count * sizeof(SVDAGGPUNode);
+		residentTiles++;
+		topDirty = true;
+	}
+
+	if (!topDirty) {
+		return false;
+	}
+
+	rebuildTopLevel(nodes);
+	topDirty = false;
+	return true;
+}
+
+bool TileStreamer::isResident(const glm::uvec3& voxelMin, const glm::uvec3& voxelMax) const
+{
+	glm::uvec3 tileMin = world->tileOf(voxelMin);
+	glm::uvec3 tileMax = world->tileOf(voxelMax);
+	for (uint32_t z = tileMin.z; z <= tileMax.z; z++) {
+		for (uint32_t y = tileMin.y; y <= tileMax.y; y++) {
+			for (uint32_t x = tileMin.x; x <= tileMax.x; x++) {
+				int tile = world->findTile(glm::uvec3(x, y, z));
+				if (!isEmptyCell(tile) && slots[tile].state != TILE_RESIDENT) return false;
+			}
+		}
+	}
+	return true;
+}
+
+void TileStreamer::pinTiles(const glm::uvec3& voxelMin, const glm::uvec3& voxelMax)
+{
+	glm::uvec3 tileMin = world->tileOf(voxelMin);
+	glm::uvec3 tileMax = world->tileOf(voxelMax);
+	for (uint32_t z = tileMin.z; z <= tileMax.z; z++) {
+		for (uint32_t y = tileMin.y; y <= tileMax.y; y++) {
+			for (uint32_t x = tileMin.x; x <= tileMax.x; x++) {
+				glm::uvec3 cell(x, y, z);
+				int tile = world->findTile(cell);
+				if (isEmptyCell(tile)) {
+					emptyCellRoots.try_emplace(cellKey(cell), 0);
+				}
+				else if (slots[tile].state == TILE_RESIDENT) {
+					slots[tile].pinned = true;
+				}
+			}
+		}
+	}
+}
+
+size_t TileStreamer::getPendingTileCount() const
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return requests.size() + inFlight.size();
+}
+
+void TileStreamer::workerLoop()
+{
+	while (true) {
+		uint32_t tile;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+			if (stopping) return;
+
+			tile = requests.back();
+			requests.pop_back();
+			inFlight.insert(tile);
+		}
+
+		LoadedTile loaded = { tile, {} };
+		std::string path = world->getTilePath(tile);
+		MappedFile file;
+		DAGFileHeader header;
+		bool ok = file.open(path) && readDAGFileNodes(file.data(), file.size(), header, loaded.nodes) &&
+			header.depth == world->getTileDepth() && !loaded.nodes.empty();
+		if (!ok) {
+			printf("Failed to load tile %s\n", path.c_str());
+		}
+
+		std::lock_guard<std::mutex> lock(queueMutex);
+		inFlight.erase(tile);
+		if (ok) {
+			finished.push_back(std::move(loaded));
+		}
+		else {
+			failed.push_back(tile);
+		}
+	}
+}
+
+uint32_t TileStreamer::allocateRange(NodePool& nodes, uint32_t count)
+{
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+		if (it->second < count) continue;
+
+		uint32_t first = it->first;
+		uint32_t remaining = it->second - count;
+		freeRanges.erase(it);
+		if (remaining > 0) {
+			freeRanges[first + count] = remaining;
+		}
+		return first;
+	}
+
+	uint32_t first = static_cast<uint32_t>(nodes.size());
+	nodes.resize(nodes.size() + count);
+	return first;
+}
+
+void TileStreamer::freeRange(uint32_t first, uint32_t count)
+{
+	auto next = freeRanges.lower_bound(first);
+	if (next != freeRanges.end() && first + count == next->first) {
+		count += next->second;
+		next = freeRanges.erase(next);
+	}
+	if (next != freeRanges.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == first) {
+			previous->second += count;
+			return;
+		}
+	}
+	freeRanges[first] = count;
+}
+
+bool TileStreamer::isEmptyCell(int tile) const
+{
+	return tile < 0 || (world->getTiles()[tile].flags & DAG_TILE_EMPTY);
+}
+
+uint32_t TileStreamer::tileRoot(const glm::uvec3& tile) const
+{
+	int index = world->findTile(tile);
+	if (isEmptyCell(index)) {
+		auto it = emptyCellRoots.find(cellKey(tile));
+		return it == emptyCellRoots.end() ? 0 : it->second;
+	}
+	if (slots[index].state != TILE_RESIDENT) return 0;
+	return slots[index].root;
+}
+
+// The root the composed tree currently holds for a cell, or UINT32_MAX if the cell lies inside a solid node
+uint32_t TileStreamer::composedRoot(const NodePool& nodes, const glm::uvec3& tile) const
+{
+	uint32_t levels = world->getTopLevels();
+	uint32_t nodeIndex = 0;
+	for (uint32_t level = 0; level < levels; level++) {
+		const SVDAGGPUNode& node = nodes[nodeIndex];
+		uint32_t shift = levels - 1 - level;
+		uint32_t octant = ((tile.x >> shift) & 1) | (((tile.y >> shift) & 1) << 1) | (((tile.z >> shift) & 1) << 2);
+
+		if (node.childMask == 0xFFu && node.children[0] == 0u) {
+			return UINT32_MAX;
+		}
+		if ((node.childMask & (1u << octant)) == 0) {
+			return 0;
+		}
+		nodeIndex = node.children[octant];
+	}
+	return nodeIndex;
+}
+
+void TileStreamer::refreshTileRoots(const NodePool& nodes)
+{
+	if (world->getTopLevels() == 0) return;
+
+	// Edits may have replaced a tile root in place of the one the top level was built with
+	const std::vector<DAGWorldTile>& tiles = world->getTiles();
+	for (uint32_t i = 0; i < slots.size(); i++) {
+		if (slots[i].state != TILE_RESIDENT) continue;
+
+		uint32_t root = composedRoot(nodes, glm::uvec3(tiles[i].x, tiles[i].y, tiles[i].z));
+		if (root != UINT32_MAX) {
+			slots[i].root = root;
+		}
+	}
+
+	for (auto& [key, root] : emptyCellRoots) {
+		glm::uvec3 cell(key & 0x1FFFFF, (key >> 21) & 0x1FFFFF, key >> 42);
+		uint32_t composed = composedRoot(nodes, cell);
+		if (composed != UINT32_MAX) {
+			root = composed;
+		}
+	}
+}
+
+void TileStreamer::rebuildTopLevel(NodePool& nodes)
+{
+	if (topCount > 0) {
+		freeRange(topFirst, topCount);
+		topCount = 0;
+	}
+
+	SVDAGGPUNode root = {};
+	std::vector<SVDAGGPUNode> topNodes;
+	std::vector<uint8_t> localMasks;
+	TopChild top = buildTopNode(nodes, glm::uvec3(0), world->getGridResolution(), topNodes, localMasks);
+
+	if (top.local) {
+		topCount = static_cast<uint32_t>(topNodes.size());
+		topFirst = allocateRange(nodes, topCount);
+		for (size_t i = 0; i < topNodes.size(); i++) {
+			for (int c = 0; c < 8; c++) {
+				if (localMasks[i] & (1 << c)) topNodes[i].children[c] += topFirst;
+			}
+		}
+		nodes.write(topFirst, topNodes.data(), topCount);
+		nodes.markDirtyRange(topFirst, topCount);
+		root = topNodes[top.index];
+	}
+	else if (top.index != 0) {
+		root = nodes[top.index];
+	}
+
+	root.refs = 1;
+	nodes[0] = root;
+	nodes.markDirty(0);
+}
+
+TileStreamer::TopChild TileStreamer::buildTopNode(const NodePool& nodes, const glm::uvec3& cell, uint32_t size, std::vector<SVDAGGPUNode>& topNodes, std::vector<uint8_t>& localMasks) const
+{
+	if (size == 1) {
+		return { tileRoot(cell), false };
+	}
+
+	SVDAGGPUNode node = {};
+	uint8_t localMask = 0;
+	uint32_t half = size / 2;
+	for (uint32_t octant = 0; octant < 8; octant++) {
+		glm::uvec3 childCell = cell + glm::uvec3(octant & 1, (octant >> 1) & 1, (octant >> 2) & 1) * half;
+		TopChild child = buildTopNode(nodes, childCell, half, topNodes, localMasks);
+		if (!child.local && child.index == 0) continue;
+
+		if (node.childMask == 0) {
+			node.material = child.local ? topNodes[child.index].material : nodes[child.index].material;
+		}
+		node.childMask |= 1u << octant;
+		node.children[octant] = child.index;
+		if (child.local) localMask |= 1u << octant;
+	}
+
+	if (node.childMask == 0) {
+		return { 0, false };
+	}
+
+	node.refs = 1;
+	topNodes.push_back(node);
+	localMasks.push_back(localMask);
+	return { static_cast<uint32_t>(topNodes.size() - 1), true };
+}
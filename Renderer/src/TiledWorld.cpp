@@ -0,0 +1,42 @@
+#include "TiledWorld.h"
+
+#include <algorithm>
+#include <bit>
+
+bool TiledWorld::open(const std::string& indexPath)
+{
+	if (!readDAGWorldIndex(indexPath, header, tiles)) {
+		return false;
+	}
+
+	size_t separator = indexPath.find_last_of("\\/");
+	directory = separator == std::string::npos ? std::string() : indexPath.substr(0, separator + 1);
+
+	uint32_t gridExtent = std::max({ header.gridSize[0], header.gridSize[1], header.gridSize[2], 1u });
+	topLevels = static_cast<uint32_t>(std::countr_zero(std::bit_ceil(gridExtent)));
+	if (getDepth() > 23) {
+		printf("World depth %u exceeds float voxel precision\n", getDepth());
+		return false;
+	}
+
+	tileLookup.clear();
+	for (uint32_t i = 0; i < tiles.size(); i++) {
+		tileLookup[tileKey(glm::uvec3(tiles[i].x, tiles[i].y, tiles[i].z))] = i;
+	}
+
+	printf("Tiled world: %u x %u x %u tiles of %u^3, %zu tiles indexed\n",
+		header.gridSize[0], header.gridSize[1], header.gridSize[2], getTileResolution(), tiles.size());
+	return true;
+}
+
+int TiledWorld::findTile(const glm::uvec3& tile) const
+{
+	auto it = tileLookup.find(tileKey(tile));
+	return it == tileLookup.end() ? -1 : static_cast<int>(it->second);
+}
+
+glm::uvec3 TiledWorld::worldToVoxel(const glm::vec3& position) const
+{
+	float resolution = static_cast<float>(1u << getDepth());
+	return glm::uvec3(glm::clamp(position * resolution, glm::vec3(0.0f), glm::vec3(resolution - 1.0f)));
+}
@@ -0,0 +1,84 @@
+#include "UploadPlanner.h"
+
+#include <algorithm>
+#include <cstring>
+
+GLNodeUploadSink::GLNodeUploadSink(GLuint buffer)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+}
+
+GLNodeUploadSink::~GLNodeUploadSink()
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GLNodeUploadSink::upload(size_t first, size_t count, const SVDAGGPUNode* nodes)
+{
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(SVDAGGPUNode), count * sizeof(SVDAGGPUNode), nodes);
+}
+
+void MemoryNodeUploadSink::upload(size_t first, size_t count, const SVDAGGPUNode* data)
+{
+	if (nodes.size() < first + count) {
+		nodes.resize(first + count);
+	}
+	std::memcpy(nodes.data() + first, data, count * sizeof(SVDAGGPUNode));
+	commands++;
+	bytes += count * sizeof(SVDAGGPUNode);
+}
+
+size_t UploadPlanner::upload(const NodePool& nodes, NodeUploadSink& sink) const
+{
+	// Runs never cross a segment, so a run and the gap before it are contiguous whenever they share one
+	size_t uploaded = 0;
+	size_t runFirst = 0, runCount = 0;
+	const SVDAGGPUNode* runData = nullptr;
+	nodes.forEachDirtyRange([&](size_t first, size_t count, const SVDAGGPUNode* data) {
+		size_t runEnd = runFirst + runCount;
+		bool sameSegment = runCount > 0 && (runFirst >> NODE_SEGMENT_SHIFT) == (first >> NODE_SEGMENT_SHIFT);
+		if (sameSegment && first - runEnd <= gapNodes) {
+			runCount = first + count - runFirst;
+			return;
+		}
+		if (runCount > 0) {
+			uploaded += emit(runFirst, runCount, runData, sink);
+		}
+		runFirst = first;
+		runCount = count;
+		runData = data;
+		});
+	if (runCount > 0) {
+		uploaded += emit(runFirst, runCount, runData, sink);
+	}
+	return uploaded;
+}
+
+size_t UploadPlanner::upload(const StagedNodes& staged, NodeUploadSink& sink) const
+{
+	size_t uploaded = 0;
+	const SVDAGGPUNode* data = staged.nodes.data();
+	size_t i = 0;
+	while (i < staged.ranges.size()) {
+		auto [first, count] = staged.ranges[i];
+		size_t next = i + 1;
+		while (next < staged.ranges.size() && staged.ranges[next].first == first + count) {
+			count += staged.ranges[next].second;
+			next++;
+		}
+
+		uploaded += emit(first, count, data, sink);
+		data += count;
+		i = next;
+	}
+	return uploaded;
+}
+
+size_t UploadPlanner::emit(size_t first, size_t count, const SVDAGGPUNode* nodes, NodeUploadSink& sink) const
+{
+	size_t chunk = std::max<size_t>(stagingBytes / sizeof(SVDAGGPUNode), 1);
+	for (size_t offset = 0; offset < count; offset += chunk) {
+		sink.upload(first + offset, std::min(chunk, count - offset), nodes + offset);
+	}
+	return count;
+}
@@ -11,11 +11,20 @@
 
 #include "Brush.h"
 #include "Camera.h"
+#include "EditJournal.h"
+#include "EditWorker.h"
 #include "GPUProgram.h"
 #include "QuadGeometry.h"
+#include "SVDAGCollider.h"
+#include "SVDAGCombiner.h"
 #include "SVDAGEditor.h"
 #include "SVDAGLoader.h"
+#include "SVDAGQuery.h"
+#include "SVDAGSaver.h"
+#include "SVDAGStatistics.h"
 #include "Texture.h"
+#include "TileStreamer.h"
+#include "TiledWorld.h"
 
 using namespace glm;
 
@@ -29,6 +38,16 @@ class VoxelApp : public GLApp {
     std::shared_ptr<Camera> camera;
     std::shared_ptr<SVDAGLoader> svdagLoader;
     std::shared_ptr<SVDAGEditor> svdagEditor;
+    std::shared_ptr<EditWorker> editWorker;
+    std::shared_ptr<TiledWorld> tiledWorld;
+    std::unique_ptr<TileStreamer> tileStreamer;
+    SVDAGSaver svdagSaver;
+    std::shared_ptr<EditJournal> editJournal;
+    std::string worldPath;
+    uint64_t checkpointSequence = 0;
+    bool checkpointPending = false;
+    size_t tileMemoryBudget = size_t(1) << 30;
+    vec3 lastCameraPosition = vec3(0.0f);
     
     std::unique_ptr<Brush> brush;
     float brushSize = 0.005f;
@@ -36,10 +55,15 @@ class VoxelApp : public GLApp {
 	BrushMode brushMode = SPHERE;
     vec3 firstCorner = vec3(-999.0f);
 	bool firstCornerSet = false;
+	vec3 brushPosition = vec3(-999.0f);
 
     std::set<int> keysPressed;
     float deltaTime, lastFrame;
     bool cameraLock = false;
+    bool cameraCollides = false;
+    vec3 cameraHalfExtents = vec3(0.002f);
+    float cameraStepHeight = 0.002f;
+    vec3 heldCameraMovement = vec3(0.0f);
     MouseButton mousePressed = NONE;
     MouseButton previousMouseButton = NONE;
     size_t worldResolution = 0;
@@ -49,11 +73,18 @@ class VoxelApp : public GLApp {
 	bool showColorPicker = false;
     bool showBrushMode = false;
     bool isWorldLoading = false;
+    bool previewShown = false;
+    uint32_t previewLevels = 8;
+    bool queriesBenchmarked = false;
+    std::unique_ptr<SVDAGStatistics> statistics;
+    RegionStatistics worldStatistics = {};
+    bool worldCounted = false;
+    int64_t lastEditVoxelChange = 0;
+    QueryBenchmark queryBenchmark = {};
     
-    bool needsUpload = false;
     bool visualizeSteps = false;
 
-	std::future<void> loadingTask;
+	std::future<bool> loadingTask;
 	std::string pendingFilePath;
 public:
     VoxelApp() : GLApp("Voxel app")
@@ -74,8 +105,10 @@ public:
         svdagLoader = std::make_shared<SVDAGLoader>();
 
         svdagEditor = std::make_shared<SVDAGEditor>(svdagLoader->getNodes(), svdagLoader->getDepth());
+        resetStatistics();
+        editWorker = std::make_shared<EditWorker>(svdagEditor, svdagLoader->getNodes());
 
-        brush = std::make_unique<Brush>(camera, svdagLoader, svdagEditor);
+        brush = std::make_unique<Brush>(camera, svdagLoader, editWorker);
 
         renderShader = std::make_unique<Shader>(GL_COMPUTE_SHADER, "shaders\\render.comp");
         renderProgram = std::make_unique<GPUProgram>(renderShader.get());
@@ -97,8 +130,15 @@ public:
 
         if (isWorldLoading && loadingTask.valid()) {
             if (loadingTask.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-                loadingTask.get();
-                finishLoading();
+                if (loadingTask.get()) {
+                    finishLoading();
+                }
+                else {
+                    isWorldLoading = false;
+                }
+            }
+            else if (!previewShown && svdagLoader->getProgress().previewReady) {
+                showPreview();
             }
 		}
 
@@ -120,16 +160,25 @@ public:
         glClearColor(0.529f, 0.808f, 0.922f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // Edits finished since the last frame go up first; the pool is only touched here while the worker is idle
+        brush->uploadChangesToGPU();
+        bool editsIdle = editWorker->isIdle();
+
+        if (tileStreamer) {
+            streamTiles(editsIdle);
+        }
+
 		BrushData brushData = brush->getBrushData();
+		brushPosition = brushData.position;
 
         if (!cameraLock) {
-            camera->move(keysPressed, deltaTime);
+            moveCamera();
 			applyBrush(brushData);
         }
         
-        if (needsUpload) {
-            brush->uploadChangesToGPU();
-            needsUpload = false;
+        if (!tileStreamer && !isWorldLoading && editWorker->isIdle()) {
+            compactNodes();
+            updateJournal();
         }
 
         renderProgram->use();
@@ -164,6 +213,18 @@ public:
         case 'r' :
 			reloadShader();
 			break;
+        case 'z':
+            if (keysPressed.count(GLFW_KEY_LEFT_CONTROL)) undo();
+            break;
+        case 'y':
+            if (keysPressed.count(GLFW_KEY_LEFT_CONTROL)) redo();
+            break;
+        case 'c':
+            if (keysPressed.count(GLFW_KEY_LEFT_CONTROL)) copySelection();
+            break;
+        case 'v':
+            if (keysPressed.count(GLFW_KEY_LEFT_CONTROL)) pasteAtBrush();
+            break;
         case GLFW_KEY_ESCAPE:
             if (cameraLock) {
                 lockMouse();
@@ -211,8 +272,17 @@ public:
     void applyBrush(BrushData brushData) {
         vec3 brushCenter = brushData.position;
 
-        if ((mousePressed == MOUSE_LEFT || mousePressed == MOUSE_RIGHT) && !isWorldLoading) {
-            if (brushCenter.x != -999.0f) {
+        // Everything painted while a button is held undoes as one step
+        bool stroking = (mousePressed == MOUSE_LEFT || mousePressed == MOUSE_RIGHT) && !isWorldLoading;
+        if (stroking && !editWorker->isInStroke()) {
+            editWorker->beginStroke();
+        }
+        else if (!stroking && editWorker->isInStroke()) {
+            editWorker->endStroke();
+        }
+
+        if (stroking) {
+            if (brushCenter.x != -999.0f && canEditAround(brushCenter, brushMode == BOX ? glm::distance(firstCorner, brushCenter) : brushSize)) {
                 bool isAdding = (mousePressed == MOUSE_LEFT);
 
                 uint16_t r = static_cast<uint16_t>(brushColor.r * 31.0f);
@@ -245,9 +315,6 @@ public:
                         }
                         break;
                 }
-                
-                brush->uploadChangesToGPU();
-                needsUpload = true;
             }
         }
     }
@@ -255,14 +322,49 @@ public:
     void showMainMenuBar() {
         if (ImGui::BeginMainMenuBar()) {
             if (ImGui::BeginMenu("File")) {
-                if (ImGui::MenuItem("Load world")) {
+                if (ImGui::MenuItem("Load world", nullptr, false, !isWorldLoading)) {
                     showFileDialog();
                 }
+                if (ImGui::MenuItem("Load tiled world", nullptr, false, !isWorldLoading)) {
+                    showTiledWorldDialog();
+                }
+                if (ImGui::MenuItem("Save world", nullptr, false, !isWorldLoading && !tileStreamer && !svdagSaver.isSaving())) {
+                    showSaveDialog();
+                }
                 if (ImGui::MenuItem("Exit")) {
                     glfwSetWindowShouldClose(this->window, GLFW_TRUE);
                 }
                 ImGui::EndMenu();
             }
+            if (ImGui::BeginMenu("Edit")) {
+                if (ImGui::MenuItem("Undo", "Ctrl+Z", false, editWorker->canUndo())) {
+                    undo();
+                }
+                if (ImGui::MenuItem("Redo", "Ctrl+Y", false, editWorker->canRedo())) {
+                    redo();
+                }
+                ImGui::Separator();
+                if (ImGui::MenuItem("Copy box selection", "Ctrl+C", false, firstCornerSet && !tileStreamer)) {
+                    copySelection();
+                }
+                if (ImGui::MenuItem("Paste at brush", "Ctrl+V", false, editWorker->hasClipboard())) {
+                    pasteAtBrush();
+                }
+                ImGui::Separator();
+                if (ImGui::BeginMenu("Combine with world", !isWorldLoading && !tileStreamer)) {
+                    if (ImGui::MenuItem("Union")) {
+                        showCombineDialog(CSG_UNION);
+                    }
+                    if (ImGui::MenuItem("Intersection")) {
+                        showCombineDialog(CSG_INTERSECTION);
+                    }
+                    if (ImGui::MenuItem("Difference")) {
+                        showCombineDialog(CSG_DIFFERENCE);
+                    }
+                    ImGui::EndMenu();
+                }
+                ImGui::EndMenu();
+            }
             if (ImGui::BeginMenu("Brush")) {
                 if (ImGui::MenuItem("Open color picker")) {
                     showColorPicker = true;
@@ -281,6 +383,10 @@ public:
                 }
                 ImGui::EndMenu();
             }
+            if (ImGui::BeginMenu("Camera")) {
+                ImGui::MenuItem("Collide with terrain", nullptr, &cameraCollides);
+                ImGui::EndMenu();
+            }
             if (ImGui::BeginMenu("Stats & Info")) {
                 if (ImGui::MenuItem("Show")) {
                     showInfo = true;
@@ -307,6 +413,27 @@ public:
         ImGui::Text("Mouse button: %s", mousePressed == MOUSE_RIGHT ? "right" : mousePressed == MOUSE_LEFT ? "left" : mousePressed == MOUSE_MIDDLE ? "middle" : "none");
         ImGui::Text("Brush size: %.5f", brushSize);
         ImGui::Text("Resolution: %zu", worldResolution);
+        if (svdagSaver.isSaving()) {
+            ImGui::Text("Saving...");
+        }
+        if (tileStreamer) {
+            ImGui::Text("Tiles: %zu resident (%.1f MB), %zu pending", tileStreamer->getResidentTileCount(),
+                tileStreamer->getResidentBytes() / (1024.0 * 1024.0), tileStreamer->getPendingTileCount());
+        }
+        if (!isWorldLoading && editWorker->isIdle()) {
+            countVoxels();
+        }
+        if (worldCounted) {
+            showVoxelCounts();
+        }
+        if (!isWorldLoading && ImGui::Button("Benchmark voxel queries")) {
+            benchmarkQueries();
+        }
+        if (queriesBenchmarked) {
+            ImGui::Text("Points: %.1f M/s random, %.1f M/s coherent (%.1f M/s on one thread)",
+                queryBenchmark.randomPoints, queryBenchmark.coherentPoints, queryBenchmark.coherentPointsOneThread);
+            ImGui::Text("Boxes: %.1f M/s", queryBenchmark.boxes);
+        }
         ImGui::End();
 	}
 
@@ -324,15 +451,19 @@ public:
     }
 
     void showLoadingWindow() {
-        ImGui::OpenPopup("Loading world");
+        const LoadProgress& progress = svdagLoader->getProgress();
 
         ImVec2 center = ImGui::GetMainViewport()->GetCenter();
         ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
 
-        if (ImGui::BeginPopupModal("Loading world", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove)) {
-			ImGui::ProgressBar(ImGui::GetTime() * -1.5f, ImVec2(0.0f, 0.0f));
-            ImGui::EndPopup();
+        ImGui::Begin("Loading world", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse);
+        ImGui::ProgressBar(progress.fraction(), ImVec2(300.0f, 0.0f));
+        ImGui::Text("%.1f / %.1f MB", progress.bytesRead / (1024.0 * 1024.0), progress.bytesTotal / (1024.0 * 1024.0));
+        ImGui::Text("%llu / %llu nodes", static_cast<unsigned long long>(progress.nodesLoaded), static_cast<unsigned long long>(progress.nodesTotal));
+        if (previewShown) {
+            ImGui::Text("Showing top %u levels, editing disabled until loaded", progress.previewLevels.load());
         }
+        ImGui::End();
     }
 
     void showFileDialog() {
@@ -349,20 +480,320 @@ public:
         }
     }
 
+    void showTiledWorldDialog() {
+        nfdu8char_t* outPath = nullptr;
+        nfdu8filteritem_t filters[1] = { { "Tiled worlds", "world" } };
+        nfdopendialogu8args_t args = { 0 };
+        args.filterList = filters;
+        args.filterCount = 1;
+        nfdresult_t result = NFD_OpenDialogU8_With(&outPath, &args);
+        if (result == NFD_OKAY) {
+            std::string path(outPath);
+            NFD_FreePathU8(outPath);
+            openTiledWorld(path);
+        }
+    }
+
+    void showCombineDialog(CSGOperation op) {
+        nfdu8char_t* outPath = nullptr;
+        nfdu8filteritem_t filters[1] = { { "SVDAG files", "dag" } };
+        nfdopendialogu8args_t args = { 0 };
+        args.filterList = filters;
+        args.filterCount = 1;
+        nfdresult_t result = NFD_OpenDialogU8_With(&outPath, &args);
+        if (result == NFD_OKAY) {
+            std::string path(outPath);
+            NFD_FreePathU8(outPath);
+            combineWithWorld(path, op);
+        }
+    }
+
+    void showSaveDialog() {
+        nfdu8char_t* outPath = nullptr;
+        nfdu8filteritem_t filters[1] = { { "SVDAG files", "dag" } };
+        nfdsavedialogu8args_t args = { 0 };
+        args.filterList = filters;
+        args.filterCount = 1;
+        nfdresult_t result = NFD_SaveDialogU8_With(&outPath, &args);
+        if (result == NFD_OKAY) {
+            std::string path(outPath);
+            NFD_FreePathU8(outPath);
+            finishEdits();
+            if (editJournal && path == worldPath) {
+                startCheckpoint();
+            }
+            else {
+                svdagSaver.save(editWorker->snapshotNodes(), svdagLoader->getDepth(), path);
+            }
+        }
+    }
+
+    void openTiledWorld(const std::string& path) {
+        auto world = std::make_shared<TiledWorld>();
+        if (!world->open(path)) {
+            return;
+        }
+
+        finishEdits();
+        closeJournal();
+        tileStreamer.reset();
+        tiledWorld = world;
+        svdagLoader->resetForStreaming(tiledWorld->getDepth());
+        tileStreamer = std::make_unique<TileStreamer>(tiledWorld, tileMemoryBudget);
+        lastCameraPosition = camera->Position();
+
+        worldResolution = static_cast<size_t>(tiledWorld->getGridResolution()) * tiledWorld->getTileResolution();
+        svdagEditor = std::make_shared<SVDAGEditor>(svdagLoader->getNodes(), svdagLoader->getDepth());
+        resetStatistics();
+        svdagEditor->setFixedLevels(tiledWorld->getTopLevels());
+        editWorker = std::make_shared<EditWorker>(svdagEditor, svdagLoader->getNodes());
+        brush = std::make_unique<Brush>(camera, svdagLoader, editWorker);
+
+        renderProgram->use();
+        renderProgram->setUniform(svdagLoader->getDepth(), "treeDepth");
+    }
+
+    // Composing writes to the pool, so it waits for a frame in which no edit is in flight
+    void streamTiles(bool editsIdle) {
+        vec3 position = camera->Position();
+        vec3 velocity = deltaTime > 0.0f ? (position - lastCameraPosition) / deltaTime : vec3(0.0f);
+        lastCameraPosition = position;
+
+        tileStreamer->update(position, velocity);
+        if (editsIdle && tileStreamer->compose(svdagLoader->getNodes())) {
+            svdagLoader->uploadDirtyNodes();
+        }
+    }
+
+    bool canEditAround(const vec3& center, float radius) {
+        if (!tileStreamer) {
+            return true;
+        }
+
+        uvec3 voxelMin = tiledWorld->worldToVoxel(center - vec3(radius));
+        uvec3 voxelMax = tiledWorld->worldToVoxel(center + vec3(radius));
+        if (!tileStreamer->isResident(voxelMin, voxelMax)) {
+            return false;
+        }
+        tileStreamer->pinTiles(voxelMin, voxelMax);
+        return true;
+    }
+
+    // Tiled worlds are left alone since the streamer owns node ranges in the pool
+    void compactNodes() {
+        if (editWorker->isInStroke()) {
+            return;
+        }
+        if (svdagLoader->finishCompaction()) {
+            svdagEditor->onNodesCompacted();
+        }
+        svdagLoader->startCompactionIfFragmented(*editWorker);
+    }
+
+    // Saves over the open world in the background; the journal keeps only what came after the snapshot
+    void startCheckpoint() {
+        checkpointSequence = editJournal->beginCheckpoint();
+        svdagEditor->markJournalBoundary();
+        checkpointPending = svdagSaver.save(editWorker->snapshotNodes(), svdagLoader->getDepth(), worldPath, checkpointSequence);
+        if (!checkpointPending) {
+            editJournal->finishCheckpoint(checkpointSequence, false);
+        }
+    }
+
+    void updateJournal() {
+        if (!editJournal) {
+            return;
+        }
+        if (checkpointPending && !svdagSaver.isSaving()) {
+            editJournal->finishCheckpoint(checkpointSequence, svdagSaver.lastSaveSucceeded());
+            checkpointPending = false;
+        }
+        editJournal->syncIfDue();
+        if (!checkpointPending && !svdagSaver.isSaving() && !editWorker->isInStroke() && editJournal->needsCheckpoint()) {
+            startCheckpoint();
+        }
+    }
+
+    // Edits since the last checkpoint are replayed on top of the loaded file before anything is uploaded. If replay
+    // stops early the journal pauses itself, and updateJournal checkpoints the replayed state on the next idle frame
+    void openJournal() {
+        editJournal = std::make_shared<EditJournal>();
+        if (!editJournal->open(worldPath + ".journal", svdagLoader->getDepth(), svdagLoader->getJournalSequence())) {
+            editJournal.reset();
+            return;
+        }
+        editJournal->replay(*svdagEditor, svdagLoader->getJournalSequence());
+        svdagEditor->setJournal(editJournal);
+    }
+
+    // A checkpoint still being written finishes in the background and is picked up on the next load
+    void closeJournal() {
+        if (editJournal && svdagEditor) {
+            svdagEditor->setJournal(nullptr);
+        }
+        editJournal.reset();
+        checkpointPending = false;
+        worldPath.clear();
+    }
+
+    void undo() {
+        if (!isWorldLoading) {
+            editWorker->undo();
+        }
+    }
+
+    void redo() {
+        if (!isWorldLoading) {
+            editWorker->redo();
+        }
+    }
+
+    // The box brush's first corner and the brush position span the copied region
+    void copySelection() {
+        if (isWorldLoading || tileStreamer || !firstCornerSet || brushPosition.x == -999.0f) {
+            return;
+        }
+        brush->copy(glm::min(firstCorner, brushPosition), glm::max(firstCorner, brushPosition));
+        firstCornerSet = false;
+        firstCorner = vec3(-999.0f);
+    }
+
+    void pasteAtBrush() {
+        if (isWorldLoading || tileStreamer || brushPosition.x == -999.0f) {
+            return;
+        }
+        brush->paste(brushPosition);
+    }
+
+    // The combined world replaces the pool the way compaction does, so history is lost. The journal cannot
+    // describe it either, which leaves it paused until the next checkpoint saves the result
+    void combineWithWorld(const std::string& path, CSGOperation op) {
+        uint32_t depth = 0;
+        std::vector<SVDAGGPUNode> other;
+        if (!SVDAGCombiner::readNodes(path, depth, other)) {
+            return;
+        }
+        if (depth != svdagLoader->getDepth()) {
+            printf("%s has depth %u, the open world %u\n", path.c_str(), depth, svdagLoader->getDepth());
+            return;
+        }
+
+        finishEdits();
+        std::vector<SVDAGGPUNode> current, combined;
+        svdagLoader->getNodes().copyTo(current);
+        uint32_t maxRefs = SVDAGCombiner::combine(current, other, depth, op, combined);
+        svdagLoader->replaceNodes(combined, maxRefs);
+        svdagEditor->onNodesCompacted();
+        if (editJournal) {
+            editJournal->invalidate();
+        }
+        printf("Combined with %s: %zu nodes\n", path.c_str(), combined.size());
+    }
+
+    // The pool belongs to the edit worker while it applies a batch, and the camera moves freely until it is done
+    // While a batch is being applied the movement is held back and swept on a later frame, between batches
+    void moveCamera() {
+        vec3 movement = camera->movement(keysPressed, deltaTime);
+        if (!cameraCollides || isWorldLoading) {
+            camera->setPosition(camera->Position() + movement);
+            heldCameraMovement = vec3(0.0f);
+            return;
+        }
+
+        heldCameraMovement += movement;
+        editWorker->readPoolBetweenBatches([&](const NodePool& nodes) {
+            SVDAGCollider collider(nodes, svdagLoader->getDepth());
+            collider.setStepHeight(cameraStepHeight);
+            collider.setMinimumFeature(0.25f);
+            CollisionBody body = { camera->Position(), cameraHalfExtents, heldCameraMovement, false };
+            collider.move(body);
+            camera->setPosition(body.center);
+            heldCameraMovement = vec3(0.0f);
+            });
+    }
+
+    void resetStatistics() {
+        statistics = std::make_unique<SVDAGStatistics>(svdagLoader->getNodes(), svdagLoader->getDepth());
+        worldCounted = false;
+        lastEditVoxelChange = 0;
+    }
+
+    // Only the paths edits copied are counted again, so this can run every frame
+    void countVoxels() {
+        RegionStatistics counted = statistics->world();
+        if (worldCounted && counted.voxels != worldStatistics.voxels) {
+            lastEditVoxelChange = static_cast<int64_t>(counted.voxels - worldStatistics.voxels);
+        }
+        worldStatistics = counted;
+        worldCounted = true;
+    }
+
+    void showVoxelCounts() {
+        ImGui::Text("Voxels: %llu", static_cast<unsigned long long>(worldStatistics.voxels));
+        if (lastEditVoxelChange != 0) {
+            ImGui::Text("Last edit: %+lld voxels", static_cast<long long>(lastEditVoxelChange));
+        }
+        const MaterialHistogram& materials = worldStatistics.materials;
+        for (uint32_t i = 0; i < materials.entryCount; i++) {
+            ImGui::Text("Material %04x: %.1f%%", materials.entries[i].material,
+                100.0 * materials.entries[i].voxels / std::max<uint64_t>(worldStatistics.voxels, 1));
+        }
+        if (firstCornerSet && brushPosition.x != -999.0f && editWorker->isIdle()) {
+            Box selection = brush->voxelBox(glm::min(firstCorner, brushPosition), glm::max(firstCorner, brushPosition));
+            ImGui::Text("Selection: %llu voxels", static_cast<unsigned long long>(statistics->region(selection).voxels));
+        }
+    }
+
+    void benchmarkQueries() {
+        finishEdits();
+        SVDAGQuery query(svdagLoader->getNodes(), svdagLoader->getDepth());
+        queryBenchmark = query.benchmark(size_t(1) << 20);
+        queriesBenchmarked = true;
+    }
+
+    // Applies and uploads everything queued before the pool is saved or replaced
+    void finishEdits() {
+        if (editWorker->isInStroke()) {
+            editWorker->endStroke();
+        }
+        editWorker->waitIdle();
+        brush->uploadChangesToGPU();
+    }
+
     void startAsyncLoading() {
+        finishEdits();
+        closeJournal();
+        tileStreamer.reset();
+        tiledWorld.reset();
         isWorldLoading = true;
+        previewShown = false;
         loadingTask = std::async(std::launch::async, [this]() {
-            svdagLoader->load(pendingFilePath);
+            return svdagLoader->load(pendingFilePath, previewLevels);
             });
     }
 
-    void finishLoading() {
-        svdagLoader->uploadToGPU();
+    void showPreview() {
+        svdagLoader->uploadPreview();
 
         worldResolution = static_cast<size_t>(powf(2.0f, svdagLoader->getDepth()));
 
+        renderProgram->use();
+        renderProgram->setUniform(svdagLoader->getDepth(), "treeDepth");
+
+        previewShown = true;
+    }
+
+    void finishLoading() {
+        worldResolution = static_cast<size_t>(powf(2.0f, svdagLoader->getDepth()));
+
         svdagEditor = std::make_shared<SVDAGEditor>(svdagLoader->getNodes(), svdagLoader->getDepth());
-        brush = std::make_unique<Brush>(camera, svdagLoader, svdagEditor);
+        resetStatistics();
+
+        worldPath = pendingFilePath;
+        openJournal();
+        editWorker = std::make_shared<EditWorker>(svdagEditor, svdagLoader->getNodes());
+        brush = std::make_unique<Brush>(camera, svdagLoader, editWorker);
+        svdagLoader->uploadToGPU();
 
         renderProgram->use();
         renderProgram->setUniform(svdagLoader->getDepth(), "treeDepth");
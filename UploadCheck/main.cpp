@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "NodePool.h"
+#include "SDFShape.h"
+#include "SVDAGEditor.h"
+#include "UploadPlanner.h"
+
+namespace {
+	struct PlanSettings {
+		size_t gapNodes;
+		size_t stagingBytes;
+	};
+
+	struct ReplayResult {
+		size_t commands = 0;
+		size_t bytes = 0;
+		size_t mismatches = 0;
+		double seconds = 0.0;
+	};
+
+	void printUsage()
+	{
+		printf("UploadCheck [options]\n");
+		printf("  --depth <levels>   depth of the edited world, 8 by default\n");
+		printf("  --edits <count>    edits replayed per plan setting, 300 by default\n");
+		printf("  --seed <value>     seed of the random edits, 1 by default\n");
+	}
+
+	// Reference counts are bookkeeping for the editor and are not uploaded when they alone change
+	bool sameOnGPU(const SVDAGGPUNode& a, const SVDAGGPUNode& b)
+	{
+		return a.childMask == b.childMask && a.material == b.material && std::equal(a.children, a.children + 8, b.children);
+	}
+
+	// Only nodes reachable from the root have to match; freed slots may change without being uploaded again
+	size_t countMismatches(const NodePool& nodes, uint32_t depth, const std::vector<SVDAGGPUNode>& mirror)
+	{
+		size_t mismatches = 0;
+		std::vector<bool> visited(nodes.size());
+		std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+		visited[0] = true;
+		while (!stack.empty()) {
+			auto [index, level] = stack.back();
+			stack.pop_back();
+
+			const SVDAGGPUNode& node = nodes[index];
+			if (index >= mirror.size() || !sameOnGPU(node, mirror[index])) {
+				mismatches++;
+			}
+			if (level + 1 >= depth || (node.childMask == 0xFF && node.children[0] == 0)) {
+				continue;
+			}
+
+			for (uint32_t child = 0; child < 8; child++) {
+				uint32_t childIndex = node.children[child];
+				if ((node.childMask & (1u << child)) && !visited[childIndex]) {
+					visited[childIndex] = true;
+					stack.push_back({ childIndex, level + 1 });
+				}
+			}
+		}
+		return mismatches;
+	}
+
+	// Edits an empty world and uploads as it goes, switching every few edits between planning from the pool's dirty
+	// pages after each edit and from staged copies the way the edit worker hands them over. Whenever nothing is
+	// left to upload, the mirror must match the pool
+	ReplayResult replay(const PlanSettings& settings, uint32_t depth, uint32_t edits, uint32_t seed)
+	{
+		NodePool nodes;
+		nodes.allocate(SVDAGGPUNode{});
+		SVDAGEditor editor(nodes, depth);
+
+		UploadPlanner planner;
+		planner.setGapTolerance(settings.gapNodes);
+		planner.setStagingBudget(settings.stagingBytes);
+
+		MemoryNodeUploadSink sink;
+		planner.upload(nodes, sink);
+		nodes.clearDirty();
+
+		ReplayResult result;
+		std::mt19937 rng(seed);
+		float resolution = static_cast<float>(1u << depth);
+		StagedNodes staged;
+		StagedNodes published;
+		for (uint32_t i = 0; i < edits; i++) {
+			glm::vec3 center(rng() % (1u << depth), rng() % (1u << depth), rng() % (1u << depth));
+			float radius = 1.0f + resolution / 32.0f * (rng() % 100) / 100.0f;
+			VoxelEditOp op = static_cast<VoxelEditOp>(rng() % 3);
+			uint16_t material = static_cast<uint16_t>(rng() % 64);
+			switch (rng() % 4) {
+			case 0:
+			case 1:
+				editor.modifyShape(SDFShape::sphere(center, radius), op, material);
+				break;
+			case 2: {
+				glm::uvec3 low(glm::max(center - radius, glm::vec3(0.0f)));
+				glm::uvec3 high(glm::min(center + radius, glm::vec3(resolution - 1.0f)));
+				editor.modifyRegion({ low, high }, op != VOXEL_CLEAR, material);
+				break;
+			}
+			case 3:
+				editor.undo();
+				break;
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			size_t commands = sink.commands;
+			if ((i / 4) % 2 == 0) {
+				planner.upload(nodes, sink);
+				nodes.clearDirty();
+			}
+			else {
+				// Batches the render loop missed are appended to the one it has not picked up yet, and the render
+				// loop only plans from the pool again once that is uploaded
+				nodes.stageDirty(staged);
+				published.ranges.insert(published.ranges.end(), staged.ranges.begin(), staged.ranges.end());
+				published.nodes.insert(published.nodes.end(), staged.nodes.begin(), staged.nodes.end());
+				published.poolSize = staged.poolSize;
+				staged.clear();
+				if (i % 4 == 3) {
+					planner.upload(published, sink);
+					published.clear();
+				}
+			}
+			std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+			result.seconds += elapsed.count();
+			result.commands += sink.commands - commands;
+
+			if (published.empty()) {
+				result.mismatches += countMismatches(nodes, depth, sink.nodes);
+			}
+		}
+		result.bytes = sink.bytes;
+		return result;
+	}
+}
+
+// UploadCheck replays random edits through the upload planner into an in-memory copy of the node buffer and
+// fails if the copy ever differs from the pool
+int main(int argc, char** argv)
+{
+	uint32_t depth = 8;
+	uint32_t edits = 300;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (i + 1 >= argc) {
+			printUsage();
+			return 1;
+		}
+
+		uint32_t value = std::strtoul(argv[i + 1], nullptr, 10);
+		if (option == "--depth") {
+			depth = value;
+		}
+		else if (option == "--edits") {
+			edits = value;
+		}
+		else if (option == "--seed") {
+			seed = value;
+		}
+		else {
+			printf("Unknown option %s\n", option.c_str());
+			printUsage();
+			return 1;
+		}
+		i++;
+	}
+	if (depth < 2 || depth > MAX_TREE_DEPTH) {
+		printf("The depth must be between 2 and %u\n", MAX_TREE_DEPTH);
+		return 1;
+	}
+
+	const PlanSettings settings[] = {
+		{ 0, size_t(1) << 20 },
+		{ 2 * NODE_PAGE_SIZE, size_t(1) << 20 },
+		{ 8 * NODE_PAGE_SIZE, size_t(1) << 20 },
+		{ 2 * NODE_PAGE_SIZE, 16 * 1024 },
+		{ 2 * NODE_PAGE_SIZE, sizeof(SVDAGGPUNode) },
+	};
+
+	bool matched = true;
+	for (const PlanSettings& setting : settings) {
+		ReplayResult result = replay(setting, depth, edits, seed);
+		printf("Gap %5zu nodes, staging %8zu bytes: %7zu copies, %8.2f MB, %.4f s, %zu mismatched nodes\n",
+			setting.gapNodes, setting.stagingBytes, result.commands, result.bytes / 1048576.0, result.seconds, result.mismatches);
+		matched = matched && result.mismatches == 0;
+	}
+
+	printf(matched ? "The mirror matched the pool after every upload\n" : "The mirror diverged from the pool\n");
+	return matched ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+constexpr uint32_t DAG_FILE_MAGIC = 0x47414453; // "SDAG"
+constexpr uint32_t DAG_FILE_VERSION = 2;
+constexpr uint64_t DAG_FILE_DATA_ALIGNMENT = 4096;
+constexpr size_t DAG_CHECKSUM_BLOCK_SIZE = 1 << 20;
+// Resolutions are computed as 1u << depth, so deeper trees cannot be addressed
+constexpr uint32_t DAG_MAX_DEPTH = 31;
+
+enum DAGLayoutFlags : uint32_t {
+	DAG_LAYOUT_STD430 = 1 << 0,
+	DAG_LAYOUT_LITTLE_ENDIAN = 1 << 1,
+};
+
+enum DAGEncoding : uint32_t {
+	DAG_ENCODING_RAW = 0,
+	DAG_ENCODING_BLOCK_VARINT = 1,
+};
+
+constexpr uint32_t DAG_BLOCK_NODE_COUNT = 16384;
+
+struct DAGFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t nodeSize;
+	uint32_t depth;
+	uint32_t maxRefs;
+	uint32_t layoutFlags;
+	uint32_t encoding;
+	uint64_t nodeCount;
+	uint64_t dataOffset;
+	uint64_t dataSize;
+	uint64_t dataChecksum;
+	uint64_t blockTableOffset;
+	uint32_t blockNodeCount;
+	uint32_t blockCount;
+	// Last edit journal record folded into this file, 0 if none
+	uint64_t journalSequence;
+	uint64_t headerChecksum;
+};
+static_assert(sizeof(DAGFileHeader) == 96);
+
+// Byte-for-byte the VoxelNode struct the shaders read, with the padding spelled out
+struct DAGFileNode {
+	uint8_t childMask;
+	uint8_t padding0[3];
+	uint32_t refs;
+	uint16_t material;
+	uint16_t padding1;
+	uint32_t children[8];
+};
+static_assert(sizeof(DAGFileNode) == 44);
+
+// Index of a tiled world: a grid of independently built .dag tiles of equal depth
+constexpr uint32_t DAG_WORLD_MAGIC = 0x444C5753; // "SWLD"
+constexpr uint32_t DAG_WORLD_VERSION = 1;
+
+enum DAGTileFlags : uint32_t {
+	DAG_TILE_EMPTY = 1 << 0,
+};
+
+struct DAGWorldHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t tileDepth;
+	uint32_t tileCount;
+	uint32_t gridSize[3];
+	uint32_t reserved;
+	uint64_t tableChecksum;
+	uint64_t headerChecksum;
+};
+static_assert(sizeof(DAGWorldHeader) == 48);
+
+struct DAGWorldTile {
+	uint32_t x, y, z;
+	uint32_t flags;
+	uint64_t nodeCount;
+	char fileName[104];
+};
+static_assert(sizeof(DAGWorldTile) == 128);
+
+uint64_t dagBlockChecksum(const uint8_t* data, size_t size);
+uint64_t dagChecksum(const std::vector<uint64_t>& blockChecksums);
+uint64_t dagHeaderChecksum(const DAGFileHeader& header);
+
+bool writeDAGWorldIndex(const std::string& path, uint32_t tileDepth, const uint32_t gridSize[3], const std::vector<DAGWorldTile>& tiles);
+
+// Block encoding: per node the child mask, a mask of non-zero child slots, varint refs,
+// a zigzag material delta against the previous node and zigzag child deltas against the
+// node's own index for the first child and the previous sibling for the rest
+void encodeDAGBlock(const DAGFileNode* nodes, size_t count, uint64_t firstIndex, std::vector<uint8_t>& out);
+
+class DAGFileWriter
+{
+public:
+	bool open(const std::string& path, uint32_t depth, uint32_t maxRefs, DAGEncoding encoding = DAG_ENCODING_RAW);
+	void write(const DAGFileNode* nodes, size_t count);
+	bool close();
+	uint64_t fileSize() const { return header.dataOffset + header.dataSize; }
+	uint64_t rawSize() const { return header.nodeCount * sizeof(DAGFileNode); }
+private:
+	std::ofstream file;
+	DAGFileHeader header = {};
+	std::vector<uint8_t> checksumBlock;
+	std::vector<uint64_t> blockChecksums;
+	std::vector<DAGFileNode> pendingNodes;
+	std::vector<uint8_t> encodedBlock;
+	std::vector<uint64_t> blockOffsets;
+
+	void appendPayload(const uint8_t* bytes, size_t size);
+	void flushChecksumBlock();
+	void encodePendingNodes();
+};
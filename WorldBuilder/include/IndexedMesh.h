@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include <assimp/scene.h>
+
+// Triangles of a scene as mesh index << 32 | face index, in scene order
+using SceneFaces = std::vector<uint64_t>;
+
+// Indexed triangle buffers shared by the BVH and the voxelizer
+struct IndexedMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> triangleMaterials;
+
+    size_t triangleCount() const { return triangleMaterials.size(); }
+    bool empty() const { return triangleMaterials.empty(); }
+
+    const glm::vec3& vertex(size_t triangle, int corner) const { return positions[indices[triangle * 3 + corner]]; }
+    const glm::vec2& uv(size_t triangle, int corner) const { return uvs[indices[triangle * 3 + corner]]; }
+
+    glm::vec3 centroid(size_t triangle) const {
+        return (vertex(triangle, 0) + vertex(triangle, 1) + vertex(triangle, 2)) / 3.0f;
+    }
+
+    void triangleBounds(size_t triangle, glm::vec3& outMin, glm::vec3& outMax) const {
+        const glm::vec3& v0 = vertex(triangle, 0);
+        const glm::vec3& v1 = vertex(triangle, 1);
+        const glm::vec3& v2 = vertex(triangle, 2);
+        outMin = glm::min(glm::min(v0, v1), v2);
+        outMax = glm::max(glm::max(v0, v1), v2);
+    }
+
+    size_t memoryUsage() const {
+        return positions.capacity() * sizeof(glm::vec3) + uvs.capacity() * sizeof(glm::vec2) +
+            indices.capacity() * sizeof(uint32_t) + triangleMaterials.capacity() * sizeof(uint32_t);
+    }
+
+    void clear();
+
+    // Fills the buffers in voxel space, (v + translation) * scale
+    void loadFromScene(const aiScene* scene, const glm::vec3& translation, float scale);
+    // Same, with only the given faces, so a streaming import holds one spatial batch at a time
+    void loadFromScene(const aiScene* scene, const glm::vec3& translation, float scale, const SceneFaces& faces);
+};
+
+void computeSceneBounds(const aiScene* scene, glm::vec3& outMin, glm::vec3& outMax);
+// Sorts the triangles of the scene into batchCount^3 cubes of batchSize voxels in a single pass. A triangle goes
+// into every batch its bounds touch, boundaries included; buckets are indexed (x * batchCount + y) * batchCount + z
+void bucketSceneFaces(const aiScene* scene, const glm::vec3& translation, float scale, uint32_t batchSize, uint32_t batchCount,
+    std::vector<SceneFaces>& outBuckets);
@@ -1,15 +1,22 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
-#include <vector>
 #include <memory>
-#include <cereal/archives/binary.hpp>
-#include <cereal/types/vector.hpp>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <glm/glm.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "IndexedMesh.h"
+#include "TriangleBVH.h"
+#include "DAGFile.h"
+
 struct CPUNode
 {
 	uint8_t childMask;
@@ -23,17 +30,6 @@ struct GPUNode {
 	uint32_t refs;
 	uint16_t material;
 	uint32_t children[8];
-	template <class Archive>
-	void serialize(Archive& ar)
-	{
-		ar(childMask);
-		ar(refs);
-		ar(material);
-		for (size_t i = 0; i < 8; i++)
-		{
-			ar(children[i]);
-		}
-	}
 };
 
 struct MaterialData {
@@ -59,13 +55,16 @@ public:
 	SVDAGBuilder(uint32_t treeSize, uint16_t heightMapSize, uint16_t chunkSize);
 	~SVDAGBuilder();
 	void build();
-	void buildFromModel(const std::string& modelPath, uint16_t defaultMaterial = 0xFFFF);
+	void buildTiled(const std::string& worldName, uint32_t tilesPerAxis);
+	void buildFromModel(const std::string& modelPath, uint16_t defaultMaterial = 0xFFFF, uint32_t streamingBatchSize = 0);
+	void setFileEncoding(DAGEncoding encoding) { fileEncoding = encoding; }
 private:
 	uint32_t treeSize;
 	uint16_t heightMapSize;
 	uint16_t chunkSize;
 	size_t maxDepth;
-	uint32_t maxRefs;
+	uint32_t maxRefs = 0;
+	DAGEncoding fileEncoding = DAG_ENCODING_RAW;
 
 	std::unordered_map<uint64_t, std::shared_ptr<CPUNode>> subtrees;
 
@@ -84,20 +83,20 @@ private:
 	MaterialData loadMaterial(const aiMaterial* aiMat, const std::string& modelDir);
 	uint16_t sampleTextureColor(const std::string& texturePath, float u, float v);
 	uint16_t colorToRGB565(const glm::vec3& color);
+	void voxelizeRegion(const IndexedMesh& mesh, const glm::uvec3& regionMin, uint32_t regionSize, std::atomic<size_t>& leafVoxels);
+	// One triangle list per depth, reused by every node a thread voxelizes below the chunk size
+	using TriangleLists = std::vector<std::vector<uint32_t>>;
+	std::shared_ptr<CPUNode> voxelizeNode(const IndexedMesh& mesh, const TriangleBVH& bvh, const std::vector<uint32_t>& triangles, const glm::uvec3& nodeMin, uint32_t nodeSize, size_t currentDepth, TriangleLists& scratch, std::atomic<size_t>& leafVoxels);
+	uint16_t sampleVoxelMaterial(const IndexedMesh& mesh, uint32_t triIdx, const glm::vec3& voxelCenter);
 	glm::vec3 calculateBarycentric(const glm::vec3& p, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
 	void insertNodeRecursive(std::shared_ptr<CPUNode>& parent, uint64_t morton, size_t currentDepth, uint16_t material);
 	size_t calculateNodeHash(std::shared_ptr<CPUNode>& node);
 	void reduceTreeRecursive(std::shared_ptr<CPUNode>& node, size_t currentDepth);
     void reduceTreeRecursiveThreadSafe(std::shared_ptr<CPUNode>& node, size_t currentDepth, std::unordered_map<size_t, std::shared_ptr<CPUNode>>& localCache);
-	void mergeSubtrees();
+	void mergeSubtrees(uint32_t subtreeSize);
+	size_t buildTerrainTile(const std::vector<float>& heightmap, uint32_t originX, uint32_t originZ, uint32_t worldSize);
+	void resetTree();
 	void linearize();
 	void linearizeRecursive(std::shared_ptr<CPUNode>& node, uint64_t nodeIndex, size_t currentDepth);
-	void saveToFile(std::string fileName);
-
-	friend class cereal::access;
-	template <class Archive>
-	void serialize(Archive& archive)
-	{
-		archive(maxDepth, maxRefs, nodes);
-	}
+	bool saveToFile(std::string fileName);
 };
\ No newline at end of file
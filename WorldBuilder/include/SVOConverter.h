@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DAGFile.h"
+
+// Legacy world.bin node as written by SVOBuilder through cereal: no refs, no material, 33 bytes on disk
+struct LegacyNode {
+	uint8_t childMask;
+	uint32_t children[8];
+};
+
+struct ReducedNodeKey {
+	uint32_t depth;
+	uint8_t childMask;
+	uint32_t children[8];
+
+	bool operator==(const ReducedNodeKey& other) const;
+};
+
+struct ReducedNodeKeyHash {
+	size_t operator()(const ReducedNodeKey& key) const;
+};
+
+// Streams a legacy SVO from disk and writes it as a deduplicated .dag. Subtrees below splitDepth are
+// reduced in parallel batches, each with its own reader, and merged into one table afterwards
+class SVOConverter
+{
+public:
+	explicit SVOConverter(uint16_t material = 0xFFFF, uint32_t splitDepth = 3);
+	bool convert(const std::string& inputPath, const std::string& outputPath, DAGEncoding encoding = DAG_ENCODING_RAW);
+private:
+	uint16_t material;
+	uint32_t splitDepth;
+	uint32_t maxDepth = 0;
+	uint64_t nodeCount = 0;
+	std::string inputPath;
+
+	// Unique nodes with children stored as unique index + 1
+	std::vector<ReducedNodeKey> uniqueNodes;
+	std::unordered_map<ReducedNodeKey, uint32_t, ReducedNodeKeyHash> uniqueLookup;
+
+	bool readHeader();
+	bool readNodeAt(uint64_t index, LegacyNode& node) const;
+	void collectSubtrees(uint64_t index, uint32_t depth, std::vector<uint64_t>& subtrees) const;
+	bool reduceSubtree(uint64_t index, std::vector<ReducedNodeKey>& outNodes) const;
+	uint32_t mergeNode(const ReducedNodeKey& key);
+	uint32_t reduceTop(uint64_t index, uint32_t depth, const std::unordered_map<uint64_t, uint32_t>& subtreeRoots);
+	bool writeDAG(uint32_t root, const std::string& outputPath, DAGEncoding encoding);
+};
@@ -5,15 +5,12 @@
 #include <memory>
 #include <vector>
 
-struct Triangle {
-    glm::vec3 v0, v1, v2;
-    glm::vec2 uv0, uv1, uv2;
-    uint32_t materialIndex;
-};
+#include "IndexedMesh.h"
 
 struct BVHNode {
     glm::vec3 aabbMin, aabbMax;
-    std::vector<size_t> triangleIndices;
+    uint32_t firstTriangle = 0;
+    uint32_t triangleCount = 0;
     std::unique_ptr<BVHNode> children[2];
     bool isLeaf = true;
 
@@ -26,12 +23,13 @@ struct BVHNode {
 
 class TriangleBVH {
 public:
-    void build(const std::vector<Triangle>& triangles);
-    void query(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<size_t>& outIndices);
+    void build(const IndexedMesh& mesh);
+    void query(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& outIndices) const;
 private:
     std::unique_ptr<BVHNode> root;
-    std::unique_ptr<BVHNode> buildRecursive(const std::vector<Triangle>& triangles, std::vector<size_t>& indices, int depth);
-    void queryRecursive(const BVHNode* node, const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<size_t>& outIndices);
+    std::vector<uint32_t> triangleIndices;
+    std::unique_ptr<BVHNode> buildRecursive(const IndexedMesh& mesh, uint32_t first, uint32_t count, int depth);
+    void queryRecursive(const BVHNode* node, const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& outIndices) const;
 };
 
 inline bool planeBoxOverlap(const glm::vec3& normal, const glm::vec3& vert, const glm::vec3& maxbox) {
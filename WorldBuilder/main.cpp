@@ -1,8 +1,26 @@
+#include <string>
+
 #include "SVDAGBuilder.h"
+#include "SVOConverter.h"
 
-int main(void)
+int main(int argc, char** argv)
 {
+	// Worlds are written raw so they can be mapped in place; --compress opts into the block encoding
+	DAGEncoding encoding = DAG_ENCODING_RAW;
+	if (argc > 1 && std::string(argv[argc - 1]) == "--compress") {
+		encoding = DAG_ENCODING_BLOCK_VARINT;
+		argc--;
+	}
+
+	// WorldBuilder convert <world.bin> <output.dag> [--compress]
+	if (argc == 4 && std::string(argv[1]) == "convert") {
+		SVOConverter converter;
+		return converter.convert(argv[2], argv[3], encoding) ? 0 : 1;
+	}
+
+	// WorldBuilder [--compress]
 	SVDAGBuilder builder(256, 256, 128);
+	builder.setFileEncoding(encoding);
 	builder.build();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,212 @@
+#include "DAGFile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+uint64_t dagBlockChecksum(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t words = size / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    for (size_t i = words * sizeof(uint64_t); i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t dagChecksum(const std::vector<uint64_t>& blockChecksums)
+{
+    return dagBlockChecksum(reinterpret_cast<const uint8_t*>(blockChecksums.data()), blockChecksums.size() * sizeof(uint64_t));
+}
+
+uint64_t dagHeaderChecksum(const DAGFileHeader& header)
+{
+    return dagBlockChecksum(reinterpret_cast<const uint8_t*>(&header), offsetof(DAGFileHeader, headerChecksum));
+}
+
+bool writeDAGWorldIndex(const std::string& path, uint32_t tileDepth, const uint32_t gridSize[3], const std::vector<DAGWorldTile>& tiles)
+{
+    DAGWorldHeader header = {};
+    header.magic = DAG_WORLD_MAGIC;
+    header.version = DAG_WORLD_VERSION;
+    header.tileDepth = tileDepth;
+    header.tileCount = static_cast<uint32_t>(tiles.size());
+    std::copy(gridSize, gridSize + 3, header.gridSize);
+    header.tableChecksum = dagBlockChecksum(reinterpret_cast<const uint8_t*>(tiles.data()), tiles.size() * sizeof(DAGWorldTile));
+    header.headerChecksum = dagBlockChecksum(reinterpret_cast<const uint8_t*>(&header), offsetof(DAGWorldHeader, headerChecksum));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        printf("Failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(tiles.data()), tiles.size() * sizeof(DAGWorldTile));
+    return !file.fail();
+}
+
+namespace {
+    void writeVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+}
+
+void encodeDAGBlock(const DAGFileNode* nodes, size_t count, uint64_t firstIndex, std::vector<uint8_t>& out)
+{
+    uint16_t previousMaterial = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const DAGFileNode& node = nodes[i];
+
+        uint8_t childPresent = 0;
+        for (int c = 0; c < 8; c++) {
+            if (node.children[c] != 0) childPresent |= 1 << c;
+        }
+
+        out.push_back(node.childMask);
+        out.push_back(childPresent);
+        writeVarint(out, node.refs);
+        writeVarint(out, zigzag(static_cast<int64_t>(node.material) - previousMaterial));
+        previousMaterial = node.material;
+
+        int64_t reference = static_cast<int64_t>(firstIndex + i);
+        for (int c = 0; c < 8; c++) {
+            if ((childPresent & (1 << c)) == 0) continue;
+            writeVarint(out, zigzag(static_cast<int64_t>(node.children[c]) - reference));
+            reference = node.children[c];
+        }
+    }
+}
+
+bool DAGFileWriter::open(const std::string& path, uint32_t depth, uint32_t maxRefs, DAGEncoding encoding)
+{
+    if (depth == 0 || depth > DAG_MAX_DEPTH) {
+        printf("Unsupported DAG depth %u, expected 1 to %u\n", depth, DAG_MAX_DEPTH);
+        return false;
+    }
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        printf("Failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+
+    header = {};
+    header.magic = DAG_FILE_MAGIC;
+    header.version = DAG_FILE_VERSION;
+    header.headerSize = sizeof(DAGFileHeader);
+    header.nodeSize = sizeof(DAGFileNode);
+    header.depth = depth;
+    header.maxRefs = maxRefs;
+    header.layoutFlags = DAG_LAYOUT_STD430 | DAG_LAYOUT_LITTLE_ENDIAN;
+    header.encoding = encoding;
+    header.dataOffset = DAG_FILE_DATA_ALIGNMENT;
+    if (encoding == DAG_ENCODING_BLOCK_VARINT) {
+        header.blockNodeCount = DAG_BLOCK_NODE_COUNT;
+    }
+
+    std::vector<char> placeholder(DAG_FILE_DATA_ALIGNMENT, 0);
+    file.write(placeholder.data(), placeholder.size());
+
+    checksumBlock.clear();
+    checksumBlock.reserve(DAG_CHECKSUM_BLOCK_SIZE);
+    blockChecksums.clear();
+    pendingNodes.clear();
+    blockOffsets.clear();
+    return true;
+}
+
+void DAGFileWriter::write(const DAGFileNode* nodes, size_t count)
+{
+    if (header.encoding == DAG_ENCODING_RAW) {
+        header.nodeCount += count;
+        appendPayload(reinterpret_cast<const uint8_t*>(nodes), count * sizeof(DAGFileNode));
+        return;
+    }
+
+    while (count > 0) {
+        size_t take = std::min<size_t>(count, header.blockNodeCount - pendingNodes.size());
+        pendingNodes.insert(pendingNodes.end(), nodes, nodes + take);
+        nodes += take;
+        count -= take;
+
+        if (pendingNodes.size() == header.blockNodeCount) {
+            encodePendingNodes();
+        }
+    }
+}
+
+void DAGFileWriter::encodePendingNodes()
+{
+    if (pendingNodes.empty()) return;
+
+    encodedBlock.clear();
+    encodeDAGBlock(pendingNodes.data(), pendingNodes.size(), header.nodeCount, encodedBlock);
+
+    blockOffsets.push_back(header.dataSize + checksumBlock.size());
+    header.nodeCount += pendingNodes.size();
+    header.blockCount++;
+    pendingNodes.clear();
+
+    appendPayload(encodedBlock.data(), encodedBlock.size());
+}
+
+void DAGFileWriter::appendPayload(const uint8_t* bytes, size_t size)
+{
+    while (size > 0) {
+        size_t take = std::min(size, DAG_CHECKSUM_BLOCK_SIZE - checksumBlock.size());
+        checksumBlock.insert(checksumBlock.end(), bytes, bytes + take);
+        bytes += take;
+        size -= take;
+
+        if (checksumBlock.size() == DAG_CHECKSUM_BLOCK_SIZE) {
+            flushChecksumBlock();
+        }
+    }
+}
+
+void DAGFileWriter::flushChecksumBlock()
+{
+    if (checksumBlock.empty()) return;
+
+    blockChecksums.push_back(dagBlockChecksum(checksumBlock.data(), checksumBlock.size()));
+    file.write(reinterpret_cast<const char*>(checksumBlock.data()), checksumBlock.size());
+    header.dataSize += checksumBlock.size();
+    checksumBlock.clear();
+}
+
+bool DAGFileWriter::close()
+{
+    if (header.encoding == DAG_ENCODING_BLOCK_VARINT) {
+        encodePendingNodes();
+
+        uint64_t tableOffset = header.dataSize + checksumBlock.size();
+        blockOffsets.push_back(tableOffset);
+        header.blockTableOffset = tableOffset;
+        appendPayload(reinterpret_cast<const uint8_t*>(blockOffsets.data()), blockOffsets.size() * sizeof(uint64_t));
+    }
+
+    flushChecksumBlock();
+
+    header.dataChecksum = dagChecksum(blockChecksums);
+    header.headerChecksum = dagHeaderChecksum(header);
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    return !file.fail();
+}
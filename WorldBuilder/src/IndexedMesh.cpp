@@ -0,0 +1,189 @@
+#include "IndexedMesh.h"
+
+#include <algorithm>
+#include <execution>
+#include <limits>
+#include <numeric>
+
+namespace {
+    struct MeshSlice {
+        uint32_t vertexCount = 0;
+        uint32_t triangleCount = 0;
+        size_t firstVertex = 0;
+        size_t firstTriangle = 0;
+    };
+
+    glm::vec3 toVoxelSpace(const aiVector3D& v, const glm::vec3& translation, float scale) {
+        return (glm::vec3(v.x, v.y, v.z) + translation) * scale;
+    }
+
+    glm::vec2 vertexUV(const aiMesh* mesh, uint32_t v) {
+        return mesh->mTextureCoords[0] ? glm::vec2(mesh->mTextureCoords[0][v].x, mesh->mTextureCoords[0][v].y) : glm::vec2(0.0f);
+    }
+
+    std::vector<uint32_t> meshIndices(const aiScene* scene) {
+        std::vector<uint32_t> ids(scene->mNumMeshes);
+        std::iota(ids.begin(), ids.end(), 0u);
+        return ids;
+    }
+}
+
+void IndexedMesh::clear()
+{
+    positions.clear();
+    positions.shrink_to_fit();
+    uvs.clear();
+    uvs.shrink_to_fit();
+    indices.clear();
+    indices.shrink_to_fit();
+    triangleMaterials.clear();
+    triangleMaterials.shrink_to_fit();
+}
+
+void computeSceneBounds(const aiScene* scene, glm::vec3& outMin, glm::vec3& outMax)
+{
+    std::vector<glm::vec3> meshMin(scene->mNumMeshes, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> meshMax(scene->mNumMeshes, glm::vec3(std::numeric_limits<float>::lowest()));
+    std::vector<uint32_t> ids = meshIndices(scene);
+
+    std::for_each(std::execution::par, ids.begin(), ids.end(), [&](uint32_t meshIdx) {
+        const aiMesh* mesh = scene->mMeshes[meshIdx];
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+            glm::vec3 p(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+            meshMin[meshIdx] = glm::min(meshMin[meshIdx], p);
+            meshMax[meshIdx] = glm::max(meshMax[meshIdx], p);
+        }
+        });
+
+    outMin = glm::vec3(std::numeric_limits<float>::max());
+    outMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (uint32_t meshIdx : ids) {
+        outMin = glm::min(outMin, meshMin[meshIdx]);
+        outMax = glm::max(outMax, meshMax[meshIdx]);
+    }
+}
+
+void IndexedMesh::loadFromScene(const aiScene* scene, const glm::vec3& translation, float scale)
+{
+    clear();
+
+    std::vector<MeshSlice> slices(scene->mNumMeshes);
+    std::vector<uint32_t> ids = meshIndices(scene);
+    size_t vertexTotal = 0;
+    size_t triangleTotal = 0;
+    for (uint32_t meshIdx : ids) {
+        const aiMesh* mesh = scene->mMeshes[meshIdx];
+        MeshSlice& slice = slices[meshIdx];
+        slice.vertexCount = mesh->mNumVertices;
+        for (unsigned int faceIdx = 0; faceIdx < mesh->mNumFaces; faceIdx++) {
+            if (mesh->mFaces[faceIdx].mNumIndices == 3) slice.triangleCount++;
+        }
+        slice.firstVertex = vertexTotal;
+        slice.firstTriangle = triangleTotal;
+        vertexTotal += slice.vertexCount;
+        triangleTotal += slice.triangleCount;
+    }
+
+    positions.resize(vertexTotal);
+    uvs.resize(vertexTotal);
+    indices.resize(triangleTotal * 3);
+    triangleMaterials.resize(triangleTotal);
+
+    std::for_each(std::execution::par, ids.begin(), ids.end(), [&](uint32_t meshIdx) {
+        const aiMesh* mesh = scene->mMeshes[meshIdx];
+        const MeshSlice& slice = slices[meshIdx];
+        if (slice.triangleCount == 0) return;
+
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+            positions[slice.firstVertex + v] = toVoxelSpace(mesh->mVertices[v], translation, scale);
+            uvs[slice.firstVertex + v] = vertexUV(mesh, v);
+        }
+
+        size_t triangle = slice.firstTriangle;
+        for (unsigned int faceIdx = 0; faceIdx < mesh->mNumFaces; faceIdx++) {
+            const aiFace& face = mesh->mFaces[faceIdx];
+            if (face.mNumIndices != 3) continue;
+
+            for (int i = 0; i < 3; i++) {
+                indices[triangle * 3 + i] = static_cast<uint32_t>(slice.firstVertex + face.mIndices[i]);
+            }
+            triangleMaterials[triangle] = mesh->mMaterialIndex;
+            triangle++;
+        }
+        });
+}
+
+// Vertices are keyed like faces, mesh index << 32 | vertex index, and the sorted unique keys become the
+// vertex buffer, so the cost follows the number of faces and not the size of the meshes they come from
+void IndexedMesh::loadFromScene(const aiScene* scene, const glm::vec3& translation, float scale, const SceneFaces& faces)
+{
+    clear();
+
+    std::vector<uint64_t> vertexKeys(faces.size() * 3);
+    std::for_each(std::execution::par, faces.begin(), faces.end(), [&](const uint64_t& faceKey) {
+        size_t triangle = &faceKey - faces.data();
+        uint64_t meshIdx = faceKey >> 32;
+        const aiFace& face = scene->mMeshes[meshIdx]->mFaces[faceKey & 0xFFFFFFFFu];
+        for (int i = 0; i < 3; i++) {
+            vertexKeys[triangle * 3 + i] = (meshIdx << 32) | face.mIndices[i];
+        }
+        });
+    std::vector<uint64_t> cornerKeys = vertexKeys;
+    std::sort(std::execution::par, vertexKeys.begin(), vertexKeys.end());
+    vertexKeys.erase(std::unique(vertexKeys.begin(), vertexKeys.end()), vertexKeys.end());
+
+    positions.resize(vertexKeys.size());
+    uvs.resize(vertexKeys.size());
+    std::for_each(std::execution::par, vertexKeys.begin(), vertexKeys.end(), [&](const uint64_t& vertexKey) {
+        size_t vertex = &vertexKey - vertexKeys.data();
+        const aiMesh* mesh = scene->mMeshes[vertexKey >> 32];
+        uint32_t v = static_cast<uint32_t>(vertexKey & 0xFFFFFFFFu);
+        positions[vertex] = toVoxelSpace(mesh->mVertices[v], translation, scale);
+        uvs[vertex] = vertexUV(mesh, v);
+        });
+
+    indices.resize(cornerKeys.size());
+    triangleMaterials.resize(faces.size());
+    std::for_each(std::execution::par, faces.begin(), faces.end(), [&](const uint64_t& faceKey) {
+        size_t triangle = &faceKey - faces.data();
+        for (int i = 0; i < 3; i++) {
+            auto it = std::lower_bound(vertexKeys.begin(), vertexKeys.end(), cornerKeys[triangle * 3 + i]);
+            indices[triangle * 3 + i] = static_cast<uint32_t>(it - vertexKeys.begin());
+        }
+        triangleMaterials[triangle] = scene->mMeshes[faceKey >> 32]->mMaterialIndex;
+        });
+}
+
+void bucketSceneFaces(const aiScene* scene, const glm::vec3& translation, float scale, uint32_t batchSize, uint32_t batchCount,
+    std::vector<SceneFaces>& outBuckets)
+{
+    outBuckets.assign(size_t(batchCount) * batchCount * batchCount, {});
+
+    // Batch b spans [b * batchSize, (b + 1) * batchSize] and takes every triangle whose bounds touch it
+    float size = static_cast<float>(batchSize);
+    int lastBatch = static_cast<int>(batchCount) - 1;
+    for (uint32_t meshIdx = 0; meshIdx < scene->mNumMeshes; meshIdx++) {
+        const aiMesh* mesh = scene->mMeshes[meshIdx];
+        for (unsigned int faceIdx = 0; faceIdx < mesh->mNumFaces; faceIdx++) {
+            const aiFace& face = mesh->mFaces[faceIdx];
+            if (face.mNumIndices != 3) continue;
+
+            glm::vec3 v0 = toVoxelSpace(mesh->mVertices[face.mIndices[0]], translation, scale);
+            glm::vec3 v1 = toVoxelSpace(mesh->mVertices[face.mIndices[1]], translation, scale);
+            glm::vec3 v2 = toVoxelSpace(mesh->mVertices[face.mIndices[2]], translation, scale);
+            glm::vec3 triMin = glm::min(glm::min(v0, v1), v2);
+            glm::vec3 triMax = glm::max(glm::max(v0, v1), v2);
+            glm::ivec3 first = glm::max(glm::ivec3(glm::ceil(triMin / size)) - 1, glm::ivec3(0));
+            glm::ivec3 last = glm::min(glm::ivec3(glm::floor(triMax / size)), glm::ivec3(lastBatch));
+
+            uint64_t faceKey = (uint64_t(meshIdx) << 32) | faceIdx;
+            for (int x = first.x; x <= last.x; x++) {
+                for (int y = first.y; y <= last.y; y++) {
+                    for (int z = first.z; z <= last.z; z++) {
+                        outBuckets[(size_t(x) * batchCount + y) * batchCount + z].push_back(faceKey);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -1,11 +1,13 @@
 #include "HeightMapGenerator.h"
 #include "SVDAGBuilder.h"
-#include "TriangleBVH.h"
 
+#include <array>
 #include <atomic>
+#include <bit>
 #include <chrono>
 #include <execution>
 #include <fstream>
+#include <numeric>
 #include <glm/gtc/noise.hpp>
 #include <morton-nd/mortonND_BMI2.h>
 
@@ -32,16 +34,84 @@ void SVDAGBuilder::build()
     auto start = std::chrono::steady_clock::now();
     printf("Max depth: %zu\n", maxDepth);
 
-    uint32_t maxHeight = 0;
-    uint32_t minHeight = 0;
-	size_t leafVoxels = 0;
+    HeightMapGenerator generator = HeightMapGenerator(heightMapSize, 8, 0.5f, 0.5f);
+    std::vector<float> heightmap = generator.generateHeightMap();
+
+    size_t leafVoxels = buildTerrainTile(heightmap, 0, 0, treeSize);
+    mergeSubtrees(chunkSize);
+    linearize();
+    saveToFile("world" + std::to_string(treeSize));
+
+    auto end = std::chrono::steady_clock::now();
+    printf("SVDAG generation took %.1f seconds\n", std::chrono::duration<float>(end - start).count());
+    printf("Leaf voxels: %zu\n", leafVoxels);
+    printf("Total nodes: %zu\n", nodes.size());
+    printf("Max refs: %u\n", maxRefs);
+}
 
-    float xRatio = (float)(heightMapSize - 1) / (treeSize - 1);
-    float zRatio = (float)(heightMapSize - 1) / (treeSize - 1);
+void SVDAGBuilder::buildTiled(const std::string& worldName, uint32_t tilesPerAxis)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint32_t worldSize = treeSize * tilesPerAxis;
+    printf("Building %u x %u tiles of %u^3 voxels\n", tilesPerAxis, tilesPerAxis, treeSize);
 
     HeightMapGenerator generator = HeightMapGenerator(heightMapSize, 8, 0.5f, 0.5f);
     std::vector<float> heightmap = generator.generateHeightMap();
 
+    std::vector<DAGWorldTile> tiles;
+    size_t totalNodes = 0;
+    for (uint32_t tileZ = 0; tileZ < tilesPerAxis; tileZ++) {
+        for (uint32_t tileX = 0; tileX < tilesPerAxis; tileX++) {
+            resetTree();
+
+            DAGWorldTile tile = {};
+            tile.x = tileX;
+            tile.y = 0;
+            tile.z = tileZ;
+
+            size_t leafVoxels = buildTerrainTile(heightmap, tileX * treeSize, tileZ * treeSize, worldSize);
+            if (leafVoxels == 0) {
+                tile.flags = DAG_TILE_EMPTY;
+                tiles.push_back(tile);
+                continue;
+            }
+
+            mergeSubtrees(chunkSize);
+            linearize();
+
+            std::string tileName = worldName + "_" + std::to_string(tileX) + "_0_" + std::to_string(tileZ);
+            if (tileName.size() + 4 >= sizeof(tile.fileName) || !saveToFile(tileName)) {
+                printf("Failed to save tile %s\n", tileName.c_str());
+                return;
+            }
+            std::snprintf(tile.fileName, sizeof(tile.fileName), "%s.dag", tileName.c_str());
+            tile.nodeCount = nodes.size();
+            totalNodes += nodes.size();
+            tiles.push_back(tile);
+        }
+    }
+
+    uint32_t gridSize[3] = { tilesPerAxis, 1, tilesPerAxis };
+    std::string indexPath = "..\\Renderer\\" + worldName + ".world";
+    if (!writeDAGWorldIndex(indexPath, static_cast<uint32_t>(maxDepth), gridSize, tiles)) {
+        printf("Failed to write %s\n", indexPath.c_str());
+        return;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    printf("Tiled world generation took %.1f seconds\n", std::chrono::duration<float>(end - start).count());
+    printf("Tiles: %zu, total nodes: %zu\n", tiles.size(), totalNodes);
+}
+
+size_t SVDAGBuilder::buildTerrainTile(const std::vector<float>& heightmap, uint32_t originX, uint32_t originZ, uint32_t worldSize)
+{
+    uint32_t maxHeight = 0;
+    uint32_t minHeight = 0;
+    size_t leafVoxels = 0;
+
+    float xRatio = (float)(heightMapSize - 1) / (worldSize - 1);
+    float zRatio = (float)(heightMapSize - 1) / (worldSize - 1);
+
     #pragma omp parallel for collapse(3) reduction(+:leafVoxels) reduction(max:maxHeight) reduction(min:minHeight)
     for (size_t chunkX = 0; chunkX < treeSize; chunkX += chunkSize)
     {
@@ -60,8 +130,8 @@ void SVDAGBuilder::build()
                 {
                     for (size_t voxelZ = chunkZ; voxelZ < chunkZ + chunkSize; voxelZ++)
                     {
-                        float x = xRatio * voxelX;
-                        float z = zRatio * voxelZ;
+                        float x = xRatio * (originX + voxelX);
+                        float z = zRatio * (originZ + voxelZ);
 
                         size_t x1 = static_cast<size_t>(floorf(x));
                         size_t z1 = static_cast<size_t>(floorf(z));
@@ -108,15 +178,17 @@ void SVDAGBuilder::build()
             }
         }
     }
-    mergeSubtrees();
-    linearize();
-    saveToFile("world" + std::to_string(treeSize));
+    return leafVoxels;
+}
 
-    auto end = std::chrono::steady_clock::now();
-    printf("SVDAG generation took %.1f seconds\n", std::chrono::duration<float>(end - start).count());
-    printf("Leaf voxels: %zu\n", leafVoxels);
-    printf("Total nodes: %zu\n", nodes.size());
-    printf("Max refs: %u\n", maxRefs);
+void SVDAGBuilder::resetTree()
+{
+    subtrees.clear();
+    nodeCache.clear();
+    nodeToIndexMap.clear();
+    nodes.clear();
+    root.reset();
+    maxRefs = 0;
 }
 
 uint16_t SVDAGBuilder::colorToRGB565(const glm::vec3& color) {
@@ -205,7 +277,7 @@ uint16_t SVDAGBuilder::sampleTextureColor(const std::string& texturePath, float
     return colorToRGB565(color);
 }
 
-void SVDAGBuilder::buildFromModel(const std::string& modelPath, uint16_t defaultMaterial)
+void SVDAGBuilder::buildFromModel(const std::string& modelPath, uint16_t defaultMaterial, uint32_t streamingBatchSize)
 {
     stbi_set_flip_vertically_on_load(true);
 
@@ -214,7 +286,7 @@ void SVDAGBuilder::buildFromModel(const std::string& modelPath, uint16_t default
     printf("Max depth: %zu\n", maxDepth);
 
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(modelPath, aiProcess_Triangulate);
+    const aiScene* scene = importer.ReadFile(modelPath, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         printf("ERROR::ASSIMP:: %s\n", importer.GetErrorString());
@@ -239,212 +311,220 @@ void SVDAGBuilder::buildFromModel(const std::string& modelPath, uint16_t default
         }
     }
 
-    std::vector<Triangle> triangles;
-    triangles.reserve(100000);
+    glm::vec3 minAABB, maxAABB;
+    computeSceneBounds(scene, minAABB, maxAABB);
 
-    for (unsigned int meshIdx = 0; meshIdx < scene->mNumMeshes; meshIdx++) {
-        aiMesh* mesh = scene->mMeshes[meshIdx];
-        uint32_t matIndex = mesh->mMaterialIndex;
+    glm::vec3 size = maxAABB - minAABB;
+    float maxDim = std::max({ size.x, size.y, size.z });
+    float scale = (float)(treeSize - 1) / maxDim;
+    glm::vec3 translation = -minAABB;
 
-        for (unsigned int faceIdx = 0; faceIdx < mesh->mNumFaces; faceIdx++) {
-            aiFace face = mesh->mFaces[faceIdx];
-            if (face.mNumIndices != 3) continue;
+    printf("Model bounds: (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f)\n",
+        minAABB.x, minAABB.y, minAABB.z, maxAABB.x, maxAABB.y, maxAABB.z);
 
-            Triangle tri;
-            tri.materialIndex = matIndex;
+    std::atomic<size_t> leafVoxels{ 0 };
 
-            for (int i = 0; i < 3; i++) {
-                unsigned int idx = face.mIndices[i];
-                glm::vec3* verts[] = { &tri.v0, &tri.v1, &tri.v2 };
-                glm::vec2* uvs[] = { &tri.uv0, &tri.uv1, &tri.uv2 };
+    uint32_t batchSize = treeSize;
+    if (streamingBatchSize != 0 && streamingBatchSize < treeSize) {
+        batchSize = std::max<uint32_t>(std::bit_ceil(streamingBatchSize), chunkSize);
+    }
 
-                *verts[i] = glm::vec3(
-                    mesh->mVertices[idx].x,
-                    mesh->mVertices[idx].y,
-                    mesh->mVertices[idx].z
-                );
+    if (batchSize == treeSize) {
+        IndexedMesh mesh;
+        mesh.loadFromScene(scene, translation, scale);
+        importer.FreeScene();
+        printf("Loaded %zu triangles, %zu vertices (%.1f MB)\n",
+            mesh.triangleCount(), mesh.positions.size(), mesh.memoryUsage() / (1024.0f * 1024.0f));
 
-                if (mesh->mTextureCoords[0]) {
-                    *uvs[i] = glm::vec2(
-                        mesh->mTextureCoords[0][idx].x,
-                        mesh->mTextureCoords[0][idx].y
-                    );
-                }
-                else {
-                    *uvs[i] = glm::vec2(0.0f);
+        voxelizeRegion(mesh, glm::uvec3(0), treeSize, leafVoxels);
+    }
+    else {
+        printf("Streaming import in %u^3 batches\n", batchSize);
+
+        uint32_t batchCount = treeSize / batchSize;
+        std::vector<SceneFaces> batchFaces;
+        bucketSceneFaces(scene, translation, scale, batchSize, batchCount, batchFaces);
+
+        for (uint32_t batchX = 0; batchX < treeSize; batchX += batchSize) {
+            for (uint32_t batchY = 0; batchY < treeSize; batchY += batchSize) {
+                for (uint32_t batchZ = 0; batchZ < treeSize; batchZ += batchSize) {
+                    glm::uvec3 batchMin(batchX, batchY, batchZ);
+                    SceneFaces& faces = batchFaces[(size_t(batchX / batchSize) * batchCount + batchY / batchSize) * batchCount + batchZ / batchSize];
+                    if (faces.empty()) continue;
+
+                    IndexedMesh mesh;
+                    mesh.loadFromScene(scene, translation, scale, faces);
+                    faces.clear();
+                    faces.shrink_to_fit();
+
+                    printf("Batch (%u,%u,%u): %zu triangles (%.1f MB)\n",
+                        batchX / batchSize, batchY / batchSize, batchZ / batchSize,
+                        mesh.triangleCount(), mesh.memoryUsage() / (1024.0f * 1024.0f));
+
+                    voxelizeRegion(mesh, batchMin, batchSize, leafVoxels);
                 }
             }
-
-            triangles.push_back(tri);
         }
     }
 
-    printf("Loaded %zu triangles\n", triangles.size());
-
-    glm::vec3 minAABB(std::numeric_limits<float>::max());
-    glm::vec3 maxAABB(std::numeric_limits<float>::lowest());
+    printf("\nMerging subtrees...\n");
+    mergeSubtrees(batchSize);
 
-    for (const auto& tri : triangles) {
-        minAABB = glm::min(minAABB, glm::min(glm::min(tri.v0, tri.v1), tri.v2));
-        maxAABB = glm::max(maxAABB, glm::max(glm::max(tri.v0, tri.v1), tri.v2));
-    }
+    printf("Linearizing...\n");
+    linearize();
 
-    glm::vec3 size = maxAABB - minAABB;
-    float maxDim = std::max({ size.x, size.y, size.z });
-    float scale = (float)(treeSize - 1) / maxDim;
-    glm::vec3 translation = -minAABB;
+    printf("Saving to file...\n");
+    saveToFile(modelDir + std::to_string(treeSize));
 
-    for (auto& tri : triangles) {
-        tri.v0 = (tri.v0 + translation) * scale;
-        tri.v1 = (tri.v1 + translation) * scale;
-        tri.v2 = (tri.v2 + translation) * scale;
-    }
+    auto end = std::chrono::steady_clock::now();
+    printf("\n=== SVDAG generation complete ===\n");
+    printf("Total time: %.1f seconds\n", std::chrono::duration<float>(end - start).count());
+    printf("Leaf voxels: %zu\n", leafVoxels.load());
+    printf("Total nodes: %zu\n", nodes.size());
+    printf("Compression ratio: %.2fx\n", static_cast<float>(leafVoxels) / nodes.size());
+}
 
-    printf("Model bounds: (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f)\n",
-        minAABB.x, minAABB.y, minAABB.z, maxAABB.x, maxAABB.y, maxAABB.z);
+void SVDAGBuilder::voxelizeRegion(const IndexedMesh& mesh, const glm::uvec3& regionMin, uint32_t regionSize, std::atomic<size_t>& leafVoxels)
+{
+    auto regionStart = std::chrono::steady_clock::now();
+    size_t regionDepth = maxDepth - static_cast<size_t>(std::log2(regionSize));
 
-    printf("Building BVH...\n");
-    auto bvhStart = std::chrono::steady_clock::now();
     TriangleBVH bvh;
-    bvh.build(triangles);
-    auto bvhEnd = std::chrono::steady_clock::now();
-    printf("BVH built in %.2f seconds\n", std::chrono::duration<float>(bvhEnd - bvhStart).count());
+    bvh.build(mesh);
+    printf("BVH built in %.2f seconds\n", std::chrono::duration<float>(std::chrono::steady_clock::now() - regionStart).count());
 
-    std::atomic<size_t> leafVoxels{ 0 };
-    auto builtLevels = static_cast<size_t>(std::log2(chunkSize));
-    auto currentDepth = maxDepth - builtLevels;
-
-    std::vector<std::tuple<size_t, size_t, size_t>> chunkCoords;
-    for (size_t chunkX = 0; chunkX < treeSize; chunkX += chunkSize) {
-        for (size_t chunkY = 0; chunkY < treeSize; chunkY += chunkSize) {
-            for (size_t chunkZ = 0; chunkZ < treeSize; chunkZ += chunkSize) {
-                chunkCoords.emplace_back(chunkX, chunkY, chunkZ);
-            }
-        }
+    std::vector<uint32_t> triangles;
+    bvh.query(glm::vec3(regionMin), glm::vec3(regionMin + regionSize), triangles);
+    if (triangles.empty()) {
+        return;
     }
 
-    std::mutex subtreesMutex;
-    std::atomic<size_t> chunksProcessed{ 0 };
-
-    std::for_each(std::execution::par, chunkCoords.begin(), chunkCoords.end(),
-        [&](const auto& coords) {
-            size_t chunkX = std::get<0>(coords);
-            size_t chunkY = std::get<1>(coords);
-            size_t chunkZ = std::get<2>(coords);
-            auto chunkStart = std::chrono::steady_clock::now();
-
-            glm::vec3 chunkMin(chunkX, chunkY, chunkZ);
-            glm::vec3 chunkMax(chunkX + chunkSize, chunkY + chunkSize, chunkZ + chunkSize);
+    TriangleLists scratch(maxDepth + 1);
+    std::shared_ptr<CPUNode> regionRoot = voxelizeNode(mesh, bvh, triangles, regionMin, regionSize, regionDepth, scratch, leafVoxels);
+    if (!regionRoot) {
+        return;
+    }
 
-            std::vector<size_t> relevantTriangles;
-            bvh.query(chunkMin, chunkMax, relevantTriangles);
+    uint64_t subtreeCode = mortonnd::MortonNDBmi_3D_64::Encode(
+        regionMin.x / regionSize,
+        regionMin.y / regionSize,
+        regionMin.z / regionSize);
+    subtrees[subtreeCode] = regionRoot;
 
-            if (relevantTriangles.empty()) {
-                return;
-            }
+    auto regionEnd = std::chrono::steady_clock::now();
+    printf("Voxelized %u^3 region in %.2f seconds, %zu voxels so far\n",
+        regionSize, std::chrono::duration<float>(regionEnd - regionStart).count(), leafVoxels.load());
+}
 
-            std::shared_ptr<CPUNode> subtreeRoot = std::make_unique<CPUNode>();
-            std::unordered_set<uint64_t> chunkVoxelSet;
-            chunkVoxelSet.reserve(chunkSize * chunkSize * chunkSize / 10);
+// Above the chunk size the octants run in parallel, each with its own lists, and take their candidates from the
+// BVH; below it a node narrows its parent's list into the scratch list of the next depth
+std::shared_ptr<CPUNode> SVDAGBuilder::voxelizeNode(const IndexedMesh& mesh, const TriangleBVH& bvh, const std::vector<uint32_t>& triangles, const glm::uvec3& nodeMin, uint32_t nodeSize, size_t currentDepth, TriangleLists& scratch, std::atomic<size_t>& leafVoxels)
+{
+    uint32_t childSize = nodeSize / 2;
+    glm::vec3 childHalfSize(childSize * 0.5f);
 
-            size_t localLeafVoxels = 0;
+    auto childOrigin = [&](uint32_t octant) {
+        return nodeMin + glm::uvec3(
+            (octant & 1) ? childSize : 0,
+            (octant & 2) ? childSize : 0,
+            (octant & 4) ? childSize : 0);
+    };
 
-            for (size_t triIdx : relevantTriangles) {
-                const auto& tri = triangles[triIdx];
-                const MaterialData& material = materials[tri.materialIndex];
+    auto intersects = [&](uint32_t triIdx, const glm::vec3& boxCenter) {
+        return triangleAABBIntersect(mesh.vertex(triIdx, 0), mesh.vertex(triIdx, 1), mesh.vertex(triIdx, 2),
+            boxCenter, childHalfSize);
+    };
 
-                glm::vec3 triMin = glm::min(glm::min(tri.v0, tri.v1), tri.v2);
-                glm::vec3 triMax = glm::max(glm::max(tri.v0, tri.v1), tri.v2);
+    auto node = std::make_shared<CPUNode>();
 
-                glm::ivec3 minVoxel = glm::clamp(
-                    glm::ivec3(glm::floor(triMin)),
-                    glm::ivec3(chunkMin),
-                    glm::ivec3(chunkMax - 1.0f));
-                glm::ivec3 maxVoxel = glm::clamp(
-                    glm::ivec3(glm::ceil(triMax)),
-                    glm::ivec3(chunkMin),
-                    glm::ivec3(chunkMax - 1.0f));
+    if (currentDepth == maxDepth - 1) {
+        for (uint32_t octant = 0; octant < 8; octant++) {
+            glm::vec3 voxelCenter = glm::vec3(childOrigin(octant)) + childHalfSize;
 
-                if (minVoxel.x > maxVoxel.x || minVoxel.y > maxVoxel.y || minVoxel.z > maxVoxel.z) {
-                    continue;
-                }
+            for (uint32_t triIdx : triangles) {
+                if (!intersects(triIdx, voxelCenter)) continue;
 
-                for (int z = minVoxel.z; z <= maxVoxel.z; ++z) {
-                    for (int y = minVoxel.y; y <= maxVoxel.y; ++y) {
-                        for (int x = minVoxel.x; x <= maxVoxel.x; ++x) {
-                            glm::vec3 voxelCenter(x + 0.5f, y + 0.5f, z + 0.5f);
-                            glm::vec3 voxelHalfSize(0.5f);
-
-                            if (triangleAABBIntersect(tri.v0, tri.v1, tri.v2,
-                                voxelCenter, voxelHalfSize)) {
-                                uint64_t morton = mortonnd::MortonNDBmi_3D_64::Encode(
-                                    static_cast<uint32_t>(x),
-                                    static_cast<uint32_t>(y),
-                                    static_cast<uint32_t>(z));
-
-                                if (chunkVoxelSet.insert(morton).second) {
-                                    uint16_t voxelMaterial;
-                                    if (material.hasTexture) {
-                                        glm::vec3 bary = calculateBarycentric(voxelCenter,
-                                            tri.v0, tri.v1, tri.v2);
-                                        glm::vec2 uv = bary.x * tri.uv0 + bary.y * tri.uv1 + bary.z * tri.uv2;
-                                        voxelMaterial = sampleTextureColor(material.texturePath, uv.x, uv.y);
-                                    }
-                                    else {
-                                        voxelMaterial = material.materialID;
-                                    }
-
-                                    insertNodeRecursive(subtreeRoot, morton, currentDepth, voxelMaterial);
-                                    localLeafVoxels++;
-                                }
-                            }
-                        }
-                    }
+                if (node->childMask == 0) {
+                    node->material = sampleVoxelMaterial(mesh, triIdx, voxelCenter);
                 }
+                node->childMask |= 1 << octant;
+                break;
             }
+        }
 
-            leafVoxels += localLeafVoxels;
+        leafVoxels += std::popcount(node->childMask);
+        return node->childMask ? node : nullptr;
+    }
 
-            if (!chunkVoxelSet.empty()) {
-                std::unordered_map<size_t, std::shared_ptr<CPUNode>> localCache;
-                reduceTreeRecursiveThreadSafe(subtreeRoot, currentDepth, localCache);
-                uint64_t subtreeCode = mortonnd::MortonNDBmi_3D_64::Encode(
-                    chunkX / chunkSize,
-                    chunkY / chunkSize,
-                    chunkZ / chunkSize);
+    std::shared_ptr<CPUNode> children[8];
+    auto voxelizeOctant = [&](uint32_t octant, TriangleLists& childScratch) {
+        glm::uvec3 childMin = childOrigin(octant);
+        glm::vec3 childCenter = glm::vec3(childMin) + childHalfSize;
 
-                {
-                    std::lock_guard<std::mutex> lock(subtreesMutex);
-                    subtrees[subtreeCode] = subtreeRoot;
+        std::vector<uint32_t>& childTriangles = childScratch[currentDepth + 1];
+        childTriangles.clear();
+        if (nodeSize > chunkSize) {
+            bvh.query(glm::vec3(childMin), glm::vec3(childMin + childSize), childTriangles);
+            std::erase_if(childTriangles, [&](uint32_t triIdx) { return !intersects(triIdx, childCenter); });
+        }
+        else {
+            for (uint32_t triIdx : triangles) {
+                if (intersects(triIdx, childCenter)) {
+                    childTriangles.push_back(triIdx);
                 }
             }
+        }
 
-            size_t processed = ++chunksProcessed;
-            if (processed % 10 == 0) {
-                printf("Processed %zu/%zu chunks (%.1f%%), %zu voxels so far\n",
-                    processed, chunkCoords.size(),
-                    100.0f * processed / chunkCoords.size(),
-                    leafVoxels.load());
-            }
+        if (!childTriangles.empty()) {
+            children[octant] = voxelizeNode(mesh, bvh, childTriangles, childMin, childSize, currentDepth + 1, childScratch, leafVoxels);
+        }
+    };
+
+    constexpr std::array<uint32_t, 8> octants = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    if (nodeSize > chunkSize) {
+        std::for_each(std::execution::par, octants.begin(), octants.end(), [&](uint32_t octant) {
+            TriangleLists octantScratch(maxDepth + 1);
+            voxelizeOctant(octant, octantScratch);
+            });
+    }
+    else {
+        for (uint32_t octant : octants) {
+            voxelizeOctant(octant, scratch);
+        }
+    }
 
-            auto chunkEnd = std::chrono::steady_clock::now();
-        });
+    for (uint32_t octant = 0; octant < 8; octant++) {
+        if (!children[octant]) continue;
 
-    printf("\nMerging subtrees...\n");
-    mergeSubtrees();
+        if (node->childMask == 0) {
+            node->material = children[octant]->material;
+        }
+        node->childMask |= 1 << octant;
+        node->children[octant] = children[octant];
+    }
 
-    printf("Linearizing...\n");
-    linearize();
+    if (node->childMask == 0) {
+        return nullptr;
+    }
 
-    printf("Saving to file...\n");
-    saveToFile(modelDir + std::to_string(treeSize));
+    if (nodeSize == chunkSize) {
+        std::unordered_map<size_t, std::shared_ptr<CPUNode>> localCache;
+        reduceTreeRecursiveThreadSafe(node, currentDepth, localCache);
+    }
 
-    auto end = std::chrono::steady_clock::now();
-    printf("\n=== SVDAG generation complete ===\n");
-    printf("Total time: %.1f seconds\n", std::chrono::duration<float>(end - start).count());
-    printf("Leaf voxels: %zu\n", leafVoxels.load());
-    printf("Total nodes: %zu\n", nodes.size());
-    printf("Compression ratio: %.2fx\n", static_cast<float>(leafVoxels) / nodes.size());
+    return node;
+}
+
+uint16_t SVDAGBuilder::sampleVoxelMaterial(const IndexedMesh& mesh, uint32_t triIdx, const glm::vec3& voxelCenter)
+{
+    const MaterialData& material = materials[mesh.triangleMaterials[triIdx]];
+    if (!material.hasTexture) {
+        return material.materialID;
+    }
+
+    glm::vec3 bary = calculateBarycentric(voxelCenter, mesh.vertex(triIdx, 0), mesh.vertex(triIdx, 1), mesh.vertex(triIdx, 2));
+    glm::vec2 uv = bary.x * mesh.uv(triIdx, 0) + bary.y * mesh.uv(triIdx, 1) + bary.z * mesh.uv(triIdx, 2);
+    return sampleTextureColor(material.texturePath, uv.x, uv.y);
 }
 
 glm::vec3 SVDAGBuilder::calculateBarycentric(const glm::vec3& p, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
@@ -609,12 +689,14 @@ void SVDAGBuilder::reduceTreeRecursiveThreadSafe(std::shared_ptr<CPUNode>& node,
     }
 }
 
-void SVDAGBuilder::mergeSubtrees()
+void SVDAGBuilder::mergeSubtrees(uint32_t subtreeSize)
 {
     root = std::make_shared<CPUNode>();
 
-    size_t subtreeDepth = static_cast<size_t>(std::log2(chunkSize));
-    size_t levels = static_cast<size_t>(std::log2(treeSize / chunkSize));
+    size_t levels = static_cast<size_t>(std::log2(treeSize / subtreeSize));
+    if (levels == 0 && !subtrees.empty()) {
+        root = subtrees.begin()->second;
+    }
 
     for (const auto& [subtreeCode, subtreeRoot] : subtrees) {
         std::shared_ptr<CPUNode> currentNode = root;
@@ -641,8 +723,10 @@ void SVDAGBuilder::mergeSubtrees()
 
 void SVDAGBuilder::linearize()
 {
-    GPUNode rootNode;
+    GPUNode rootNode = {};
     rootNode.childMask = root->childMask;
+    rootNode.refs = 1;
+    rootNode.material = root->material;
     nodes.push_back(rootNode);
     nodeToIndexMap[root] = 0;
 
@@ -668,7 +752,7 @@ void SVDAGBuilder::linearizeRecursive(std::shared_ptr<CPUNode>& node,
             size_t childIndex = nodes.size();
             nodes[nodeIndex].children[i] = childIndex;
 
-            GPUNode gpuNode;
+            GPUNode gpuNode = {};
             gpuNode.childMask = child->childMask;
             gpuNode.refs = child->refs;
             gpuNode.material = child->material;
@@ -681,11 +765,44 @@ void SVDAGBuilder::linearizeRecursive(std::shared_ptr<CPUNode>& node,
     }
 }
 
-void SVDAGBuilder::saveToFile(std::string fileName)
+bool SVDAGBuilder::saveToFile(std::string fileName)
 {
     size_t pos = fileName.find_last_of("\\");
 	std::string path = "..\\Renderer\\" + fileName.substr(pos + 1) + ".dag";
-    std::ofstream file(path, std::ios::binary);
-    cereal::BinaryOutputArchive archive(file);
-    archive(*this);
+
+    DAGFileWriter writer;
+    if (!writer.open(path, static_cast<uint32_t>(maxDepth), maxRefs, fileEncoding)) {
+        return false;
+    }
+
+    std::vector<DAGFileNode> batch;
+    batch.reserve(65536);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        DAGFileNode fileNode = {};
+        fileNode.childMask = nodes[i].childMask;
+        fileNode.refs = nodes[i].refs;
+        fileNode.material = nodes[i].material;
+        std::copy(std::begin(nodes[i].children), std::end(nodes[i].children), fileNode.children);
+        batch.push_back(fileNode);
+
+        if (batch.size() == batch.capacity()) {
+            writer.write(batch.data(), batch.size());
+            batch.clear();
+        }
+    }
+    writer.write(batch.data(), batch.size());
+
+    if (!writer.close()) {
+        printf("Failed to write %s\n", path.c_str());
+        return false;
+    }
+    if (fileEncoding == DAG_ENCODING_RAW) {
+        printf("Saved %s (%.1f MB)\n", path.c_str(), writer.fileSize() / (1024.0f * 1024.0f));
+    }
+    else {
+        printf("Saved %s (%.1f MB compressed, %.1f MB raw, %.2fx)\n", path.c_str(),
+            writer.fileSize() / (1024.0f * 1024.0f), writer.rawSize() / (1024.0f * 1024.0f),
+            static_cast<float>(writer.rawSize()) / writer.fileSize());
+    }
+    return true;
 }
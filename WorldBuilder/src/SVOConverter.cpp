@@ -0,0 +1,301 @@
+#include "SVOConverter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <thread>
+
+namespace {
+    constexpr size_t LEGACY_NODE_SIZE = 33;
+    constexpr size_t LEGACY_HEADER_SIZE = 16;
+    constexpr size_t LEGACY_READ_NODES_MIN = 64;
+    constexpr size_t LEGACY_READ_NODES_MAX = 32768;
+
+    void parseLegacyNode(const uint8_t* bytes, LegacyNode& node) {
+        node.childMask = bytes[0];
+        std::memcpy(node.children, bytes + 1, sizeof(node.children));
+    }
+
+    // Sequential buffered reader over the node array, starting at any node index. The buffer grows with
+    // every refill so that the many small subtrees near the split depth stay cheap to open
+    class LegacyNodeReader
+    {
+    public:
+        bool open(const std::string& path, uint64_t firstNode) {
+            file.open(path, std::ios::binary);
+            file.seekg(LEGACY_HEADER_SIZE + firstNode * LEGACY_NODE_SIZE);
+            buffer.resize(LEGACY_READ_NODES_MIN * LEGACY_NODE_SIZE);
+            nextIndex = firstNode;
+            return static_cast<bool>(file);
+        }
+
+        bool next(LegacyNode& node) {
+            if (cursor + LEGACY_NODE_SIZE > filled) {
+                size_t remaining = filled - cursor;
+                if (filled != 0 && buffer.size() < LEGACY_READ_NODES_MAX * LEGACY_NODE_SIZE) {
+                    buffer.resize(buffer.size() * 2);
+                }
+                std::memmove(buffer.data(), buffer.data() + cursor, remaining);
+                file.read(reinterpret_cast<char*>(buffer.data() + remaining), buffer.size() - remaining);
+                filled = remaining + static_cast<size_t>(file.gcount());
+                cursor = 0;
+                if (filled < LEGACY_NODE_SIZE) return false;
+            }
+
+            parseLegacyNode(buffer.data() + cursor, node);
+            cursor += LEGACY_NODE_SIZE;
+            nextIndex++;
+            return true;
+        }
+
+        uint64_t position() const { return nextIndex; }
+    private:
+        std::ifstream file;
+        std::vector<uint8_t> buffer;
+        size_t cursor = 0;
+        size_t filled = 0;
+        uint64_t nextIndex = 0;
+    };
+
+    struct SubtreeReducer
+    {
+        LegacyNodeReader reader;
+        uint32_t maxDepth;
+        std::unordered_map<ReducedNodeKey, uint32_t, ReducedNodeKeyHash> lookup;
+        std::vector<ReducedNodeKey>& outNodes;
+
+        // The file is in pre-order, so every child must be the next node in the stream
+        bool reduce(uint32_t depth, uint32_t& outIndex) {
+            LegacyNode node;
+            if (!reader.next(node)) return false;
+
+            ReducedNodeKey key = { depth, node.childMask, {} };
+            if (depth + 1 < maxDepth) {
+                for (int c = 0; c < 8; c++) {
+                    if ((node.childMask & (1 << c)) == 0) continue;
+                    if (node.children[c] != reader.position()) return false;
+
+                    uint32_t child;
+                    if (!reduce(depth + 1, child)) return false;
+                    key.children[c] = child + 1;
+                }
+            }
+
+            auto [it, inserted] = lookup.try_emplace(key, static_cast<uint32_t>(outNodes.size()));
+            if (inserted) {
+                outNodes.push_back(key);
+            }
+            outIndex = it->second;
+            return true;
+        }
+    };
+}
+
+bool ReducedNodeKey::operator==(const ReducedNodeKey& other) const
+{
+    return depth == other.depth && childMask == other.childMask && std::equal(children, children + 8, other.children);
+}
+
+size_t ReducedNodeKeyHash::operator()(const ReducedNodeKey& key) const
+{
+    size_t hash = std::hash<uint32_t>{}(key.childMask | (key.depth << 8));
+    for (uint32_t child : key.children) {
+        hash ^= std::hash<uint32_t>{}(child) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+SVOConverter::SVOConverter(uint16_t material, uint32_t splitDepth) : material(material), splitDepth(splitDepth)
+{
+}
+
+bool SVOConverter::convert(const std::string& inputPath, const std::string& outputPath, DAGEncoding encoding)
+{
+    auto start = std::chrono::steady_clock::now();
+    this->inputPath = inputPath;
+    uniqueNodes.clear();
+    uniqueLookup.clear();
+
+    if (!readHeader()) {
+        return false;
+    }
+    splitDepth = std::min(splitDepth, maxDepth - 1);
+
+    std::vector<uint64_t> subtrees;
+    collectSubtrees(0, 0, subtrees);
+
+    // Reduce a few subtrees per thread at a time so only one batch of local tables is alive
+    size_t batchSize = std::max<size_t>(std::thread::hardware_concurrency(), 1) * 2;
+    std::unordered_map<uint64_t, uint32_t> subtreeRoots;
+    for (size_t batchStart = 0; batchStart < subtrees.size(); batchStart += batchSize) {
+        size_t batchEnd = std::min(batchStart + batchSize, subtrees.size());
+        std::vector<std::vector<ReducedNodeKey>> reduced(batchEnd - batchStart);
+        std::vector<uint8_t> succeeded(reduced.size(), 0);
+        std::vector<size_t> tasks(reduced.size());
+        std::iota(tasks.begin(), tasks.end(), size_t{ 0 });
+
+        std::for_each(std::execution::par, tasks.begin(), tasks.end(), [&](size_t task) {
+            succeeded[task] = reduceSubtree(subtrees[batchStart + task], reduced[task]);
+            });
+
+        for (size_t task = 0; task < reduced.size(); task++) {
+            if (!succeeded[task]) {
+                printf("%s is corrupt: subtree at node %llu is not in pre-order\n", inputPath.c_str(),
+                    static_cast<unsigned long long>(subtrees[batchStart + task]));
+                return false;
+            }
+
+            std::vector<uint32_t> localToGlobal(reduced[task].size());
+            for (size_t i = 0; i < reduced[task].size(); i++) {
+                ReducedNodeKey key = reduced[task][i];
+                for (uint32_t& child : key.children) {
+                    if (child != 0) child = localToGlobal[child - 1] + 1;
+                }
+                localToGlobal[i] = mergeNode(key);
+            }
+            subtreeRoots[subtrees[batchStart + task]] = localToGlobal.back();
+        }
+    }
+
+    uint32_t root = reduceTop(0, 0, subtreeRoots);
+    if (!writeDAG(root, outputPath, encoding)) {
+        return false;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    printf("Converted %s: %llu nodes -> %zu nodes (%.1fx) in %.1f seconds\n", inputPath.c_str(),
+        static_cast<unsigned long long>(nodeCount), uniqueNodes.size(), static_cast<double>(nodeCount) / uniqueNodes.size(),
+        std::chrono::duration<float>(end - start).count());
+    return true;
+}
+
+bool SVOConverter::readHeader()
+{
+    std::ifstream file(inputPath, std::ios::binary);
+    uint64_t header[2];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        printf("Failed to read %s\n", inputPath.c_str());
+        return false;
+    }
+
+    maxDepth = static_cast<uint32_t>(header[0]);
+    nodeCount = header[1];
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(inputPath, error);
+    if (error || maxDepth == 0 || maxDepth > DAG_MAX_DEPTH || nodeCount == 0 || fileSize != LEGACY_HEADER_SIZE + nodeCount * LEGACY_NODE_SIZE) {
+        printf("%s is not a legacy SVO world\n", inputPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool SVOConverter::readNodeAt(uint64_t index, LegacyNode& node) const
+{
+    if (index >= nodeCount) return false;
+
+    std::ifstream file(inputPath, std::ios::binary);
+    file.seekg(LEGACY_HEADER_SIZE + index * LEGACY_NODE_SIZE);
+    uint8_t bytes[LEGACY_NODE_SIZE];
+    if (!file.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) return false;
+
+    parseLegacyNode(bytes, node);
+    return true;
+}
+
+void SVOConverter::collectSubtrees(uint64_t index, uint32_t depth, std::vector<uint64_t>& subtrees) const
+{
+    if (depth == splitDepth) {
+        subtrees.push_back(index);
+        return;
+    }
+
+    LegacyNode node;
+    if (!readNodeAt(index, node)) return;
+    for (int c = 0; c < 8; c++) {
+        if (node.childMask & (1 << c)) {
+            collectSubtrees(node.children[c], depth + 1, subtrees);
+        }
+    }
+}
+
+bool SVOConverter::reduceSubtree(uint64_t index, std::vector<ReducedNodeKey>& outNodes) const
+{
+    SubtreeReducer reducer = { {}, maxDepth, {}, outNodes };
+    if (!reducer.reader.open(inputPath, index)) return false;
+
+    uint32_t root;
+    return reducer.reduce(splitDepth, root);
+}
+
+uint32_t SVOConverter::mergeNode(const ReducedNodeKey& key)
+{
+    auto [it, inserted] = uniqueLookup.try_emplace(key, static_cast<uint32_t>(uniqueNodes.size()));
+    if (inserted) {
+        uniqueNodes.push_back(key);
+    }
+    return it->second;
+}
+
+uint32_t SVOConverter::reduceTop(uint64_t index, uint32_t depth, const std::unordered_map<uint64_t, uint32_t>& subtreeRoots)
+{
+    if (depth == splitDepth) {
+        return subtreeRoots.at(index);
+    }
+
+    LegacyNode node = {};
+    readNodeAt(index, node);
+    ReducedNodeKey key = { depth, node.childMask, {} };
+    for (int c = 0; c < 8; c++) {
+        if (node.childMask & (1 << c)) {
+            key.children[c] = reduceTop(node.children[c], depth + 1, subtreeRoots) + 1;
+        }
+    }
+    return mergeNode(key);
+}
+
+bool SVOConverter::writeDAG(uint32_t root, const std::string& outputPath, DAGEncoding encoding)
+{
+    // Same depth-first layout as SVDAGBuilder::linearize, with refs counted per parent
+    std::vector<DAGFileNode> nodes;
+    nodes.reserve(uniqueNodes.size());
+    std::vector<uint32_t> layout(uniqueNodes.size(), UINT32_MAX);
+    uint32_t maxRefs = 1;
+
+    auto emit = [&](auto& self, uint32_t unique) -> uint32_t {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        layout[unique] = index;
+        DAGFileNode node = {};
+        node.childMask = uniqueNodes[unique].childMask;
+        node.material = material;
+        nodes.push_back(node);
+
+        for (int c = 0; c < 8; c++) {
+            uint32_t child = uniqueNodes[unique].children[c];
+            if (child == 0) continue;
+
+            uint32_t childIndex = layout[child - 1] == UINT32_MAX ? self(self, child - 1) : layout[child - 1];
+            nodes[childIndex].refs++;
+            maxRefs = std::max(maxRefs, nodes[childIndex].refs);
+            nodes[index].children[c] = childIndex;
+        }
+        return index;
+        };
+    emit(emit, root);
+    nodes[0].refs = 1;
+
+    DAGFileWriter writer;
+    if (!writer.open(outputPath, maxDepth, maxRefs, encoding)) {
+        return false;
+    }
+    writer.write(nodes.data(), nodes.size());
+    if (!writer.close()) {
+        printf("Failed to write %s\n", outputPath.c_str());
+        return false;
+    }
+    printf("Saved %s (%.1f MB)\n", outputPath.c_str(), writer.fileSize() / (1024.0f * 1024.0f));
+    return true;
+}
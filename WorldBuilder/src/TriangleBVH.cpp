@@ -1,34 +1,44 @@
 #include "TriangleBVH.h"
 
-void TriangleBVH::build(const std::vector<Triangle>& triangles) {
-    if (triangles.empty()) return;
+#include <algorithm>
+#include <numeric>
 
-    std::vector<size_t> indices(triangles.size());
-    for (size_t i = 0; i < triangles.size(); i++) indices[i] = i;
+void TriangleBVH::build(const IndexedMesh& mesh) {
+    root.reset();
+    triangleIndices.clear();
+    if (mesh.empty()) return;
 
-    root = buildRecursive(triangles, indices, 0);
+    triangleIndices.resize(mesh.triangleCount());
+    std::iota(triangleIndices.begin(), triangleIndices.end(), 0u);
+
+    root = buildRecursive(mesh, 0, static_cast<uint32_t>(triangleIndices.size()), 0);
 }
 
-void TriangleBVH::query(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<size_t>& outIndices) {
+void TriangleBVH::query(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& outIndices) const {
     if (!root) return;
     queryRecursive(root.get(), boxMin, boxMax, outIndices);
 }
 
-std::unique_ptr<BVHNode> TriangleBVH::buildRecursive(const std::vector<Triangle>& triangles, std::vector<size_t>& indices, int depth) {
+std::unique_ptr<BVHNode> TriangleBVH::buildRecursive(const IndexedMesh& mesh, uint32_t first, uint32_t count, int depth) {
     auto node = std::make_unique<BVHNode>();
+    node->firstTriangle = first;
+    node->triangleCount = count;
 
     node->aabbMin = glm::vec3(std::numeric_limits<float>::max());
     node->aabbMax = glm::vec3(std::numeric_limits<float>::lowest());
 
-    for (size_t idx : indices) {
-        const auto& tri = triangles[idx];
-        node->aabbMin = glm::min(node->aabbMin, glm::min(glm::min(tri.v0, tri.v1), tri.v2));
-        node->aabbMax = glm::max(node->aabbMax, glm::max(glm::max(tri.v0, tri.v1), tri.v2));
+    auto begin = triangleIndices.begin() + first;
+    auto end = begin + count;
+
+    for (auto it = begin; it != end; ++it) {
+        glm::vec3 triMin, triMax;
+        mesh.triangleBounds(*it, triMin, triMax);
+        node->aabbMin = glm::min(node->aabbMin, triMin);
+        node->aabbMax = glm::max(node->aabbMax, triMax);
     }
 
-    if (indices.size() <= 8 || depth > 20) {
+    if (count <= 8 || depth > 20) {
         node->isLeaf = true;
-        node->triangleIndices = indices;
         return node;
     }
 
@@ -39,42 +49,33 @@ std::unique_ptr<BVHNode> TriangleBVH::buildRecursive(const std::vector<Triangle>
 
     float splitPos = (node->aabbMin[axis] + node->aabbMax[axis]) * 0.5f;
 
-    std::vector<size_t> leftIndices, rightIndices;
-    for (size_t idx : indices) {
-        const auto& tri = triangles[idx];
-        float center = (tri.v0[axis] + tri.v1[axis] + tri.v2[axis]) / 3.0f;
-
-        if (center < splitPos) {
-            leftIndices.push_back(idx);
-        }
-        else {
-            rightIndices.push_back(idx);
-        }
-    }
+    auto middle = std::partition(begin, end, [&](uint32_t idx) {
+        return mesh.centroid(idx)[axis] < splitPos;
+        });
+    uint32_t leftCount = static_cast<uint32_t>(middle - begin);
 
-    if (leftIndices.empty() || rightIndices.empty()) {
+    if (leftCount == 0 || leftCount == count) {
         node->isLeaf = true;
-        node->triangleIndices = indices;
         return node;
     }
 
     node->isLeaf = false;
-    node->children[0] = buildRecursive(triangles, leftIndices, depth + 1);
-    node->children[1] = buildRecursive(triangles, rightIndices, depth + 1);
+    node->children[0] = buildRecursive(mesh, first, leftCount, depth + 1);
+    node->children[1] = buildRecursive(mesh, first + leftCount, count - leftCount, depth + 1);
 
     return node;
 }
 
-void TriangleBVH::queryRecursive(const BVHNode* node, const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<size_t>& outIndices) { 
+void TriangleBVH::queryRecursive(const BVHNode* node, const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<uint32_t>& outIndices) const {
     if (!node->intersects(boxMin, boxMax)) return;
 
     if (node->isLeaf) {
         outIndices.insert(outIndices.end(),
-            node->triangleIndices.begin(),
-            node->triangleIndices.end());
+            triangleIndices.begin() + node->firstTriangle,
+            triangleIndices.begin() + node->firstTriangle + node->triangleCount);
     }
     else {
         if (node->children[0]) queryRecursive(node->children[0].get(), boxMin, boxMax, outIndices);
         if (node->children[1]) queryRecursive(node->children[1].get(), boxMin, boxMax, outIndices);
     }
-}
\ No newline at end of file
+}